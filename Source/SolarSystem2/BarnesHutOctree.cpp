@@ -0,0 +1,198 @@
+#include "BarnesHutOctree.h"
+
+void FBarnesHutOctree::Build(TConstArrayView<FVector3d> Positions, TConstArrayView<double> Masses)
+{
+	const int32 NumBodies = Positions.Num();
+
+	Nodes.Reset();
+	NextBody.SetNumUninitialized(NumBodies);
+	BodyPositions.Reset();
+	BodyPositions.Append(Positions.GetData(), NumBodies);
+	BodyMasses.Reset();
+	BodyMasses.Append(Masses.GetData(), NumBodies);
+
+	if (NumBodies == 0) {
+		return;
+	}
+
+	FBox3d Bounds(ForceInit);
+	for (const FVector3d& Position : Positions) {
+		Bounds += Position;
+	}
+
+	// Worst case is roughly one internal node per body per level of a balanced tree
+	Nodes.Reserve(NumBodies * 2 + 1);
+
+	const double HalfSize = FMath::Max(Bounds.GetExtent().GetMax(), 1.0) * 1.001;
+	AddNode(Bounds.GetCenter(), HalfSize);
+
+	for (int32 i = 0; i < NumBodies; ++i) {
+		Insert(i);
+	}
+
+	// Children are always created after their parent, so a reverse sweep visits them first
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; --NodeIndex) {
+		FNode& Node = Nodes[NodeIndex];
+		FVector3d WeightedPosition = FVector3d::ZeroVector;
+		double Mass = 0.0;
+
+		if (Node.FirstChild == INDEX_NONE) {
+			for (int32 Body = Node.FirstBody; Body != INDEX_NONE; Body = NextBody[Body]) {
+				WeightedPosition += BodyPositions[Body] * BodyMasses[Body];
+				Mass += BodyMasses[Body];
+			}
+		} else {
+			for (int32 Child = Node.FirstChild; Child < Node.FirstChild + 8; ++Child) {
+				WeightedPosition += Nodes[Child].MassCenter * Nodes[Child].Mass;
+				Mass += Nodes[Child].Mass;
+			}
+		}
+
+		Node.Mass = Mass;
+		Node.MassCenter = Mass > 0.0 ? WeightedPosition / Mass : Node.Center;
+	}
+}
+
+int32 FBarnesHutOctree::AddNode(const FVector3d& Center, double HalfSize)
+{
+	FNode Node;
+	Node.Center = Center;
+	Node.HalfSize = HalfSize;
+	Node.MassCenter = Center;
+	Node.Mass = 0.0;
+	Node.FirstChild = INDEX_NONE;
+	Node.FirstBody = INDEX_NONE;
+	Node.NumBodies = 0;
+
+	return Nodes.Add(Node);
+}
+
+int32 FBarnesHutOctree::GetOctant(const FVector3d& Center, const FVector3d& Position)
+{
+	return (Position.X >= Center.X ? 1 : 0) | (Position.Y >= Center.Y ? 2 : 0) | (Position.Z >= Center.Z ? 4 : 0);
+}
+
+void FBarnesHutOctree::Subdivide(int32 NodeIndex)
+{
+	const FVector3d Center = Nodes[NodeIndex].Center;
+	const double ChildHalfSize = Nodes[NodeIndex].HalfSize * 0.5;
+
+	int32 FirstChild = INDEX_NONE;
+	for (int32 Octant = 0; Octant < 8; ++Octant) {
+		const FVector3d Offset(
+			(Octant & 1) ? ChildHalfSize : -ChildHalfSize,
+			(Octant & 2) ? ChildHalfSize : -ChildHalfSize,
+			(Octant & 4) ? ChildHalfSize : -ChildHalfSize);
+
+		const int32 Child = AddNode(Center + Offset, ChildHalfSize);
+		if (Octant == 0) {
+			FirstChild = Child;
+		}
+	}
+
+	// Move the bodies this leaf was holding down into the new children
+	FNode& Node = Nodes[NodeIndex];
+	int32 Body = Node.FirstBody;
+	Node.FirstChild = FirstChild;
+	Node.FirstBody = INDEX_NONE;
+	Node.NumBodies = 0;
+
+	while (Body != INDEX_NONE) {
+		const int32 Next = NextBody[Body];
+		FNode& Child = Nodes[FirstChild + GetOctant(Center, BodyPositions[Body])];
+		NextBody[Body] = Child.FirstBody;
+		Child.FirstBody = Body;
+		Child.NumBodies++;
+		Body = Next;
+	}
+}
+
+void FBarnesHutOctree::Insert(int32 BodyIndex)
+{
+	const FVector3d& Position = BodyPositions[BodyIndex];
+	int32 NodeIndex = 0;
+	int32 Depth = 0;
+
+	while (true) {
+		if (Nodes[NodeIndex].FirstChild == INDEX_NONE) {
+			if (Nodes[NodeIndex].NumBodies == 0 || Depth >= MaxDepth) {
+				FNode& Leaf = Nodes[NodeIndex];
+				NextBody[BodyIndex] = Leaf.FirstBody;
+				Leaf.FirstBody = BodyIndex;
+				Leaf.NumBodies++;
+				return;
+			}
+
+			Subdivide(NodeIndex);
+		}
+
+		NodeIndex = Nodes[NodeIndex].FirstChild + GetOctant(Nodes[NodeIndex].Center, Position);
+		Depth++;
+	}
+}
+
+FVector3d FBarnesHutOctree::ComputeAcceleration(const FVector3d& Position, int32 BodyIndex, double OpeningAngle, double GravitationalConstant, double MinDistance, double Softening, int64* OutInteractions) const
+{
+	FVector3d Acceleration = FVector3d::ZeroVector;
+	int64 Interactions = 0;
+
+	if (Nodes.Num() == 0) {
+		return Acceleration;
+	}
+
+	const double OpeningAngleSquared = OpeningAngle * OpeningAngle;
+	const double MinDistanceSquared = MinDistance * MinDistance;
+	const double SofteningSquared = Softening * Softening;
+
+	auto AddPointMass = [&](const FVector3d& Other, double Mass) {
+		const FVector3d Direction = Other - Position;
+		Interactions++;
+		const double DistanceSquared = Direction.SizeSquared();
+
+		if (DistanceSquared >= MinDistanceSquared) {
+			const double InvDistance = 1.0 / FMath::Sqrt(DistanceSquared + SofteningSquared);
+			Acceleration += Direction * (GravitationalConstant * Mass * InvDistance * InvDistance * InvDistance);
+		}
+	};
+
+	// Each level pushes at most 8 children, so the stack never exceeds this
+	int32 Stack[8 * MaxDepth + 8];
+	int32 StackSize = 0;
+	Stack[StackSize++] = 0;
+
+	while (StackSize > 0) {
+		const FNode& Node = Nodes[Stack[--StackSize]];
+
+		if (Node.Mass <= 0.0) {
+			continue;
+		}
+
+		if (Node.FirstChild == INDEX_NONE) {
+			for (int32 Body = Node.FirstBody; Body != INDEX_NONE; Body = NextBody[Body]) {
+				if (Body != BodyIndex) {
+					AddPointMass(BodyPositions[Body], BodyMasses[Body]);
+				}
+			}
+			continue;
+		}
+
+		const double CellSize = Node.HalfSize * 2.0;
+		const double DistanceSquared = FVector3d::DistSquared(Node.MassCenter, Position);
+		const bool Contains = (Position - Node.Center).GetAbs().GetMax() <= Node.HalfSize;
+
+		// A cell holding the body itself is always opened so it never attracts itself
+		if (!Contains && CellSize * CellSize < OpeningAngleSquared * DistanceSquared) {
+			AddPointMass(Node.MassCenter, Node.Mass);
+		} else {
+			for (int32 Child = Node.FirstChild; Child < Node.FirstChild + 8; ++Child) {
+				Stack[StackSize++] = Child;
+			}
+		}
+	}
+
+	if (OutInteractions) {
+		*OutInteractions += Interactions;
+	}
+
+	return Acceleration;
+}
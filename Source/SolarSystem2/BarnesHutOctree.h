@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Octree over point masses, rebuilt from scratch every force evaluation.
+// Cells that look smaller than OpeningAngle from a body are treated as a single mass at their center of mass.
+class SOLARSYSTEM2_API FBarnesHutOctree
+{
+public:
+	void Build(TConstArrayView<FVector3d> Positions, TConstArrayView<double> Masses);
+
+	// Acceleration on body BodyIndex (pass INDEX_NONE for a point that is not part of the tree).
+	// OutInteractions, when given, is increased by the number of bodies and cells that were summed.
+	FVector3d ComputeAcceleration(const FVector3d& Position, int32 BodyIndex, double OpeningAngle, double GravitationalConstant, double MinDistance, double Softening, int64* OutInteractions = nullptr) const;
+
+	int32 NumNodes() const { return Nodes.Num(); }
+
+private:
+	struct FNode
+	{
+		FVector3d Center;
+		double HalfSize;
+		FVector3d MassCenter;
+		double Mass;
+		int32 FirstChild;
+		int32 FirstBody;
+		int32 NumBodies;
+	};
+
+	// Leaves at this depth hold every body that lands in them, so coincident bodies cannot split forever
+	static constexpr int32 MaxDepth = 32;
+
+	TArray<FNode> Nodes;
+	TArray<int32> NextBody;
+	TArray<FVector3d> BodyPositions;
+	TArray<double> BodyMasses;
+
+	int32 AddNode(const FVector3d& Center, double HalfSize);
+	void Subdivide(int32 NodeIndex);
+	void Insert(int32 BodyIndex);
+
+	static int32 GetOctant(const FVector3d& Center, const FVector3d& Position);
+};
@@ -0,0 +1,221 @@
+#include "BodyCollision.h"
+#include "Algo/BinarySearch.h"
+
+uint64 FBodySpatialHash::MakeCellKey(int64 X, int64 Y, int64 Z)
+{
+	// 21 bits per axis, grids wider than that wrap around, which only adds candidates
+	return ((uint64)X & 0x1FFFFF) | (((uint64)Y & 0x1FFFFF) << 21) | (((uint64)Z & 0x1FFFFF) << 42);
+}
+
+uint64 FBodySpatialHash::GetCellKey(const FVector3d& Position) const
+{
+	return MakeCellKey(GetCellCoordinate(Position.X), GetCellCoordinate(Position.Y), GetCellCoordinate(Position.Z));
+}
+
+bool FBodySpatialHash::Overlaps(int32 Body, const FVector3d& Min, const FVector3d& Max) const
+{
+	const FVector3d& BodyMin = BoundsMin[Body];
+	const FVector3d& BodyMax = BoundsMax[Body];
+
+	return BodyMin.X <= Max.X && BodyMax.X >= Min.X
+		&& BodyMin.Y <= Max.Y && BodyMax.Y >= Min.Y
+		&& BodyMin.Z <= Max.Z && BodyMax.Z >= Min.Z;
+}
+
+void FBodySpatialHash::Build(TConstArrayView<FVector3d> Starts, TConstArrayView<FVector3d> Ends, TConstArrayView<double> Radii)
+{
+	const int32 NumBodies = Radii.Num();
+
+	Entries.Reset();
+	LargeBodies.Reset();
+	IsLarge.Init(false, NumBodies);
+	BoundsMin.SetNumUninitialized(NumBodies);
+	BoundsMax.SetNumUninitialized(NumBodies);
+
+	if (NumBodies == 0) {
+		return;
+	}
+
+	double TotalExtent = 0.0;
+	for (int32 i = 0; i < NumBodies; ++i) {
+		BoundsMin[i] = Starts[i].ComponentMin(Ends[i]) - FVector3d(Radii[i]);
+		BoundsMax[i] = Starts[i].ComponentMax(Ends[i]) + FVector3d(Radii[i]);
+		TotalExtent += (BoundsMax[i] - BoundsMin[i]).GetMax();
+	}
+
+	// Twice the average swept size, so a typical body lands in one to eight cells
+	CellSize = FMath::Max(2.0 * TotalExtent / NumBodies, UE_DOUBLE_KINDA_SMALL_NUMBER);
+	InvCellSize = 1.0 / CellSize;
+
+	Entries.Reserve(NumBodies * 2);
+
+	for (int32 i = 0; i < NumBodies; ++i) {
+		const int64 MinX = GetCellCoordinate(BoundsMin[i].X);
+		const int64 MinY = GetCellCoordinate(BoundsMin[i].Y);
+		const int64 MinZ = GetCellCoordinate(BoundsMin[i].Z);
+		const int64 MaxX = GetCellCoordinate(BoundsMax[i].X);
+		const int64 MaxY = GetCellCoordinate(BoundsMax[i].Y);
+		const int64 MaxZ = GetCellCoordinate(BoundsMax[i].Z);
+
+		if (MaxX - MinX >= MaxCellsPerAxis || MaxY - MinY >= MaxCellsPerAxis || MaxZ - MinZ >= MaxCellsPerAxis) {
+			LargeBodies.Add(i);
+			IsLarge[i] = true;
+			continue;
+		}
+
+		for (int64 Z = MinZ; Z <= MaxZ; ++Z) {
+			for (int64 Y = MinY; Y <= MaxY; ++Y) {
+				for (int64 X = MinX; X <= MaxX; ++X) {
+					Entries.Add({ MakeCellKey(X, Y, Z), i });
+				}
+			}
+		}
+	}
+
+	Entries.Sort([](const FEntry& A, const FEntry& B) {
+		return A.Cell < B.Cell || (A.Cell == B.Cell && A.Body < B.Body);
+	});
+}
+
+void FBodySpatialHash::ForEachCandidatePair(TFunctionRef<void(int32, int32)> Visitor) const
+{
+	for (int32 First = 0; First < Entries.Num();) {
+		const uint64 Cell = Entries[First].Cell;
+		int32 Last = First + 1;
+
+		while (Last < Entries.Num() && Entries[Last].Cell == Cell) {
+			Last++;
+		}
+
+		for (int32 i = First; i < Last; ++i) {
+			const int32 BodyA = Entries[i].Body;
+
+			for (int32 j = i + 1; j < Last; ++j) {
+				const int32 BodyB = Entries[j].Body;
+
+				if (BodyA == BodyB || !Overlaps(BodyA, BoundsMin[BodyB], BoundsMax[BodyB])) {
+					continue;
+				}
+
+				// A pair sharing several cells is only reported from the one holding the low corner of their overlap
+				if (GetCellKey(BoundsMin[BodyA].ComponentMax(BoundsMin[BodyB])) == Cell) {
+					Visitor(BodyA, BodyB);
+				}
+			}
+		}
+
+		First = Last;
+	}
+
+	for (const int32 Large : LargeBodies) {
+		for (int32 i = 0; i < Num(); ++i) {
+			// Two large bodies are paired from the lower one only
+			if (i == Large || (IsLarge[i] && i < Large)) {
+				continue;
+			}
+
+			if (Overlaps(i, BoundsMin[Large], BoundsMax[Large])) {
+				Visitor(FMath::Min(i, Large), FMath::Max(i, Large));
+			}
+		}
+	}
+}
+
+void FBodySpatialHash::QuerySphere(const FVector3d& Center, double Radius, TArray<int32>& OutBodies) const
+{
+	OutBodies.Reset();
+
+	const FVector3d Min = Center - FVector3d(Radius);
+	const FVector3d Max = Center + FVector3d(Radius);
+
+	const int64 MinX = GetCellCoordinate(Min.X);
+	const int64 MinY = GetCellCoordinate(Min.Y);
+	const int64 MinZ = GetCellCoordinate(Min.Z);
+	const int64 MaxX = GetCellCoordinate(Max.X);
+	const int64 MaxY = GetCellCoordinate(Max.Y);
+	const int64 MaxZ = GetCellCoordinate(Max.Z);
+	const double NumCells = double(MaxX - MinX + 1) * double(MaxY - MinY + 1) * double(MaxZ - MinZ + 1);
+
+	// A query wider than the populated grid is cheaper as a plain scan
+	if (NumCells > Entries.Num()) {
+		for (int32 i = 0; i < Num(); ++i) {
+			if (Overlaps(i, Min, Max)) {
+				OutBodies.Add(i);
+			}
+		}
+		return;
+	}
+
+	for (int64 Z = MinZ; Z <= MaxZ; ++Z) {
+		for (int64 Y = MinY; Y <= MaxY; ++Y) {
+			for (int64 X = MinX; X <= MaxX; ++X) {
+				const uint64 Cell = MakeCellKey(X, Y, Z);
+				int32 Index = Algo::LowerBoundBy(Entries, Cell, &FEntry::Cell);
+
+				for (; Index < Entries.Num() && Entries[Index].Cell == Cell; ++Index) {
+					const int32 Body = Entries[Index].Body;
+
+					if (Overlaps(Body, Min, Max) && GetCellKey(BoundsMin[Body].ComponentMax(Min)) == Cell) {
+						OutBodies.Add(Body);
+					}
+				}
+			}
+		}
+	}
+
+	for (const int32 Large : LargeBodies) {
+		if (Overlaps(Large, Min, Max)) {
+			OutBodies.Add(Large);
+		}
+	}
+}
+
+void FBodySpatialHash::FindContacts(TConstArrayView<FVector3d> Starts, TConstArrayView<FVector3d> Ends, TConstArrayView<double> Radii, TArray<FBodyContact>& OutContacts) const
+{
+	OutContacts.Reset();
+
+	ForEachCandidatePair([&](int32 BodyA, int32 BodyB) {
+		double Time;
+		if (SweepSpheres(Starts[BodyA], Ends[BodyA], Starts[BodyB], Ends[BodyB], Radii[BodyA] + Radii[BodyB], Time)) {
+			OutContacts.Add({ BodyA, BodyB, Time });
+		}
+	});
+
+	OutContacts.Sort([](const FBodyContact& A, const FBodyContact& B) {
+		return A.Time < B.Time;
+	});
+}
+
+bool FBodySpatialHash::SweepSpheres(const FVector3d& StartA, const FVector3d& EndA, const FVector3d& StartB, const FVector3d& EndB, double RadiusSum, double& OutTime)
+{
+	// In the frame of A, B moves along a straight line: |Offset + Motion * t| = RadiusSum
+	const FVector3d Offset = StartB - StartA;
+	const FVector3d Motion = (EndB - StartB) - (EndA - StartA);
+	const double C = Offset.SizeSquared() - RadiusSum * RadiusSum;
+
+	if (C <= 0.0) {
+		OutTime = 0.0;
+		return true;
+	}
+
+	const double A = Motion.SizeSquared();
+	const double B = FVector3d::DotProduct(Offset, Motion);
+
+	// Separating or at rest relative to each other
+	if (B >= 0.0 || A < UE_DOUBLE_SMALL_NUMBER) {
+		return false;
+	}
+
+	const double Discriminant = B * B - A * C;
+	if (Discriminant < 0.0) {
+		return false;
+	}
+
+	const double Time = (-B - FMath::Sqrt(Discriminant)) / A;
+	if (Time > 1.0) {
+		return false;
+	}
+
+	OutTime = Time;
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BodyCollision.generated.h"
+
+UENUM(BlueprintType)
+enum class EBodyCollisionResponse : uint8
+{
+	// No detection, bodies pass through each other
+	None,
+	// Contacts are reported, the bodies keep moving
+	EventOnly,
+	// Bodies rebound, restitution sets how much of the approach speed is kept
+	Bounce,
+	// Perfectly inelastic, the lighter body is absorbed and mass and momentum are conserved
+	Merge
+};
+
+// Two spheres touching during one fixed step
+struct FBodyContact
+{
+	int32 BodyA = INDEX_NONE;
+	int32 BodyB = INDEX_NONE;
+
+	// Fraction of the step at which the spheres first touched, 0 when they started out overlapping
+	double Time = 0.0;
+};
+
+// Uniform grid addressed by hashed cell coordinates, rebuilt from scratch every step.
+// Each body is entered as the bounds of its sphere swept over the step. Bodies spanning more than a few cells
+// are kept on a short list tested against everything instead, so one sun does not fill thousands of cells.
+class SOLARSYSTEM2_API FBodySpatialHash
+{
+public:
+	// Starts and Ends are the positions before and after the step, pass the same array twice for resting spheres
+	void Build(TConstArrayView<FVector3d> Starts, TConstArrayView<FVector3d> Ends, TConstArrayView<double> Radii);
+
+	// Calls Visitor once for every pair of bodies with overlapping bounds, lower index first
+	void ForEachCandidatePair(TFunctionRef<void(int32, int32)> Visitor) const;
+
+	// Bodies whose bounds reach into the sphere, a superset of the ones actually inside
+	void QuerySphere(const FVector3d& Center, double Radius, TArray<int32>& OutBodies) const;
+
+	// Swept sphere test on every candidate pair, contacts come out sorted by time of impact
+	void FindContacts(TConstArrayView<FVector3d> Starts, TConstArrayView<FVector3d> Ends, TConstArrayView<double> Radii, TArray<FBodyContact>& OutContacts) const;
+
+	// Earliest fraction of the step at which two linearly moving spheres touch
+	static bool SweepSpheres(const FVector3d& StartA, const FVector3d& EndA, const FVector3d& StartB, const FVector3d& EndB, double RadiusSum, double& OutTime);
+
+	int32 Num() const { return BoundsMin.Num(); }
+
+	double GetCellSize() const { return CellSize; }
+
+private:
+	struct FEntry
+	{
+		uint64 Cell;
+		int32 Body;
+	};
+
+	// Bodies wider than this many cells go on the large list
+	static constexpr int32 MaxCellsPerAxis = 4;
+
+	double CellSize = 1.0;
+	double InvCellSize = 1.0;
+
+	// Sorted by cell, so the bodies of one cell are a contiguous run
+	TArray<FEntry> Entries;
+
+	TArray<int32> LargeBodies;
+	TBitArray<> IsLarge;
+
+	TArray<FVector3d> BoundsMin;
+	TArray<FVector3d> BoundsMax;
+
+	int64 GetCellCoordinate(double Value) const { return FMath::FloorToInt64(Value * InvCellSize); }
+
+	uint64 GetCellKey(const FVector3d& Position) const;
+
+	bool Overlaps(int32 Body, const FVector3d& Min, const FVector3d& Max) const;
+
+	static uint64 MakeCellKey(int64 X, int64 Y, int64 Z);
+};
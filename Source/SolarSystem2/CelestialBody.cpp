@@ -4,7 +4,8 @@ const float G = 0.0000000000674f;
 
 ACelestialBody::ACelestialBody()
 {
-    PrimaryActorTick.bCanEverTick = true;
+    // The manager moves every body, a scenario can spawn thousands of them
+    PrimaryActorTick.bCanEverTick = false;
 
     ProceduralMesh = CreateDefaultSubobject<UProceduralPlanetGenerator>(TEXT("ProceduralMesh"));
     RootComponent = ProceduralMesh;
@@ -16,21 +17,18 @@ ACelestialBody::ACelestialBody()
     Radius = 100.0f;
     SurfaceGravity = 9.81f;
     CurrentVelocity = FVector::ZeroVector;
-    AccumulatedAcceleration = FVector::ZeroVector;
 }
 
 void ACelestialBody::BeginPlay()
 {
     Super::BeginPlay();
 
-    if (Mass <= 1.0f) {
-        CalculateMassFromGravity();
-    }
-
-    CurrentVelocity = InitialVelocity;
+    InitializePhysicalState();
 
     if (UseProcedural && ProceduralMesh) {
-		RegeneratePlanet();
+		if (!DeferPlanetGeneration) {
+			RegeneratePlanet();
+		}
 		MeshComponent->SetVisibility(false);
 
         if (PlanetMaterial) {
@@ -57,35 +55,34 @@ void ACelestialBody::RegeneratePlanet()
     if (ProceduralMesh) {
         ProceduralMesh->Radius = Radius * VisualScale;
         ProceduralMesh->Subdivisions = PlanetSubdivisions;
-        ProceduralMesh->GeneratePlanet();
+        PlanetGenerated = true;
+
+        if (AsyncGeneration) {
+            ProceduralMesh->GeneratePlanetAsync();
+        } else {
+            ProceduralMesh->GeneratePlanet();
+        }
 
         UE_LOG(LogTemp, Log, TEXT("Regenerated procedural planet: %s with Radius=%.2f, Subdivisions=%d"),
             *BodyName, Radius, PlanetSubdivisions);
     }
 }
 
-void ACelestialBody::Tick(float DeltaTime)
-{
-    Super::Tick(DeltaTime);
-}
-
 void ACelestialBody::CalculateMassFromGravity()
 {
     Mass = (SurfaceGravity * Radius * Radius) / G;
 }
 
-void ACelestialBody::ApplyGravitationalForce(const FVector& Force, float DeltaTime)
+void ACelestialBody::InitializePhysicalState()
 {
-    FVector Acceleration = Force / Mass;
-    AccumulatedAcceleration += Acceleration;
-}
-
-void ACelestialBody::UpdatePosition(float DeltaTime)
-{
-    CurrentVelocity += AccumulatedAcceleration * DeltaTime;
+    if (PhysicalStateInitialized) {
+        return;
+    }
 
-    FVector NewPosition = GetActorLocation() + (CurrentVelocity * DeltaTime);
-    SetActorLocation(NewPosition);
+    if (Mass <= 1.0f) {
+        CalculateMassFromGravity();
+    }
 
-    AccumulatedAcceleration = FVector::ZeroVector;
+    CurrentVelocity = InitialVelocity;
+    PhysicalStateInitialized = true;
 }
\ No newline at end of file
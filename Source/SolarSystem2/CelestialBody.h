@@ -5,6 +5,17 @@
 #include "ProceduralPlanetGenerator.h"
 #include "CelestialBody.generated.h"
 
+UENUM(BlueprintType)
+enum class EOrbitPropagation : uint8
+{
+    // Integrated with every other body
+    NBody,
+    // Analytic two-body orbit around the central body
+    Kepler,
+    // Kepler while the other bodies' pull stays below the manager's threshold, N-body otherwise
+    Automatic
+};
+
 UCLASS()
 class SOLARSYSTEM2_API ACelestialBody : public AActor
 {
@@ -31,6 +42,9 @@ public:
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Body")
     FVector CurrentVelocity;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Celestial Body", meta = (ToolTip = "How this body is moved, Kepler skips numerical integration entirely"))
+    EOrbitPropagation PropagationMode = EOrbitPropagation::NBody;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Visualization")
     UStaticMeshComponent* MeshComponent;
 
@@ -40,6 +54,12 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Visualization")
     FLinearColor OrbitColor = FLinearColor::White;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Visualization", meta = (ClampMin = "0", ToolTip = "Predicted time drawn for this orbit, 0 uses 1.2 estimated periods"))
+    float OrbitPredictionHorizon = 0.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Visualization", meta = (ClampMin = "0", ToolTip = "Points drawn for this orbit, 0 keeps the shared prediction spacing"))
+    int32 OrbitPredictionSamples = 0;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Visualization")
     UMaterialInterface* PlanetMaterial;
 
@@ -52,21 +72,29 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Generation")
     bool UseProcedural = true;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Generation", meta = (ToolTip = "Build the planet mesh on a worker thread instead of stalling the game thread"))
+    bool AsyncGeneration = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Generation", meta = (ToolTip = "Leave the planet unbuilt in BeginPlay, it shows nothing until RegeneratePlanet runs"))
+    bool DeferPlanetGeneration = false;
+
     UFUNCTION(BlueprintCallable, Category = "Celestial Body")
     void RegeneratePlanet();
 
     UFUNCTION(BlueprintCallable, Category = "Celestial Body")
     void CalculateMassFromGravity();
 
-    void ApplyGravitationalForce(const FVector& Force, float DeltaTime);
+    // Resolves Mass and CurrentVelocity, safe to call before this body's BeginPlay
+    void InitializePhysicalState();
 
-    void UpdatePosition(float DeltaTime);
-
-    virtual void Tick(float DeltaTime) override;
+    // False while a deferred planet waits for its first RegeneratePlanet
+    bool HasPlanet() const { return PlanetGenerated; }
 
 protected:
     virtual void BeginPlay() override;
 
 private:
-    FVector AccumulatedAcceleration;
+    bool PhysicalStateInitialized = false;
+
+    bool PlanetGenerated = false;
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "Ephemeris.h"
+#include "SolarSystemStats.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr uint32 EphemerisFileMagic = 0x50455353; // 'SSEP'
+
+	struct FEphemerisFileHeader
+	{
+		uint32 Magic = EphemerisFileMagic;
+		uint32 Version = FChebyshevEphemeris::FileVersion;
+		int32 NumBodies = 0;
+		int32 Degree = 0;
+		int32 NumIntervals = 0;
+		uint32 BodySetHash = 0;
+		double StartTime = 0.0;
+		double IntervalLength = 0.0;
+	};
+
+	// Advances with steps of at most MaxStepSize so the state lands exactly on Time
+	void IntegrateTo(FNBodySimulation& Simulation, FNBodyState& State, double Time, double MaxStepSize)
+	{
+		while (State.Time < Time) {
+			Simulation.Step(State, FMath::Min(MaxStepSize, Time - State.Time));
+		}
+	}
+}
+
+bool FChebyshevEphemeris::Bake(const FNBodySimulation& Simulation, const FNBodyState& InitialState, const FEphemerisBakeSettings& Settings, FChebyshevEphemeris& OutEphemeris)
+{
+	SOLARSYSTEM_SCOPE(EphemerisBake);
+
+	OutEphemeris.Reset();
+
+	if (InitialState.Num() == 0 || Settings.Duration <= 0.0 || Settings.IntervalLength <= 0.0 || Settings.Degree < 1) {
+		return false;
+	}
+
+	FNBodySimulation BakeSimulation;
+	BakeSimulation.CopySettings(Simulation);
+	BakeSimulation.Solver = EGravitySolver::Direct;
+	BakeSimulation.Integrator = EIntegrator::Yoshida4;
+
+	FNBodyState State = InitialState;
+	BakeSimulation.ComputeAccelerations(State);
+
+	const int32 NumBodies = State.Num();
+	const int32 NumNodes = Settings.Degree + 1;
+	const double MaxStepSize = FMath::Clamp(Settings.MaxStepSize, UE_DOUBLE_SMALL_NUMBER, Settings.IntervalLength);
+
+	OutEphemeris.NumBodies = NumBodies;
+	OutEphemeris.Degree = Settings.Degree;
+	OutEphemeris.NumIntervals = FMath::CeilToInt32(Settings.Duration / Settings.IntervalLength);
+	OutEphemeris.StartTime = State.Time;
+	OutEphemeris.IntervalLength = Settings.IntervalLength;
+	OutEphemeris.Coefficients.SetNumZeroed((int64)OutEphemeris.NumIntervals * NumBodies * NumNodes);
+
+	// Node k sits at x = cos(PI * (k + 0.5) / NumNodes), walked from the last so time only moves forward
+	TArray<double> Nodes;
+	Nodes.SetNumUninitialized(NumNodes);
+	for (int32 k = 0; k < NumNodes; ++k) {
+		Nodes[k] = FMath::Cos(PI * (k + 0.5) / NumNodes);
+	}
+
+	TArray<FVector3d> Samples;
+	Samples.SetNumUninitialized(NumNodes * NumBodies);
+
+	for (int32 Interval = 0; Interval < OutEphemeris.NumIntervals; ++Interval) {
+		const double Center = OutEphemeris.StartTime + (Interval + 0.5) * Settings.IntervalLength;
+
+		for (int32 k = NumNodes - 1; k >= 0; --k) {
+			IntegrateTo(BakeSimulation, State, Center + Nodes[k] * Settings.IntervalLength * 0.5, MaxStepSize);
+			FMemory::Memcpy(&Samples[k * NumBodies], State.Positions.GetData(), NumBodies * sizeof(FVector3d));
+		}
+
+		// Discrete orthogonality of the Chebyshev polynomials on their own nodes turns the fit into sums
+		for (int32 Body = 0; Body < NumBodies; ++Body) {
+			FVector3d* Coefficients = &OutEphemeris.Coefficients[((int64)Interval * NumBodies + Body) * NumNodes];
+
+			for (int32 j = 0; j < NumNodes; ++j) {
+				FVector3d Sum = FVector3d::ZeroVector;
+
+				for (int32 k = 0; k < NumNodes; ++k) {
+					Sum += Samples[k * NumBodies + Body] * FMath::Cos(PI * j * (k + 0.5) / NumNodes);
+				}
+
+				Coefficients[j] = Sum * ((j == 0 ? 1.0 : 2.0) / NumNodes);
+			}
+		}
+	}
+
+	return true;
+}
+
+void FChebyshevEphemeris::Reset()
+{
+	NumBodies = 0;
+	Degree = 0;
+	NumIntervals = 0;
+	StartTime = 0.0;
+	IntervalLength = 1.0;
+	BodySetHash = 0;
+	Coefficients.Empty();
+}
+
+int32 FChebyshevEphemeris::FindInterval(double Time, double& OutX) const
+{
+	const double Offset = FMath::Clamp(Time - StartTime, 0.0, NumIntervals * IntervalLength);
+	const int32 Interval = FMath::Min(FMath::FloorToInt32(Offset / IntervalLength), NumIntervals - 1);
+
+	OutX = FMath::Clamp(2.0 * (Offset - Interval * IntervalLength) / IntervalLength - 1.0, -1.0, 1.0);
+	return Interval;
+}
+
+void FChebyshevEphemeris::Evaluate(double Time, int32 Body, FVector3d& OutPosition, FVector3d& OutVelocity) const
+{
+	double X;
+	const FVector3d* C = GetCoefficients(FindInterval(Time, X), Body);
+
+	// T(j) and its derivative by the three term recurrence, T'(j) = 2 T(j-1) + 2x T'(j-1) - T'(j-2)
+	double T0 = 1.0;
+	double T1 = X;
+	double D0 = 0.0;
+	double D1 = 1.0;
+
+	FVector3d Position = C[0] + C[1] * T1;
+	FVector3d Derivative = C[1];
+
+	for (int32 j = 2; j <= Degree; ++j) {
+		const double T2 = 2.0 * X * T1 - T0;
+		const double D2 = 2.0 * T1 + 2.0 * X * D1 - D0;
+
+		Position += C[j] * T2;
+		Derivative += C[j] * D2;
+
+		T0 = T1;
+		T1 = T2;
+		D0 = D1;
+		D1 = D2;
+	}
+
+	OutPosition = Position;
+	OutVelocity = Derivative * (2.0 / IntervalLength);
+}
+
+FVector3d FChebyshevEphemeris::EvaluatePosition(double Time, int32 Body) const
+{
+	double X;
+	const FVector3d* C = GetCoefficients(FindInterval(Time, X), Body);
+
+	// Clenshaw's recurrence, cheaper than building every T(j) when the derivative is not needed
+	FVector3d B1 = FVector3d::ZeroVector;
+	FVector3d B2 = FVector3d::ZeroVector;
+
+	for (int32 j = Degree; j >= 1; --j) {
+		const FVector3d B0 = C[j] + B1 * (2.0 * X) - B2;
+		B2 = B1;
+		B1 = B0;
+	}
+
+	return C[0] + B1 * X - B2;
+}
+
+void FChebyshevEphemeris::EvaluateAll(double Time, TArrayView<FVector3d> OutPositions, TArrayView<FVector3d> OutVelocities) const
+{
+	SOLARSYSTEM_SCOPE(Ephemeris);
+
+	for (int32 Body = 0; Body < NumBodies; ++Body) {
+		Evaluate(Time, Body, OutPositions[Body], OutVelocities[Body]);
+	}
+}
+
+bool FChebyshevEphemeris::Save(const FString& Path) const
+{
+	FEphemerisFileHeader Header;
+	Header.NumBodies = NumBodies;
+	Header.Degree = Degree;
+	Header.NumIntervals = NumIntervals;
+	Header.BodySetHash = BodySetHash;
+	Header.StartTime = StartTime;
+	Header.IntervalLength = IntervalLength;
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer.IsValid()) {
+		return false;
+	}
+
+	Writer->Serialize(&Header, sizeof(Header));
+	Writer->Serialize((void*)Coefficients.GetData(), Coefficients.Num() * sizeof(FVector3d));
+	return Writer->Close();
+}
+
+bool FChebyshevEphemeris::Load(const FString& Path)
+{
+	Reset();
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent) || Bytes.Num() < (int64)sizeof(FEphemerisFileHeader)) {
+		return false;
+	}
+
+	FEphemerisFileHeader Header;
+	FMemory::Memcpy(&Header, Bytes.GetData(), sizeof(Header));
+
+	const int64 NumCoefficients = (int64)Header.NumIntervals * Header.NumBodies * (Header.Degree + 1);
+	const bool ValidHeader = Header.Magic == EphemerisFileMagic && Header.Version == FileVersion
+		&& Header.NumBodies > 0 && Header.Degree >= 1 && Header.NumIntervals > 0 && Header.IntervalLength > 0.0;
+
+	if (!ValidHeader || Bytes.Num() != (int64)sizeof(Header) + NumCoefficients * (int64)sizeof(FVector3d)) {
+		return false;
+	}
+
+	Coefficients.SetNumUninitialized(NumCoefficients);
+	FMemory::Memcpy(Coefficients.GetData(), Bytes.GetData() + sizeof(Header), NumCoefficients * sizeof(FVector3d));
+
+	NumBodies = Header.NumBodies;
+	Degree = Header.Degree;
+	NumIntervals = Header.NumIntervals;
+	BodySetHash = Header.BodySetHash;
+	StartTime = Header.StartTime;
+	IntervalLength = Header.IntervalLength;
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimulation.h"
+
+struct FEphemerisBakeSettings
+{
+	// Simulated seconds covered by the table, starting at the initial state's time
+	double Duration = 3600.0;
+
+	// Length of one polynomial piece
+	double IntervalLength = 10.0;
+
+	// Polynomial degree per piece, fitted through Degree + 1 Chebyshev nodes
+	int32 Degree = 12;
+
+	// Largest integration step taken between the nodes
+	double MaxStepSize = 0.01;
+};
+
+// Piecewise Chebyshev fit of every body's trajectory, in the style of the JPL ephemerides.
+// Any time inside the table costs one interval lookup and a Degree long recurrence per body, whatever the time warp.
+class SOLARSYSTEM2_API FChebyshevEphemeris
+{
+public:
+	// Bumped whenever the table layout changes, older files are then rejected
+	static constexpr uint32 FileVersion = 1;
+
+	// Integrates InitialState with the fourth order integrator and the direct sum, whatever Simulation is set to
+	static bool Bake(const FNBodySimulation& Simulation, const FNBodyState& InitialState, const FEphemerisBakeSettings& Settings, FChebyshevEphemeris& OutEphemeris);
+
+	bool Save(const FString& Path) const;
+
+	bool Load(const FString& Path);
+
+	void Reset();
+
+	bool IsValid() const { return NumIntervals > 0; }
+
+	int32 GetNumBodies() const { return NumBodies; }
+
+	double GetStartTime() const { return StartTime; }
+
+	double GetEndTime() const { return StartTime + NumIntervals * IntervalLength; }
+
+	bool Covers(double Time) const { return IsValid() && Time >= GetStartTime() && Time <= GetEndTime(); }
+
+	// Times outside the table are clamped to its ends
+	void Evaluate(double Time, int32 Body, FVector3d& OutPosition, FVector3d& OutVelocity) const;
+
+	FVector3d EvaluatePosition(double Time, int32 Body) const;
+
+	void EvaluateAll(double Time, TArrayView<FVector3d> OutPositions, TArrayView<FVector3d> OutVelocities) const;
+
+	// Identifies the body set the table was baked for, checked by the caller on load
+	uint32 BodySetHash = 0;
+
+	SIZE_T GetAllocatedSize() const { return Coefficients.GetAllocatedSize(); }
+
+private:
+	int32 NumBodies = 0;
+	int32 Degree = 0;
+	int32 NumIntervals = 0;
+	double StartTime = 0.0;
+	double IntervalLength = 1.0;
+
+	// Degree + 1 coefficients per body per interval, all three axes at once
+	TArray<FVector3d> Coefficients;
+
+	// Interval holding Time and Time mapped onto [-1, 1] inside it
+	int32 FindInterval(double Time, double& OutX) const;
+
+	const FVector3d* GetCoefficients(int32 Interval, int32 Body) const { return &Coefficients[((int64)Interval * NumBodies + Body) * (Degree + 1)]; }
+};
@@ -0,0 +1,171 @@
+#include "GravityKernel.h"
+#include "Math/VectorRegister.h"
+
+#if defined(PLATFORM_ALWAYS_HAS_AVX_2) && PLATFORM_ALWAYS_HAS_AVX_2
+#include <immintrin.h>
+#define SOLARSYSTEM_GRAVITY_AVX2 1
+#else
+#define SOLARSYSTEM_GRAVITY_AVX2 0
+#endif
+
+void FGravitySourceBlock::Pack(TConstArrayView<FVector3d> Positions, TConstArrayView<double> Masses)
+{
+	NumSources = Positions.Num();
+	const int32 PaddedNum = Align(FMath::Max(NumSources, 1), LaneWidth);
+
+	FBox3d Bounds(ForceInit);
+	for (const FVector3d& Position : Positions) {
+		Bounds += Position;
+	}
+	Origin = NumSources > 0 ? Bounds.GetCenter() : FVector3d::ZeroVector;
+
+	X.SetNumUninitialized(PaddedNum);
+	Y.SetNumUninitialized(PaddedNum);
+	Z.SetNumUninitialized(PaddedNum);
+	Mass.SetNumUninitialized(PaddedNum);
+
+	for (int32 i = 0; i < NumSources; ++i) {
+		const FVector3d Relative = Positions[i] - Origin;
+		X[i] = (float)Relative.X;
+		Y[i] = (float)Relative.Y;
+		Z[i] = (float)Relative.Z;
+		Mass[i] = (float)Masses[i];
+	}
+
+	for (int32 i = NumSources; i < PaddedNum; ++i) {
+		X[i] = 0.0f;
+		Y[i] = 0.0f;
+		Z[i] = 0.0f;
+		Mass[i] = 0.0f;
+	}
+}
+
+namespace GravityKernel
+{
+	FVector3d AccumulateAcceleration(const FGravitySourceBlock& Sources, const FVector3d& Position, double GravitationalConstant, double MinDistance, double Softening)
+	{
+		const FVector3d Relative = Position - Sources.Origin;
+		const int32 PaddedNum = Sources.X.Num();
+
+		const float* SourceX = Sources.X.GetData();
+		const float* SourceY = Sources.Y.GetData();
+		const float* SourceZ = Sources.Z.GetData();
+		const float* SourceMass = Sources.Mass.GetData();
+
+		float SumX = 0.0f;
+		float SumY = 0.0f;
+		float SumZ = 0.0f;
+
+#if SOLARSYSTEM_GRAVITY_AVX2
+		const __m256 PX = _mm256_set1_ps((float)Relative.X);
+		const __m256 PY = _mm256_set1_ps((float)Relative.Y);
+		const __m256 PZ = _mm256_set1_ps((float)Relative.Z);
+		const __m256 MinDistanceSquared = _mm256_set1_ps((float)(MinDistance * MinDistance));
+		const __m256 SofteningSquared = _mm256_set1_ps((float)(Softening * Softening));
+		const __m256 Half = _mm256_set1_ps(0.5f);
+		const __m256 ThreeHalves = _mm256_set1_ps(1.5f);
+
+		__m256 AX = _mm256_setzero_ps();
+		__m256 AY = _mm256_setzero_ps();
+		__m256 AZ = _mm256_setzero_ps();
+
+		for (int32 i = 0; i < PaddedNum; i += 8) {
+			const __m256 DX = _mm256_sub_ps(_mm256_loadu_ps(SourceX + i), PX);
+			const __m256 DY = _mm256_sub_ps(_mm256_loadu_ps(SourceY + i), PY);
+			const __m256 DZ = _mm256_sub_ps(_mm256_loadu_ps(SourceZ + i), PZ);
+
+			const __m256 DistanceSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY)), _mm256_mul_ps(DZ, DZ));
+			const __m256 Softened = _mm256_add_ps(DistanceSquared, SofteningSquared);
+
+			// rsqrt estimate refined with one Newton-Raphson step
+			__m256 InvDistance = _mm256_rsqrt_ps(Softened);
+			InvDistance = _mm256_mul_ps(InvDistance, _mm256_sub_ps(ThreeHalves, _mm256_mul_ps(_mm256_mul_ps(Half, Softened), _mm256_mul_ps(InvDistance, InvDistance))));
+
+			const __m256 InvDistanceCubed = _mm256_mul_ps(InvDistance, _mm256_mul_ps(InvDistance, InvDistance));
+			const __m256 Valid = _mm256_cmp_ps(DistanceSquared, MinDistanceSquared, _CMP_GE_OQ);
+			const __m256 Scale = _mm256_and_ps(Valid, _mm256_mul_ps(_mm256_loadu_ps(SourceMass + i), InvDistanceCubed));
+
+			AX = _mm256_add_ps(AX, _mm256_mul_ps(DX, Scale));
+			AY = _mm256_add_ps(AY, _mm256_mul_ps(DY, Scale));
+			AZ = _mm256_add_ps(AZ, _mm256_mul_ps(DZ, Scale));
+		}
+
+		alignas(32) float LanesX[8];
+		alignas(32) float LanesY[8];
+		alignas(32) float LanesZ[8];
+		_mm256_store_ps(LanesX, AX);
+		_mm256_store_ps(LanesY, AY);
+		_mm256_store_ps(LanesZ, AZ);
+
+		for (int32 Lane = 0; Lane < 8; ++Lane) {
+			SumX += LanesX[Lane];
+			SumY += LanesY[Lane];
+			SumZ += LanesZ[Lane];
+		}
+#else
+		const VectorRegister4Float PX = VectorSetFloat1((float)Relative.X);
+		const VectorRegister4Float PY = VectorSetFloat1((float)Relative.Y);
+		const VectorRegister4Float PZ = VectorSetFloat1((float)Relative.Z);
+		const VectorRegister4Float MinDistanceSquared = VectorSetFloat1((float)(MinDistance * MinDistance));
+		const VectorRegister4Float SofteningSquared = VectorSetFloat1((float)(Softening * Softening));
+
+		VectorRegister4Float AX = VectorZeroFloat();
+		VectorRegister4Float AY = VectorZeroFloat();
+		VectorRegister4Float AZ = VectorZeroFloat();
+
+		for (int32 i = 0; i < PaddedNum; i += 4) {
+			const VectorRegister4Float DX = VectorSubtract(VectorLoad(SourceX + i), PX);
+			const VectorRegister4Float DY = VectorSubtract(VectorLoad(SourceY + i), PY);
+			const VectorRegister4Float DZ = VectorSubtract(VectorLoad(SourceZ + i), PZ);
+
+			const VectorRegister4Float DistanceSquared = VectorMultiplyAdd(DZ, DZ, VectorMultiplyAdd(DY, DY, VectorMultiply(DX, DX)));
+			const VectorRegister4Float InvDistance = VectorReciprocalSqrtAccurate(VectorAdd(DistanceSquared, SofteningSquared));
+
+			const VectorRegister4Float InvDistanceCubed = VectorMultiply(InvDistance, VectorMultiply(InvDistance, InvDistance));
+			const VectorRegister4Float Valid = VectorCompareGE(DistanceSquared, MinDistanceSquared);
+			const VectorRegister4Float Scale = VectorSelect(Valid, VectorMultiply(VectorLoad(SourceMass + i), InvDistanceCubed), VectorZeroFloat());
+
+			AX = VectorMultiplyAdd(DX, Scale, AX);
+			AY = VectorMultiplyAdd(DY, Scale, AY);
+			AZ = VectorMultiplyAdd(DZ, Scale, AZ);
+		}
+
+		alignas(16) float LanesX[4];
+		alignas(16) float LanesY[4];
+		alignas(16) float LanesZ[4];
+		VectorStoreAligned(AX, LanesX);
+		VectorStoreAligned(AY, LanesY);
+		VectorStoreAligned(AZ, LanesZ);
+
+		for (int32 Lane = 0; Lane < 4; ++Lane) {
+			SumX += LanesX[Lane];
+			SumY += LanesY[Lane];
+			SumZ += LanesZ[Lane];
+		}
+#endif
+
+		return FVector3d(SumX, SumY, SumZ) * GravitationalConstant;
+	}
+
+	FVector3d AccumulateAccelerationScalar(const FGravitySourceBlock& Sources, const FVector3d& Position, double GravitationalConstant, double MinDistance, double Softening)
+	{
+		const FVector3d Relative = Position - Sources.Origin;
+		const double MinDistanceSquared = MinDistance * MinDistance;
+		const double SofteningSquared = Softening * Softening;
+		FVector3d Acceleration = FVector3d::ZeroVector;
+
+		for (int32 i = 0; i < Sources.NumSources; ++i) {
+			const FVector3d Direction = FVector3d(Sources.X[i], Sources.Y[i], Sources.Z[i]) - Relative;
+			const double DistanceSquared = Direction.SizeSquared();
+
+			if (DistanceSquared < MinDistanceSquared) {
+				continue;
+			}
+
+			const double InvDistance = 1.0 / FMath::Sqrt(DistanceSquared + SofteningSquared);
+			Acceleration += Direction * (Sources.Mass[i] * InvDistance * InvDistance * InvDistance);
+		}
+
+		return Acceleration * GravitationalConstant;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Source bodies repacked into padded float lanes, positions relative to Origin so float precision is
+// spent on the separation between bodies rather than on their distance from the world origin.
+struct SOLARSYSTEM2_API FGravitySourceBlock
+{
+	// Every array is padded with zero mass entries up to a multiple of this
+	static constexpr int32 LaneWidth = 8;
+
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+	TArray<float> Mass;
+
+	FVector3d Origin = FVector3d::ZeroVector;
+	int32 NumSources = 0;
+
+	void Pack(TConstArrayView<FVector3d> Positions, TConstArrayView<double> Masses);
+};
+
+namespace GravityKernel
+{
+	// Acceleration at Position from every packed source, one reciprocal square root per pair.
+	// Sources closer than MinDistance are skipped, Softening is the Plummer length added to every separation.
+	SOLARSYSTEM2_API FVector3d AccumulateAcceleration(const FGravitySourceBlock& Sources, const FVector3d& Position, double GravitationalConstant, double MinDistance, double Softening);
+
+	// Same interaction evaluated with scalar math, kept as the reference for tests and benchmarks
+	SOLARSYSTEM2_API FVector3d AccumulateAccelerationScalar(const FGravitySourceBlock& Sources, const FVector3d& Position, double GravitationalConstant, double MinDistance, double Softening);
+}
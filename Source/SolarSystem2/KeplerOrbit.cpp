@@ -0,0 +1,166 @@
+#include "KeplerOrbit.h"
+
+bool FKeplerOrbit::FromStateVectors(const FVector3d& RelativePosition, const FVector3d& RelativeVelocity, double Mu, double Time, FKeplerOrbit& OutOrbit)
+{
+	const double Radius = RelativePosition.Size();
+	const FVector3d AngularMomentum = FVector3d::CrossProduct(RelativePosition, RelativeVelocity);
+	const double AngularMomentumSize = AngularMomentum.Size();
+
+	if (Mu <= 0.0 || Radius < UE_DOUBLE_SMALL_NUMBER || AngularMomentumSize < UE_DOUBLE_SMALL_NUMBER * Radius) {
+		return false;
+	}
+
+	const double Energy = 0.5 * RelativeVelocity.SizeSquared() - Mu / Radius;
+	if (FMath::Abs(Energy) < UE_DOUBLE_SMALL_NUMBER) {
+		return false;
+	}
+
+	const FVector3d EccentricityVector = FVector3d::CrossProduct(RelativeVelocity, AngularMomentum) / Mu - RelativePosition / Radius;
+	const double Eccentricity = EccentricityVector.Size();
+	const FVector3d OrbitNormal = AngularMomentum / AngularMomentumSize;
+
+	FKeplerOrbit Orbit;
+	Orbit.Mu = Mu;
+	Orbit.Epoch = Time;
+	Orbit.SemiMajorAxis = -Mu / (2.0 * Energy);
+
+	// Circular orbits have no periapsis, measure from the current position instead
+	Orbit.Eccentricity = Eccentricity > 1.0e-9 ? Eccentricity : 0.0;
+	Orbit.PeriapsisDirection = Orbit.Eccentricity > 0.0 ? EccentricityVector / Eccentricity : RelativePosition / Radius;
+	Orbit.NormalDirection = FVector3d::CrossProduct(OrbitNormal, Orbit.PeriapsisDirection);
+
+	const double TrueAnomaly = FMath::Atan2(
+		FVector3d::DotProduct(RelativePosition, Orbit.NormalDirection),
+		FVector3d::DotProduct(RelativePosition, Orbit.PeriapsisDirection));
+
+	const double E = Orbit.Eccentricity;
+
+	if (E < 1.0) {
+		const double EccentricAnomaly = FMath::Atan2(FMath::Sqrt(1.0 - E * E) * FMath::Sin(TrueAnomaly), E + FMath::Cos(TrueAnomaly));
+		Orbit.MeanAnomalyAtEpoch = EccentricAnomaly - E * FMath::Sin(EccentricAnomaly);
+		Orbit.MeanMotion = FMath::Sqrt(Mu / (Orbit.SemiMajorAxis * Orbit.SemiMajorAxis * Orbit.SemiMajorAxis));
+	} else {
+		const double HalfTangent = FMath::Sqrt((E - 1.0) / (E + 1.0)) * FMath::Tan(TrueAnomaly * 0.5);
+		if (FMath::Abs(HalfTangent) >= 1.0) {
+			return false;
+		}
+
+		// H = 2 atanh(HalfTangent)
+		const double HyperbolicAnomaly = FMath::Loge((1.0 + HalfTangent) / (1.0 - HalfTangent));
+		const double A = -Orbit.SemiMajorAxis;
+		Orbit.MeanAnomalyAtEpoch = E * FMath::Sinh(HyperbolicAnomaly) - HyperbolicAnomaly;
+		Orbit.MeanMotion = FMath::Sqrt(Mu / (A * A * A));
+	}
+
+	OutOrbit = Orbit;
+	return true;
+}
+
+double FKeplerOrbit::SolveElliptic(double MeanAnomaly, double Eccentricity)
+{
+	const double M = FMath::UnwindRadians(MeanAnomaly);
+	double E = Eccentricity < 0.8 ? M : (M >= 0.0 ? PI : -PI);
+
+	for (int32 Iteration = 0; Iteration < 16; ++Iteration) {
+		const double Delta = (E - Eccentricity * FMath::Sin(E) - M) / (1.0 - Eccentricity * FMath::Cos(E));
+		E -= Delta;
+
+		if (FMath::Abs(Delta) < 1.0e-12) {
+			break;
+		}
+	}
+
+	return E;
+}
+
+double FKeplerOrbit::SolveHyperbolic(double MeanAnomaly, double Eccentricity)
+{
+	// asinh(M / e) is close for small anomalies, the logarithm takes over far from periapsis
+	const double Sign = MeanAnomaly >= 0.0 ? 1.0 : -1.0;
+	double H = FMath::Abs(MeanAnomaly) < 6.0 * Eccentricity
+		? FMath::Loge(MeanAnomaly / Eccentricity + FMath::Sqrt(MeanAnomaly * MeanAnomaly / (Eccentricity * Eccentricity) + 1.0))
+		: Sign * FMath::Loge(2.0 * FMath::Abs(MeanAnomaly) / Eccentricity + 1.8);
+
+	for (int32 Iteration = 0; Iteration < 32; ++Iteration) {
+		const double Delta = (Eccentricity * FMath::Sinh(H) - H - MeanAnomaly) / (Eccentricity * FMath::Cosh(H) - 1.0);
+		H -= Delta;
+
+		if (FMath::Abs(Delta) < 1.0e-12 * FMath::Max(1.0, FMath::Abs(H))) {
+			break;
+		}
+	}
+
+	return H;
+}
+
+FVector3d FKeplerOrbit::PositionAtAnomaly(double Anomaly) const
+{
+	const double E = Eccentricity;
+
+	if (E < 1.0) {
+		const double X = SemiMajorAxis * (FMath::Cos(Anomaly) - E);
+		const double Y = SemiMajorAxis * FMath::Sqrt(1.0 - E * E) * FMath::Sin(Anomaly);
+		return PeriapsisDirection * X + NormalDirection * Y;
+	}
+
+	const double A = -SemiMajorAxis;
+	const double X = A * (E - FMath::Cosh(Anomaly));
+	const double Y = A * FMath::Sqrt(E * E - 1.0) * FMath::Sinh(Anomaly);
+	return PeriapsisDirection * X + NormalDirection * Y;
+}
+
+void FKeplerOrbit::Evaluate(double Time, FVector3d& OutPosition, FVector3d& OutVelocity) const
+{
+	const double MeanAnomaly = MeanAnomalyAtEpoch + MeanMotion * (Time - Epoch);
+	const double E = Eccentricity;
+
+	if (E < 1.0) {
+		const double Anomaly = SolveElliptic(MeanAnomaly, E);
+		const double CosAnomaly = FMath::Cos(Anomaly);
+		const double SinAnomaly = FMath::Sin(Anomaly);
+		const double AnomalyRate = MeanMotion / (1.0 - E * CosAnomaly);
+		const double MinorFactor = FMath::Sqrt(1.0 - E * E);
+
+		OutPosition = PositionAtAnomaly(Anomaly);
+		OutVelocity = (PeriapsisDirection * (-SinAnomaly) + NormalDirection * (MinorFactor * CosAnomaly)) * (SemiMajorAxis * AnomalyRate);
+		return;
+	}
+
+	const double Anomaly = SolveHyperbolic(MeanAnomaly, E);
+	const double CoshAnomaly = FMath::Cosh(Anomaly);
+	const double SinhAnomaly = FMath::Sinh(Anomaly);
+	const double AnomalyRate = MeanMotion / (E * CoshAnomaly - 1.0);
+	const double A = -SemiMajorAxis;
+
+	OutPosition = PositionAtAnomaly(Anomaly);
+	OutVelocity = (PeriapsisDirection * (-SinhAnomaly) + NormalDirection * (FMath::Sqrt(E * E - 1.0) * CoshAnomaly)) * (A * AnomalyRate);
+}
+
+void FKeplerOrbit::SampleConic(int32 NumPoints, double MaxRadius, TArray<FVector3d>& OutPoints) const
+{
+	OutPoints.Reset();
+	NumPoints = FMath::Max(NumPoints, 2);
+
+	if (IsBound()) {
+		OutPoints.Reserve(NumPoints + 1);
+
+		for (int32 Point = 0; Point <= NumPoints; ++Point) {
+			OutPoints.Add(PositionAtAnomaly(2.0 * PI * Point / NumPoints));
+		}
+		return;
+	}
+
+	// Hyperbolic anomaly at which the branch reaches MaxRadius: r = a (e cosh H - 1)
+	const double A = -SemiMajorAxis;
+	const double CoshLimit = (MaxRadius / A + 1.0) / Eccentricity;
+	if (CoshLimit <= 1.0) {
+		return;
+	}
+
+	const double Limit = FMath::Loge(CoshLimit + FMath::Sqrt(CoshLimit * CoshLimit - 1.0));
+	OutPoints.Reserve(NumPoints);
+
+	for (int32 Point = 0; Point < NumPoints; ++Point) {
+		OutPoints.Add(PositionAtAnomaly(-Limit + 2.0 * Limit * Point / (NumPoints - 1)));
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Osculating two-body orbit of a body around a central mass, propagated analytically.
+// Positions and velocities are relative to the central body.
+struct SOLARSYSTEM2_API FKeplerOrbit
+{
+	// Gravitational parameter G * (central mass + body mass)
+	double Mu = 0.0;
+
+	// Negative for hyperbolic orbits
+	double SemiMajorAxis = 0.0;
+
+	double Eccentricity = 0.0;
+
+	double MeanMotion = 0.0;
+
+	double MeanAnomalyAtEpoch = 0.0;
+
+	double Epoch = 0.0;
+
+	// Unit vector towards periapsis and the in-plane vector 90 degrees ahead of it
+	FVector3d PeriapsisDirection = FVector3d::XAxisVector;
+	FVector3d NormalDirection = FVector3d::YAxisVector;
+
+	bool IsValid() const { return MeanMotion > 0.0; }
+
+	bool IsBound() const { return Eccentricity < 1.0; }
+
+	double GetPeriod() const { return IsBound() ? 2.0 * PI / MeanMotion : 0.0; }
+
+	// Returns false for degenerate (radial or zero energy) trajectories
+	static bool FromStateVectors(const FVector3d& RelativePosition, const FVector3d& RelativeVelocity, double Mu, double Time, FKeplerOrbit& OutOrbit);
+
+	void Evaluate(double Time, FVector3d& OutPosition, FVector3d& OutVelocity) const;
+
+	// Evenly spaced in eccentric (or hyperbolic) anomaly, a closed loop for bound orbits.
+	// Hyperbolic branches stop once they leave MaxRadius.
+	void SampleConic(int32 NumPoints, double MaxRadius, TArray<FVector3d>& OutPoints) const;
+
+	static double SolveElliptic(double MeanAnomaly, double Eccentricity);
+
+	static double SolveHyperbolic(double MeanAnomaly, double Eccentricity);
+
+private:
+	FVector3d PositionAtAnomaly(double Anomaly) const;
+};
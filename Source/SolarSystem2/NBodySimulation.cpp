@@ -0,0 +1,430 @@
+#include "NBodySimulation.h"
+#include "SolarSystemStats.h"
+#include "Async/ParallelFor.h"
+
+void FNBodyState::Empty(int32 Slack)
+{
+	Positions.Empty(Slack);
+	Velocities.Empty(Slack);
+	Accelerations.Empty(Slack);
+	Masses.Empty(Slack);
+}
+
+int32 FNBodyState::AddBody(const FVector3d& Position, const FVector3d& Velocity, double Mass)
+{
+	Positions.Add(Position);
+	Velocities.Add(Velocity);
+	Accelerations.Add(FVector3d::ZeroVector);
+	return Masses.Add(Mass);
+}
+
+void FNBodySimulation::CopySettings(const FNBodySimulation& Other)
+{
+	GravitationalConstant = Other.GravitationalConstant;
+	MinDistance = Other.MinDistance;
+	Softening = Other.Softening;
+	UseSimdKernel = Other.UseSimdKernel;
+	Solver = Other.Solver;
+	Integrator = Other.Integrator;
+	OpeningAngle = Other.OpeningAngle;
+	MaxThreads = Other.MaxThreads;
+	ParallelThreshold = Other.ParallelThreshold;
+}
+
+bool FNBodySimulation::HasSameSettings(const FNBodySimulation& Other) const
+{
+	return GravitationalConstant == Other.GravitationalConstant && MinDistance == Other.MinDistance && Softening == Other.Softening
+		&& UseSimdKernel == Other.UseSimdKernel && Solver == Other.Solver && Integrator == Other.Integrator
+		&& OpeningAngle == Other.OpeningAngle && MaxThreads == Other.MaxThreads && ParallelThreshold == Other.ParallelThreshold;
+}
+
+void FNBodySimulation::ComputeAccelerations(FNBodyState& InOutState)
+{
+	SOLARSYSTEM_SCOPE(GravitationalForces);
+
+	if (HasKinematicBodies(InOutState)) {
+		ComputeAccelerationsOf(InOutState, IntegratedBodies);
+		return;
+	}
+
+	if (Solver == EGravitySolver::BarnesHut) {
+		ComputeAccelerationsBarnesHut(InOutState);
+		return;
+	}
+
+	if (UseSimdKernel) {
+		ComputeAccelerationsSimd(InOutState);
+	} else {
+		ComputeAccelerationsDirect(InOutState);
+	}
+}
+
+bool FNBodySimulation::SetKinematicBodies(TConstArrayView<bool> Kinematic)
+{
+	bool Released = KinematicBodies.Num() > 0 && KinematicStateSize != Kinematic.Num();
+
+	if (KinematicStateSize == Kinematic.Num()) {
+		for (int32 Body : KinematicBodies) {
+			Released |= !Kinematic[Body];
+		}
+	}
+
+	IntegratedBodies.Reset();
+	KinematicBodies.Reset();
+
+	for (int32 i = 0; i < Kinematic.Num(); ++i) {
+		if (Kinematic[i]) {
+			KinematicBodies.Add(i);
+		} else {
+			IntegratedBodies.Add(i);
+		}
+	}
+
+	KinematicStateSize = Kinematic.Num();
+	return Released;
+}
+
+void FNBodySimulation::ComputeKinematicAccelerations(FNBodyState& InOutState)
+{
+	if (!HasKinematicBodies(InOutState)) {
+		return;
+	}
+
+	SOLARSYSTEM_SCOPE(GravitationalForces);
+	ComputeAccelerationsOf(InOutState, KinematicBodies);
+}
+
+int32 FNBodySimulation::GetNumWorkers(int32 NumBodies) const
+{
+	if (NumBodies < FMath::Max(ParallelThreshold, 2) || !FTaskGraphInterface::IsRunning()) {
+		return 1;
+	}
+
+	int32 NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	if (MaxThreads > 0) {
+		NumWorkers = FMath::Min(NumWorkers, MaxThreads);
+	}
+
+	return FMath::Clamp(NumWorkers, 1, NumBodies);
+}
+
+void FNBodySimulation::ParallelForBodies(int32 NumBodies, TFunctionRef<void(int32, int32)> Function) const
+{
+	const int32 NumWorkers = GetNumWorkers(NumBodies);
+
+	if (NumWorkers <= 1) {
+		Function(0, NumBodies);
+		return;
+	}
+
+	const int32 ChunkSize = FMath::DivideAndRoundUp(NumBodies, NumWorkers);
+
+	ParallelFor(NumWorkers, [&](int32 Worker) {
+		const int32 Start = Worker * ChunkSize;
+		const int32 End = FMath::Min(Start + ChunkSize, NumBodies);
+
+		if (Start < End) {
+			Function(Start, End);
+		}
+	});
+}
+
+void FNBodySimulation::ComputeAccelerationsDirect(FNBodyState& InOutState)
+{
+	const int32 NumBodies = InOutState.Num();
+	const FVector3d* Positions = InOutState.Positions.GetData();
+	const double* Masses = InOutState.Masses.GetData();
+	FVector3d* Accelerations = InOutState.Accelerations.GetData();
+
+	const double MinDistanceSquared = MinDistance * MinDistance;
+	const double SofteningSquared = Softening * Softening;
+
+	// The symmetric loop evaluates every pair once for both bodies
+	INC_DWORD_STAT_BY(STAT_SolarSystem_PairInteractions, (int64)NumBodies * (NumBodies - 1) / 2);
+
+	// Adds row i of the symmetric pair loop, writing both sides of every pair into Out
+	auto AccumulateRow = [&](int32 i, FVector3d* Out) {
+		const FVector3d PositionI = Positions[i];
+		FVector3d AccelerationI = FVector3d::ZeroVector;
+
+		for (int32 j = i + 1; j < NumBodies; ++j) {
+			const FVector3d Direction = Positions[j] - PositionI;
+			const double DistanceSquared = Direction.SizeSquared();
+
+			if (DistanceSquared < MinDistanceSquared) {
+				continue;
+			}
+
+			// G / r^3, so that Direction * Scale has magnitude G / r^2
+			const double InvDistance = 1.0 / FMath::Sqrt(DistanceSquared + SofteningSquared);
+			const double Scale = GravitationalConstant * InvDistance * InvDistance * InvDistance;
+
+			AccelerationI += Direction * (Scale * Masses[j]);
+			Out[j] -= Direction * (Scale * Masses[i]);
+		}
+
+		Out[i] += AccelerationI;
+	};
+
+	const int32 NumWorkers = GetNumWorkers(NumBodies);
+
+	if (NumWorkers <= 1) {
+		for (int32 i = 0; i < NumBodies; ++i) {
+			Accelerations[i] = FVector3d::ZeroVector;
+		}
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			AccumulateRow(i, Accelerations);
+		}
+		return;
+	}
+
+	WorkerAccelerations.SetNumUninitialized(NumWorkers * NumBodies);
+
+	ParallelFor(NumWorkers, [&](int32 Worker) {
+		FVector3d* WorkerOut = WorkerAccelerations.GetData() + Worker * NumBodies;
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			WorkerOut[i] = FVector3d::ZeroVector;
+		}
+
+		// Rows get shorter as i grows, interleaving them keeps the workers balanced
+		for (int32 i = Worker; i < NumBodies; i += NumWorkers) {
+			AccumulateRow(i, WorkerOut);
+		}
+	});
+
+	ParallelForBodies(NumBodies, [&](int32 Start, int32 End) {
+		for (int32 i = Start; i < End; ++i) {
+			FVector3d Sum = FVector3d::ZeroVector;
+
+			for (int32 Worker = 0; Worker < NumWorkers; ++Worker) {
+				Sum += WorkerAccelerations[Worker * NumBodies + i];
+			}
+
+			Accelerations[i] = Sum;
+		}
+	});
+}
+
+void FNBodySimulation::ComputeAccelerationsSimd(FNBodyState& InOutState)
+{
+	SourceBlock.Pack(InOutState.Positions, InOutState.Masses);
+
+	// Every body sums over all other sources on its own, so each pair is evaluated from both sides
+	INC_DWORD_STAT_BY(STAT_SolarSystem_PairInteractions, (int64)InOutState.Num() * (InOutState.Num() - 1));
+
+	ParallelForBodies(InOutState.Num(), [&](int32 Start, int32 End) {
+		for (int32 i = Start; i < End; ++i) {
+			InOutState.Accelerations[i] = GravityKernel::AccumulateAcceleration(SourceBlock, InOutState.Positions[i], GravitationalConstant, MinDistance, Softening);
+		}
+	});
+}
+
+void FNBodySimulation::ComputeAccelerationsBarnesHut(FNBodyState& InOutState)
+{
+	Octree.Build(InOutState.Positions, InOutState.Masses);
+
+	ParallelForBodies(InOutState.Num(), [&](int32 Start, int32 End) {
+		int64 Interactions = 0;
+
+		for (int32 i = Start; i < End; ++i) {
+			InOutState.Accelerations[i] = Octree.ComputeAcceleration(InOutState.Positions[i], i, OpeningAngle, GravitationalConstant, MinDistance, Softening, &Interactions);
+		}
+
+		INC_DWORD_STAT_BY(STAT_SolarSystem_PairInteractions, Interactions);
+	});
+}
+
+void FNBodySimulation::ComputeAccelerationsOf(FNBodyState& InOutState, TConstArrayView<int32> Targets)
+{
+	const int32 NumBodies = InOutState.Num();
+	const FVector3d* Positions = InOutState.Positions.GetData();
+	const double* Masses = InOutState.Masses.GetData();
+	FVector3d* Accelerations = InOutState.Accelerations.GetData();
+
+	if (Solver == EGravitySolver::BarnesHut) {
+		Octree.Build(InOutState.Positions, InOutState.Masses);
+
+		ParallelForBodies(Targets.Num(), [&](int32 Start, int32 End) {
+			int64 Interactions = 0;
+
+			for (int32 k = Start; k < End; ++k) {
+				const int32 i = Targets[k];
+				Accelerations[i] = Octree.ComputeAcceleration(Positions[i], i, OpeningAngle, GravitationalConstant, MinDistance, Softening, &Interactions);
+			}
+
+			INC_DWORD_STAT_BY(STAT_SolarSystem_PairInteractions, Interactions);
+		});
+		return;
+	}
+
+	// No symmetric shortcut here, every target sums over all other bodies on its own
+	INC_DWORD_STAT_BY(STAT_SolarSystem_PairInteractions, (int64)Targets.Num() * (NumBodies - 1));
+
+	if (UseSimdKernel) {
+		SourceBlock.Pack(InOutState.Positions, InOutState.Masses);
+
+		ParallelForBodies(Targets.Num(), [&](int32 Start, int32 End) {
+			for (int32 k = Start; k < End; ++k) {
+				const int32 i = Targets[k];
+				Accelerations[i] = GravityKernel::AccumulateAcceleration(SourceBlock, Positions[i], GravitationalConstant, MinDistance, Softening);
+			}
+		});
+		return;
+	}
+
+	const double MinDistanceSquared = MinDistance * MinDistance;
+	const double SofteningSquared = Softening * Softening;
+
+	ParallelForBodies(Targets.Num(), [&](int32 Start, int32 End) {
+		for (int32 k = Start; k < End; ++k) {
+			const int32 i = Targets[k];
+			const FVector3d PositionI = Positions[i];
+			FVector3d Acceleration = FVector3d::ZeroVector;
+
+			for (int32 j = 0; j < NumBodies; ++j) {
+				const FVector3d Direction = Positions[j] - PositionI;
+				const double DistanceSquared = Direction.SizeSquared();
+
+				if (j == i || DistanceSquared < MinDistanceSquared) {
+					continue;
+				}
+
+				const double InvDistance = 1.0 / FMath::Sqrt(DistanceSquared + SofteningSquared);
+				Acceleration += Direction * (GravitationalConstant * InvDistance * InvDistance * InvDistance * Masses[j]);
+			}
+
+			Accelerations[i] = Acceleration;
+		}
+	});
+}
+
+void FNBodySimulation::Kick(FNBodyState& InOutState, double DeltaTime) const
+{
+	if (HasKinematicBodies(InOutState)) {
+		ParallelForBodies(IntegratedBodies.Num(), [&](int32 Start, int32 End) {
+			for (int32 k = Start; k < End; ++k) {
+				const int32 i = IntegratedBodies[k];
+				InOutState.Velocities[i] += InOutState.Accelerations[i] * DeltaTime;
+			}
+		});
+		return;
+	}
+
+	ParallelForBodies(InOutState.Num(), [&](int32 Start, int32 End) {
+		for (int32 i = Start; i < End; ++i) {
+			InOutState.Velocities[i] += InOutState.Accelerations[i] * DeltaTime;
+		}
+	});
+}
+
+void FNBodySimulation::Drift(FNBodyState& InOutState, double DeltaTime) const
+{
+	InOutState.Time += DeltaTime;
+
+	if (!HasKinematicBodies(InOutState)) {
+		ParallelForBodies(InOutState.Num(), [&](int32 Start, int32 End) {
+			for (int32 i = Start; i < End; ++i) {
+				InOutState.Positions[i] += InOutState.Velocities[i] * DeltaTime;
+			}
+		});
+		return;
+	}
+
+	ParallelForBodies(IntegratedBodies.Num(), [&](int32 Start, int32 End) {
+		for (int32 k = Start; k < End; ++k) {
+			const int32 i = IntegratedBodies[k];
+			InOutState.Positions[i] += InOutState.Velocities[i] * DeltaTime;
+		}
+	});
+
+	// After the integrated bodies, the kinematic ones may be placed relative to them
+	if (PlaceKinematicBodies) {
+		PlaceKinematicBodies(InOutState);
+	}
+}
+
+void FNBodySimulation::StepVerlet(FNBodyState& InOutState, double DeltaTime)
+{
+	Kick(InOutState, DeltaTime * 0.5);
+	Drift(InOutState, DeltaTime);
+	ComputeAccelerations(InOutState);
+	Kick(InOutState, DeltaTime * 0.5);
+}
+
+double FNBodySimulation::ComputeTotalEnergy(const FNBodyState& InState) const
+{
+	const int32 NumBodies = InState.Num();
+	const int32 NumWorkers = FMath::Max(GetNumWorkers(NumBodies), 1);
+	const double MinDistanceSquared = MinDistance * MinDistance;
+	const double SofteningSquared = Softening * Softening;
+
+	TArray<double> WorkerEnergy;
+	WorkerEnergy.SetNumZeroed(NumWorkers);
+
+	ParallelFor(NumWorkers, [&](int32 Worker) {
+		double Energy = 0.0;
+
+		for (int32 i = Worker; i < NumBodies; i += NumWorkers) {
+			const FVector3d PositionI = InState.Positions[i];
+			double Potential = 0.0;
+
+			for (int32 j = i + 1; j < NumBodies; ++j) {
+				const double DistanceSquared = FVector3d::DistSquared(InState.Positions[j], PositionI);
+
+				if (DistanceSquared >= MinDistanceSquared) {
+					Potential += InState.Masses[j] / FMath::Sqrt(DistanceSquared + SofteningSquared);
+				}
+			}
+
+			Energy += 0.5 * InState.Masses[i] * InState.Velocities[i].SizeSquared() - GravitationalConstant * InState.Masses[i] * Potential;
+		}
+
+		WorkerEnergy[Worker] = Energy;
+	}, NumWorkers <= 1);
+
+	double Energy = 0.0;
+	for (double Partial : WorkerEnergy) {
+		Energy += Partial;
+	}
+
+	return Energy;
+}
+
+void FNBodySimulation::Step(FNBodyState& InOutState, double DeltaTime)
+{
+	SOLARSYSTEM_SCOPE(Step);
+
+	// Every drift moves the time along, so kinematic bodies are placed at each force evaluation
+	const double EndTime = InOutState.Time + DeltaTime;
+
+	switch (Integrator) {
+	case EIntegrator::SemiImplicitEuler:
+		Kick(InOutState, DeltaTime);
+		Drift(InOutState, DeltaTime);
+		ComputeAccelerations(InOutState);
+		break;
+
+	case EIntegrator::Yoshida4:
+	{
+		// Triple jump: three leapfrog steps whose weights cancel the third order error
+		const double CubeRootTwo = FMath::Pow(2.0, 1.0 / 3.0);
+		const double W1 = 1.0 / (2.0 - CubeRootTwo);
+		const double W0 = -CubeRootTwo / (2.0 - CubeRootTwo);
+
+		StepVerlet(InOutState, W1 * DeltaTime);
+		StepVerlet(InOutState, W0 * DeltaTime);
+		StepVerlet(InOutState, W1 * DeltaTime);
+		break;
+	}
+
+	case EIntegrator::VelocityVerlet:
+	default:
+		StepVerlet(InOutState, DeltaTime);
+		break;
+	}
+
+	// The Yoshida weights only add up to one within rounding
+	InOutState.Time = EndTime;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BarnesHutOctree.h"
+#include "GravityKernel.h"
+#include "NBodySimulation.generated.h"
+
+UENUM(BlueprintType)
+enum class EGravitySolver : uint8
+{
+	// Exact O(N^2) sum over every pair
+	Direct,
+	// O(N log N) octree approximation controlled by the opening angle
+	BarnesHut
+};
+
+UENUM(BlueprintType)
+enum class EIntegrator : uint8
+{
+	// First order, one force evaluation per step
+	SemiImplicitEuler,
+	// Second order symplectic kick-drift-kick leapfrog, one force evaluation per step
+	VelocityVerlet,
+	// Fourth order symplectic Yoshida / Forest-Ruth composition, three force evaluations per step
+	Yoshida4
+};
+
+// Contiguous, double precision state of the simulated bodies.
+// Index i refers to the same body in every array.
+struct SOLARSYSTEM2_API FNBodyState
+{
+	TArray<FVector3d> Positions;
+	TArray<FVector3d> Velocities;
+	TArray<FVector3d> Accelerations;
+	TArray<double> Masses;
+
+	// Simulated time of this state
+	double Time = 0.0;
+
+	int32 Num() const { return Masses.Num(); }
+
+	void Empty(int32 Slack = 0);
+
+	int32 AddBody(const FVector3d& Position, const FVector3d& Velocity, double Mass);
+};
+
+class SOLARSYSTEM2_API FNBodySimulation
+{
+public:
+	FNBodyState State;
+
+	double GravitationalConstant = 0.0000000000674;
+
+	// Pairs closer than this do not interact
+	double MinDistance = 1.0;
+
+	// Plummer softening length, 0 keeps the pure inverse square law
+	double Softening = 0.0;
+
+	// Evaluate the direct sum with the packed SIMD kernel instead of the scalar pair loop
+	bool UseSimdKernel = true;
+
+	EGravitySolver Solver = EGravitySolver::Direct;
+
+	EIntegrator Integrator = EIntegrator::VelocityVerlet;
+
+	// Barnes-Hut opening angle, 0 opens every cell and reproduces the direct sum
+	double OpeningAngle = 0.5;
+
+	// Upper bound on the threads used by the force pass, 0 uses every worker
+	int32 MaxThreads = 0;
+
+	// Systems with fewer bodies than this stay on the calling thread
+	int32 ParallelThreshold = 256;
+
+	// Moves the kinematic bodies to where they are at InOutState.Time, called by Step after every drift
+	TFunction<void(FNBodyState& InOutState)> PlaceKinematicBodies;
+
+	// Copies the solver and integrator settings of Other, leaving State and scratch buffers untouched
+	void CopySettings(const FNBodySimulation& Other);
+
+	// True when every setting CopySettings copies already matches Other
+	bool HasSameSettings(const FNBodySimulation& Other) const;
+
+	void ComputeAccelerations(FNBodyState& InOutState);
+
+	// Takes the bodies flagged in Kinematic out of the integration: Step leaves their velocities alone and places them
+	// with PlaceKinematicBodies instead, while they keep pulling on the integrated bodies at each force evaluation.
+	// Their own accelerations are only computed by ComputeKinematicAccelerations. Returns true when a body went back to
+	// being integrated, its stored acceleration is then out of date.
+	bool SetKinematicBodies(TConstArrayView<bool> Kinematic);
+
+	bool HasKinematicBodies(const FNBodyState& InState) const { return KinematicBodies.Num() > 0 && KinematicStateSize == InState.Num(); }
+
+	// Accelerations of the kinematic bodies alone, against every body
+	void ComputeKinematicAccelerations(FNBodyState& InOutState);
+
+	// Advances the state by DeltaTime with the selected integrator.
+	// Expects the accelerations stored in the state to match its positions and leaves them that way.
+	void Step(FNBodyState& InOutState, double DeltaTime);
+
+	// Kinetic plus pairwise potential energy with the same softening as the force pass, O(N^2)
+	double ComputeTotalEnergy(const FNBodyState& InState) const;
+
+	void ComputeAccelerations() { ComputeAccelerations(State); }
+
+	void Step(double DeltaTime) { Step(State, DeltaTime); }
+
+	int32 GetNumWorkers(int32 NumBodies) const;
+
+	// Splits [0, NumBodies) into one contiguous range per worker and runs Function(Start, End) on each
+	void ParallelForBodies(int32 NumBodies, TFunctionRef<void(int32, int32)> Function) const;
+
+private:
+	FBarnesHutOctree Octree;
+	FGravitySourceBlock SourceBlock;
+
+	// One full acceleration array per worker for the symmetric pair loop, reduced after the pass
+	TArray<FVector3d> WorkerAccelerations;
+
+	// Split of the bodies made by SetKinematicBodies, only used while the state still has KinematicStateSize bodies
+	TArray<int32> IntegratedBodies;
+	TArray<int32> KinematicBodies;
+	int32 KinematicStateSize = 0;
+
+	void ComputeAccelerationsDirect(FNBodyState& InOutState);
+	void ComputeAccelerationsSimd(FNBodyState& InOutState);
+	void ComputeAccelerationsBarnesHut(FNBodyState& InOutState);
+
+	// Accelerations of Targets alone, every body acting as a source
+	void ComputeAccelerationsOf(FNBodyState& InOutState, TConstArrayView<int32> Targets);
+
+	void Kick(FNBodyState& InOutState, double DeltaTime) const;
+	void Drift(FNBodyState& InOutState, double DeltaTime) const;
+	void StepVerlet(FNBodyState& InOutState, double DeltaTime);
+};
@@ -0,0 +1,152 @@
+#include "OrbitPathComponent.h"
+#include "PrimitiveSceneProxy.h"
+#include "PrimitiveViewRelevance.h"
+#include "SceneManagement.h"
+#include "RenderingThread.h"
+
+// Same strip as the component, edited in place by render commands
+class FOrbitPathSceneProxy final : public FPrimitiveSceneProxy
+{
+public:
+	FOrbitPathSceneProxy(const UOrbitPathComponent* Component, const FVector& InStartPoint, const TArray<FVector>& InPoints, const FLinearColor& InColor, float InThickness)
+		: FPrimitiveSceneProxy(Component)
+		, StartPoint(InStartPoint)
+		, Points(InPoints)
+		, Color(InColor)
+		, Thickness(InThickness)
+	{
+	}
+
+	void Update(int32 Evicted, TArray<FVector>&& Appended, const FVector& InStartPoint, const FLinearColor& InColor, float InThickness)
+	{
+		Points.RemoveAt(0, FMath::Min(Evicted, Points.Num()), EAllowShrinking::No);
+		Points.Append(MoveTemp(Appended));
+		StartPoint = InStartPoint;
+		Color = InColor;
+		Thickness = InThickness;
+	}
+
+	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override
+	{
+		for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ++ViewIndex) {
+			if (!(VisibilityMap & (1 << ViewIndex))) {
+				continue;
+			}
+
+			FPrimitiveDrawInterface* PDI = Collector.GetPDI(ViewIndex);
+			FVector PreviousPoint = StartPoint;
+
+			for (const FVector& Point : Points) {
+				PDI->DrawLine(PreviousPoint, Point, Color, SDPG_World, Thickness);
+				PreviousPoint = Point;
+			}
+		}
+	}
+
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override
+	{
+		FPrimitiveViewRelevance Result;
+		Result.bDrawRelevance = IsShown(View) && Points.Num() > 0;
+		Result.bDynamicRelevance = true;
+		Result.bShadowRelevance = false;
+		return Result;
+	}
+
+	virtual SIZE_T GetTypeHash() const override
+	{
+		static size_t UniquePointer;
+		return reinterpret_cast<size_t>(&UniquePointer);
+	}
+
+	virtual uint32 GetMemoryFootprint() const override { return sizeof(*this) + GetAllocatedSize(); }
+
+	uint32 GetAllocatedSize() const { return FPrimitiveSceneProxy::GetAllocatedSize() + Points.GetAllocatedSize(); }
+
+private:
+	FVector StartPoint;
+	TArray<FVector> Points;
+	FLinearColor Color;
+	float Thickness;
+};
+
+UOrbitPathComponent::UOrbitPathComponent()
+{
+	// The proxy draws whatever it was last sent, there is nothing to tick
+	PrimaryComponentTick.bCanEverTick = false;
+	CastShadow = false;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetGenerateOverlapEvents(false);
+}
+
+FPrimitiveSceneProxy* UOrbitPathComponent::CreateSceneProxy()
+{
+	return new FOrbitPathSceneProxy(this, PathStart, PathPoints, PathColor, PathThickness);
+}
+
+FBoxSphereBounds UOrbitPathComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	// Same as a line batcher without accurate bounds, the strip moves every frame and is never culled
+	return FBoxSphereBounds(FVector::ZeroVector, FVector(HALF_WORLD_MAX), HALF_WORLD_MAX);
+}
+
+void UOrbitPathComponent::SetPath(const FVector& StartPoint, TConstArrayView<FVector3d> Points, int32 FirstPoint, const FLinearColor& Color)
+{
+	FirstPoint = FMath::Clamp(FirstPoint, 0, Points.Num());
+	const TConstArrayView<FVector3d> NewPoints = Points.RightChop(FirstPoint);
+
+	// Usually the new strip is the old one with its head behind the body and more points predicted at the tail,
+	// anything else is sent again in full
+	int32 Evicted = PathPoints.Num();
+	int32 Kept = 0;
+
+	if (NewPoints.Num() > 0) {
+		const int32 Offset = PathPoints.IndexOfByKey(FVector(NewPoints[0]));
+
+		// Only a tail that grew or stayed can be kept, a shorter one is sent again
+		if (Offset != INDEX_NONE && PathPoints.Num() - Offset <= NewPoints.Num()) {
+			const int32 Overlap = PathPoints.Num() - Offset;
+			bool Matches = true;
+
+			for (int32 k = 1; k < Overlap && Matches; ++k) {
+				Matches = PathPoints[Offset + k] == FVector(NewPoints[k]);
+			}
+
+			if (Matches) {
+				Evicted = Offset;
+				Kept = Overlap;
+			}
+		}
+	}
+
+	if (Evicted == 0 && Kept == NewPoints.Num() && StartPoint == PathStart && Color == PathColor && LineThickness == PathThickness) {
+		return;
+	}
+
+	PathStart = StartPoint;
+	PathColor = Color;
+	PathThickness = LineThickness;
+	UpdatePath(Evicted, TArray<FVector>(NewPoints.RightChop(Kept)));
+}
+
+void UOrbitPathComponent::ClearPath()
+{
+	if (PathPoints.Num() > 0) {
+		UpdatePath(PathPoints.Num(), TArray<FVector>());
+	}
+}
+
+void UOrbitPathComponent::UpdatePath(int32 Evicted, TArray<FVector>&& Appended)
+{
+	PathPoints.RemoveAt(0, Evicted, EAllowShrinking::No);
+	PathPoints.Append(Appended);
+
+	FOrbitPathSceneProxy* Proxy = static_cast<FOrbitPathSceneProxy*>(SceneProxy);
+	if (!Proxy) {
+		return;
+	}
+
+	ENQUEUE_RENDER_COMMAND(UpdateOrbitPath)(
+		[Proxy, Evicted, Appended = MoveTemp(Appended), StartPoint = PathStart, Color = PathColor, Thickness = PathThickness](FRHICommandListImmediate& RHICmdList) mutable {
+			Proxy->Update(Evicted, MoveTemp(Appended), StartPoint, Color, Thickness);
+		});
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "OrbitPathComponent.generated.h"
+
+// Persistent line strip for one orbit, drawn by a render proxy that lives as long as the component.
+// Frames only send the render thread what moved: points that fell behind the body are evicted at the head,
+// newly predicted ones are appended at the tail, so the proxy is never rebuilt while the orbit is drawn.
+// Unlike DrawDebugLine this is not compiled out of shipping builds.
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class SOLARSYSTEM2_API UOrbitPathComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UOrbitPathComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit")
+	float LineThickness = 5.0f;
+
+	// Strip from StartPoint through Points[FirstPoint..]
+	void SetPath(const FVector& StartPoint, TConstArrayView<FVector3d> Points, int32 FirstPoint, const FLinearColor& Color);
+
+	void ClearPath();
+
+	int32 NumSegments() const { return PathPoints.Num(); }
+
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	// Game thread copy of what the proxy draws, a new proxy starts from it
+	FVector PathStart = FVector::ZeroVector;
+	TArray<FVector> PathPoints;
+	FLinearColor PathColor = FLinearColor::White;
+	float PathThickness = 0.0f;
+
+	// Drops Evicted points from the head and appends Appended at the tail, on both threads
+	void UpdatePath(int32 Evicted, TArray<FVector>&& Appended);
+};
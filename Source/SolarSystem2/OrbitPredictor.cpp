@@ -0,0 +1,247 @@
+#include "OrbitPredictor.h"
+#include "SolarSystemStats.h"
+
+void FOrbitPredictor::Restart(const FNBodyState& Current)
+{
+	Capacity = FMath::Max(Capacity, 2);
+
+	TailState = Current;
+	Samples.SetNumUninitialized(Capacity * TailState.Num());
+	SampleTimes.SetNumUninitialized(Capacity);
+	Head = 0;
+	Count = 0;
+	Valid = true;
+
+	PushTailSample();
+}
+
+void FOrbitPredictor::PushTailSample()
+{
+	const int32 NumBodies = TailState.Num();
+	const int32 Slot = GetSlot(Count);
+
+	FMemory::Memcpy(Samples.GetData() + Slot * NumBodies, TailState.Positions.GetData(), NumBodies * sizeof(FVector3d));
+	SampleTimes[Slot] = TailState.Time;
+	Count++;
+}
+
+void FOrbitPredictor::DropExpiredSamples(double CurrentTime)
+{
+	// Keep the newest sample at or before CurrentTime so the current position stays bracketed
+	while (Count >= 2 && SampleTimes[GetSlot(1)] <= CurrentTime) {
+		Head = (Head + 1) % Capacity;
+		Count--;
+	}
+}
+
+const FVector3d& FOrbitPredictor::GetPosition(int32 SampleIndex, int32 BodyIndex) const
+{
+	return Samples[GetSlot(SampleIndex) * TailState.Num() + BodyIndex];
+}
+
+double FOrbitPredictor::GetSampleTime(int32 SampleIndex) const
+{
+	return SampleTimes[GetSlot(SampleIndex)];
+}
+
+double FOrbitPredictor::MeasureError(const FNBodyState& Current) const
+{
+	if (Count == 0 || Current.Num() != TailState.Num()) {
+		return -1.0;
+	}
+
+	const double StartTime = GetSampleTime(0);
+	if (Current.Time < StartTime - UE_KINDA_SMALL_NUMBER) {
+		return -1.0;
+	}
+
+	int32 NextSample = 0;
+	double Alpha = 0.0;
+
+	if (Count >= 2) {
+		const double EndTime = GetSampleTime(1);
+		if (Current.Time > EndTime + UE_KINDA_SMALL_NUMBER) {
+			return -1.0;
+		}
+
+		NextSample = 1;
+		Alpha = FMath::Clamp((Current.Time - StartTime) / FMath::Max(EndTime - StartTime, UE_DOUBLE_SMALL_NUMBER), 0.0, 1.0);
+	} else if (Current.Time > StartTime + UE_KINDA_SMALL_NUMBER) {
+		return -1.0;
+	}
+
+	double MaxError = 0.0;
+
+	for (int32 i = 0; i < Current.Num(); ++i) {
+		const FVector3d Predicted = FMath::Lerp(GetPosition(0, i), GetPosition(NextSample, i), Alpha);
+		MaxError = FMath::Max(MaxError, FVector3d::Dist(Predicted, Current.Positions[i]));
+	}
+
+	return MaxError;
+}
+
+bool FOrbitPredictor::Update(const FNBodyState& Current, FNBodySimulation& Simulation, int32 MaxNewSamples)
+{
+	bool Kept = Valid && Current.Num() == TailState.Num() && Samples.Num() == Capacity * TailState.Num();
+
+	if (Kept) {
+		DropExpiredSamples(Current.Time);
+
+		const double Error = MeasureError(Current);
+		Kept = Error >= 0.0 && Error <= Tolerance;
+	}
+
+	if (!Kept) {
+		Restart(Current);
+
+		// The accelerations cached in Current may be stale, the manager only evaluates them at its next step
+		Simulation.ComputeAccelerations(TailState);
+	}
+
+	const int32 StepsPerSample = FMath::Max(FMath::CeilToInt(SampleInterval / FMath::Max(MaxStepSize, UE_DOUBLE_SMALL_NUMBER)), 1);
+	const double StepSize = SampleInterval / StepsPerSample;
+	int32 Added = 0;
+
+	while (Count < Capacity && Added < MaxNewSamples) {
+		for (int32 Step = 0; Step < StepsPerSample; ++Step) {
+			Simulation.Step(TailState, StepSize);
+		}
+
+		PushTailSample();
+		Added++;
+	}
+
+	return Kept;
+}
+
+FAsyncOrbitPredictor::FAsyncOrbitPredictor()
+	: JobData(MakeShared<FJobData, ESPMode::ThreadSafe>())
+{
+}
+
+FAsyncOrbitPredictor::~FAsyncOrbitPredictor()
+{
+	Wait();
+}
+
+bool FAsyncOrbitPredictor::IsBusy() const
+{
+	return Task.IsValid() && !Task.IsCompleted();
+}
+
+void FAsyncOrbitPredictor::Wait()
+{
+	if (Task.IsValid()) {
+		Task.Wait();
+	}
+}
+
+bool FAsyncOrbitPredictor::TryLaunch(const FNBodyState& Snapshot, const FNBodySimulation& Simulation, const FOrbitPredictionSettings& Settings, TArray<FOrbitTrajectoryRequest> Requests, bool Invalidate)
+{
+	if (IsBusy()) {
+		return false;
+	}
+
+	// No job is running, so the job data belongs to this thread until the launch
+	FJobData& Data = *JobData;
+	Data.Snapshot = Snapshot;
+	Data.Simulation.CopySettings(Simulation);
+	Data.Settings = Settings;
+	Data.Requests = MoveTemp(Requests);
+	Data.Invalidate = Invalidate;
+
+	Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Data = JobData]() {
+		Data->Run();
+	});
+
+	return true;
+}
+
+TConstArrayView<FOrbitTrajectory> FAsyncOrbitPredictor::GetTrajectories() const
+{
+	const int32 Front = JobData->FrontBuffer.load(std::memory_order_acquire);
+
+	if (Front == INDEX_NONE) {
+		return TConstArrayView<FOrbitTrajectory>();
+	}
+
+	return JobData->Buffers[Front];
+}
+
+void FAsyncOrbitPredictor::FJobData::Run()
+{
+	SOLARSYSTEM_SCOPE(OrbitPrediction);
+
+	if (Invalidate || Predictor.Capacity != Settings.Capacity || Predictor.SampleInterval != Settings.SampleInterval) {
+		Predictor.Invalidate();
+	}
+
+	Predictor.Capacity = Settings.Capacity;
+	Predictor.SampleInterval = Settings.SampleInterval;
+	Predictor.MaxStepSize = Settings.MaxStepSize;
+	Predictor.Tolerance = Settings.Tolerance;
+
+	Predictor.Update(Snapshot, Simulation, Settings.MaxNewSamples);
+
+	// The game thread only reads the front buffer and only launches once this job is done,
+	// so the back buffer is free to overwrite
+	const int32 Back = FrontBuffer.load(std::memory_order_acquire) == 0 ? 1 : 0;
+	Publish(Buffers[Back]);
+	FrontBuffer.store(Back, std::memory_order_release);
+}
+
+void FAsyncOrbitPredictor::FJobData::Publish(TArray<FOrbitTrajectory>& OutTrajectories) const
+{
+	const int32 NumBodies = Predictor.NumBodies();
+	const int32 NumSamples = Predictor.NumSamples();
+
+	OutTrajectories.SetNum(NumBodies);
+
+	for (int32 BodyIndex = 0; BodyIndex < NumBodies; ++BodyIndex) {
+		FOrbitTrajectory& Trajectory = OutTrajectories[BodyIndex];
+		Trajectory.Points.Reset();
+
+		const FOrbitTrajectoryRequest Request = Requests.IsValidIndex(BodyIndex) ? Requests[BodyIndex] : FOrbitTrajectoryRequest();
+
+		if (Request.Horizon <= 0.0 || NumSamples == 0) {
+			continue;
+		}
+
+		const double LastTime = Predictor.GetSampleTime(NumSamples - 1);
+		const double EndTime = FMath::Min(Snapshot.Time + Request.Horizon, LastTime);
+
+		if (Request.NumSamples < 2) {
+			Trajectory.StartTime = Predictor.GetSampleTime(0);
+			Trajectory.TimeStep = Predictor.SampleInterval;
+
+			for (int32 Sample = 0; Sample < NumSamples && Predictor.GetSampleTime(Sample) <= EndTime; ++Sample) {
+				Trajectory.Points.Add(Predictor.GetPosition(Sample, BodyIndex));
+			}
+			continue;
+		}
+
+		Trajectory.StartTime = Snapshot.Time;
+		Trajectory.TimeStep = Request.Horizon / (Request.NumSamples - 1);
+		Trajectory.Points.Reserve(Request.NumSamples);
+
+		int32 Sample = 0;
+
+		for (int32 Point = 0; Point < Request.NumSamples; ++Point) {
+			const double Time = Trajectory.StartTime + Point * Trajectory.TimeStep;
+			if (Time > EndTime) {
+				break;
+			}
+
+			while (Sample + 1 < NumSamples - 1 && Predictor.GetSampleTime(Sample + 1) < Time) {
+				Sample++;
+			}
+
+			const int32 NextSample = FMath::Min(Sample + 1, NumSamples - 1);
+			const double StartTime = Predictor.GetSampleTime(Sample);
+			const double Span = Predictor.GetSampleTime(NextSample) - StartTime;
+			const double Alpha = Span > 0.0 ? FMath::Clamp((Time - StartTime) / Span, 0.0, 1.0) : 0.0;
+
+			Trajectory.Points.Add(FMath::Lerp(Predictor.GetPosition(Sample, BodyIndex), Predictor.GetPosition(NextSample, BodyIndex), Alpha));
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimulation.h"
+#include "Tasks/Task.h"
+#include <atomic>
+
+// Predicted trajectories of every body, shared by all orbit lines.
+// Samples live in a ring buffer: the head is dropped as simulated time passes and only the tail is integrated further.
+class SOLARSYSTEM2_API FOrbitPredictor
+{
+public:
+	// Simulated seconds between two stored samples
+	double SampleInterval = 1.0;
+
+	// Upper bound on the integration step used between samples
+	double MaxStepSize = 0.1;
+
+	// Number of samples kept per body, the horizon is Capacity * SampleInterval
+	int32 Capacity = 1000;
+
+	// Distance between prediction and simulation beyond which the buffer is thrown away
+	double Tolerance = 100.0;
+
+	// Forces a full rebuild on the next Update, for body edits and additions
+	void Invalidate() { Valid = false; }
+
+	bool IsValid() const { return Valid; }
+
+	// Drops samples older than Current.Time and integrates at most MaxNewSamples more at the tail.
+	// Returns false when the prediction had to be restarted from Current.
+	bool Update(const FNBodyState& Current, FNBodySimulation& Simulation, int32 MaxNewSamples);
+
+	int32 NumBodies() const { return TailState.Num(); }
+
+	int32 NumSamples() const { return Count; }
+
+	// Sample 0 is the oldest one still in the buffer
+	const FVector3d& GetPosition(int32 SampleIndex, int32 BodyIndex) const;
+
+	double GetSampleTime(int32 SampleIndex) const;
+
+	// Largest distance between the prediction and Current at Current.Time, or a negative value if it is not covered
+	double MeasureError(const FNBodyState& Current) const;
+
+private:
+	bool Valid = false;
+
+	// State at the time of the newest sample, integration resumes from here
+	FNBodyState TailState;
+
+	// Capacity rows of NumBodies positions
+	TArray<FVector3d> Samples;
+	TArray<double> SampleTimes;
+
+	int32 Head = 0;
+	int32 Count = 0;
+
+	int32 GetSlot(int32 SampleIndex) const { return (Head + SampleIndex) % Capacity; }
+
+	void Restart(const FNBodyState& Current);
+	void PushTailSample();
+	void DropExpiredSamples(double CurrentTime);
+};
+
+// Evenly spaced predicted positions of one body, Points[k] is at StartTime + k * TimeStep
+struct FOrbitTrajectory
+{
+	double StartTime = 0.0;
+	double TimeStep = 0.0;
+	TArray<FVector3d> Points;
+};
+
+// What one body wants drawn: a time span and a point count (0 keeps the shared sample spacing)
+struct FOrbitTrajectoryRequest
+{
+	double Horizon = 0.0;
+	int32 NumSamples = 0;
+};
+
+struct FOrbitPredictionSettings
+{
+	int32 Capacity = 1000;
+	double SampleInterval = 1.0;
+	double MaxStepSize = 0.1;
+	double Tolerance = 100.0;
+	int32 MaxNewSamples = 200;
+};
+
+// Runs FOrbitPredictor on a background task against a snapshot of the simulation.
+// Finished trajectories are published into one of two buffers, the game thread reads the front one without locking.
+class SOLARSYSTEM2_API FAsyncOrbitPredictor
+{
+public:
+	FAsyncOrbitPredictor();
+
+	~FAsyncOrbitPredictor();
+
+	bool IsBusy() const;
+
+	// Starts a prediction job unless one is still running. Returns false if nothing was launched.
+	bool TryLaunch(const FNBodyState& Snapshot, const FNBodySimulation& Simulation, const FOrbitPredictionSettings& Settings, TArray<FOrbitTrajectoryRequest> Requests, bool Invalidate);
+
+	// Latest published trajectories, indexed by body, empty until the first job finishes
+	TConstArrayView<FOrbitTrajectory> GetTrajectories() const;
+
+	void Wait();
+
+private:
+	struct FJobData
+	{
+		FOrbitPredictor Predictor;
+		FNBodySimulation Simulation;
+		FNBodyState Snapshot;
+		FOrbitPredictionSettings Settings;
+		TArray<FOrbitTrajectoryRequest> Requests;
+		bool Invalidate = false;
+
+		TArray<FOrbitTrajectory> Buffers[2];
+		std::atomic<int32> FrontBuffer { INDEX_NONE };
+
+		void Run();
+		void Publish(TArray<FOrbitTrajectory>& OutTrajectories) const;
+	};
+
+	TSharedRef<FJobData, ESPMode::ThreadSafe> JobData;
+	UE::Tasks::FTask Task;
+};
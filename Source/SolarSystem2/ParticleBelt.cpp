@@ -0,0 +1,144 @@
+#include "ParticleBelt.h"
+#include "SolarSystemStats.h"
+#include "Async/ParallelFor.h"
+
+void FTestParticleSimulation::Empty(int32 Slack)
+{
+	for (TArray<double>* Array : { &PositionX, &PositionY, &PositionZ, &VelocityX, &VelocityY, &VelocityZ, &AccelerationX, &AccelerationY, &AccelerationZ }) {
+		Array->Empty(Slack);
+	}
+}
+
+int32 FTestParticleSimulation::AddParticle(const FVector3d& Position, const FVector3d& Velocity)
+{
+	PositionX.Add(Position.X);
+	PositionY.Add(Position.Y);
+	PositionZ.Add(Position.Z);
+	VelocityX.Add(Velocity.X);
+	VelocityY.Add(Velocity.Y);
+	VelocityZ.Add(Velocity.Z);
+	AccelerationX.Add(0.0);
+	AccelerationY.Add(0.0);
+	return AccelerationZ.Add(0.0);
+}
+
+void FTestParticleSimulation::GetPositions(TArray<FVector3d>& OutPositions) const
+{
+	OutPositions.SetNumUninitialized(Num());
+
+	for (int32 i = 0; i < Num(); ++i) {
+		OutPositions[i] = GetPosition(i);
+	}
+}
+
+void FTestParticleSimulation::GatherSources(const FNBodyState& Massive)
+{
+	SourceX.Reset();
+	SourceY.Reset();
+	SourceZ.Reset();
+	SourceMu.Reset();
+
+	for (int32 i = 0; i < Massive.Num(); ++i) {
+		if (Massive.Masses[i] > 0.0) {
+			SourceX.Add(Massive.Positions[i].X);
+			SourceY.Add(Massive.Positions[i].Y);
+			SourceZ.Add(Massive.Positions[i].Z);
+			SourceMu.Add(GravitationalConstant * Massive.Masses[i]);
+		}
+	}
+}
+
+void FTestParticleSimulation::ParallelForBlocks(TFunctionRef<void(int32, int32)> Function) const
+{
+	const int32 Size = FMath::Max(BlockSize, 64);
+	const int32 NumBlocks = FMath::DivideAndRoundUp(Num(), Size);
+
+	if (NumBlocks <= 1 || MaxThreads == 1 || !FTaskGraphInterface::IsRunning()) {
+		Function(0, Num());
+		return;
+	}
+
+	ParallelFor(NumBlocks, [&](int32 Block) {
+		Function(Block * Size, FMath::Min((Block + 1) * Size, Num()));
+	});
+}
+
+void FTestParticleSimulation::AccumulateAccelerations(int32 Start, int32 End)
+{
+	const double MinDistanceSquared = MinDistance * MinDistance;
+	const double SofteningSquared = Softening * Softening;
+
+	double* RESTRICT AX = AccelerationX.GetData();
+	double* RESTRICT AY = AccelerationY.GetData();
+	double* RESTRICT AZ = AccelerationZ.GetData();
+	const double* RESTRICT PX = PositionX.GetData();
+	const double* RESTRICT PY = PositionY.GetData();
+	const double* RESTRICT PZ = PositionZ.GetData();
+
+	for (int32 i = Start; i < End; ++i) {
+		AX[i] = 0.0;
+		AY[i] = 0.0;
+		AZ[i] = 0.0;
+	}
+
+	// Sources outside, particles inside: the inner loop is branch free and runs across SIMD lanes
+	for (int32 Source = 0; Source < SourceMu.Num(); ++Source) {
+		const double SX = SourceX[Source];
+		const double SY = SourceY[Source];
+		const double SZ = SourceZ[Source];
+		const double Mu = SourceMu[Source];
+
+		for (int32 i = Start; i < End; ++i) {
+			const double DX = SX - PX[i];
+			const double DY = SY - PY[i];
+			const double DZ = SZ - PZ[i];
+			const double DistanceSquared = DX * DX + DY * DY + DZ * DZ;
+
+			const double InvDistance = 1.0 / FMath::Sqrt(DistanceSquared + SofteningSquared);
+			const double Scale = DistanceSquared < MinDistanceSquared ? 0.0 : Mu * InvDistance * InvDistance * InvDistance;
+
+			AX[i] += DX * Scale;
+			AY[i] += DY * Scale;
+			AZ[i] += DZ * Scale;
+		}
+	}
+}
+
+void FTestParticleSimulation::ComputeAccelerations(const FNBodyState& Massive)
+{
+	GatherSources(Massive);
+
+	ParallelForBlocks([this](int32 Start, int32 End) {
+		AccumulateAccelerations(Start, End);
+	});
+}
+
+void FTestParticleSimulation::Step(const FNBodyState& Massive, double DeltaTime)
+{
+	SOLARSYSTEM_SCOPE(Particles);
+
+	GatherSources(Massive);
+
+	const double HalfStep = DeltaTime * 0.5;
+
+	// Kick, drift, new force, kick, all on one block while it is in cache
+	ParallelForBlocks([this, DeltaTime, HalfStep](int32 Start, int32 End) {
+		for (int32 i = Start; i < End; ++i) {
+			VelocityX[i] += AccelerationX[i] * HalfStep;
+			VelocityY[i] += AccelerationY[i] * HalfStep;
+			VelocityZ[i] += AccelerationZ[i] * HalfStep;
+
+			PositionX[i] += VelocityX[i] * DeltaTime;
+			PositionY[i] += VelocityY[i] * DeltaTime;
+			PositionZ[i] += VelocityZ[i] * DeltaTime;
+		}
+
+		AccumulateAccelerations(Start, End);
+
+		for (int32 i = Start; i < End; ++i) {
+			VelocityX[i] += AccelerationX[i] * HalfStep;
+			VelocityY[i] += AccelerationY[i] * HalfStep;
+			VelocityZ[i] += AccelerationZ[i] * HalfStep;
+		}
+	});
+}
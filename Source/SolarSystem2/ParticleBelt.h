@@ -0,0 +1,103 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimulation.h"
+#include "ParticleBelt.generated.h"
+
+class ACelestialBody;
+
+// A ring of massless particles spawned on near circular orbits around one body
+USTRUCT(BlueprintType)
+struct SOLARSYSTEM2_API FParticleBelt
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ToolTip = "Body the belt orbits, the heaviest body when empty"))
+	TObjectPtr<ACelestialBody> CentralBody = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "0"))
+	int32 Count = 10000;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "1"))
+	float InnerRadius = 2000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "1"))
+	float OuterRadius = 3000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "0", ToolTip = "Spread above and below the belt plane"))
+	float Thickness = 50.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "0", ClampMax = "0.9"))
+	float MaxEccentricity = 0.05f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ToolTip = "Orbit normal, particles circle counterclockwise around it"))
+	FVector Normal = FVector::UpVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "0"))
+	float MinScale = 0.2f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt", meta = (ClampMin = "0"))
+	float MaxScale = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Belt")
+	int32 Seed = 1;
+};
+
+// Test particles: they feel every massive body of an FNBodyState but neither each other nor pull back,
+// so a step costs O(particles x massive bodies). Stored as structure of arrays so the inner loops vectorize.
+class SOLARSYSTEM2_API FTestParticleSimulation
+{
+public:
+	TArray<double> PositionX;
+	TArray<double> PositionY;
+	TArray<double> PositionZ;
+	TArray<double> VelocityX;
+	TArray<double> VelocityY;
+	TArray<double> VelocityZ;
+	TArray<double> AccelerationX;
+	TArray<double> AccelerationY;
+	TArray<double> AccelerationZ;
+
+	double GravitationalConstant = 0.0000000000674;
+
+	// Massive bodies closer than this do not pull, matching FNBodySimulation
+	double MinDistance = 1.0;
+
+	double Softening = 0.0;
+
+	// 1 keeps every step on the calling thread, anything else spreads the blocks over the task graph
+	int32 MaxThreads = 0;
+
+	// Particles handed to one task
+	int32 BlockSize = 2048;
+
+	int32 Num() const { return PositionX.Num(); }
+
+	void Empty(int32 Slack = 0);
+
+	int32 AddParticle(const FVector3d& Position, const FVector3d& Velocity);
+
+	FVector3d GetPosition(int32 Index) const { return FVector3d(PositionX[Index], PositionY[Index], PositionZ[Index]); }
+
+	void GetPositions(TArray<FVector3d>& OutPositions) const;
+
+	// Accelerations for the current positions. Needed before the first Step and whenever the massive bodies jumped.
+	void ComputeAccelerations(const FNBodyState& Massive);
+
+	// Velocity Verlet over DeltaTime in one pass per particle. Massive must already be at the end of the step,
+	// the cached accelerations stand for its start.
+	void Step(const FNBodyState& Massive, double DeltaTime);
+
+private:
+	// G * mass and position of every massive body, gathered once per step
+	TArray<double> SourceX;
+	TArray<double> SourceY;
+	TArray<double> SourceZ;
+	TArray<double> SourceMu;
+
+	void GatherSources(const FNBodyState& Massive);
+
+	void ParallelForBlocks(TFunctionRef<void(int32, int32)> Function) const;
+
+	void AccumulateAccelerations(int32 Start, int32 End);
+};
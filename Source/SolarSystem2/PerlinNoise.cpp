@@ -1,5 +1,18 @@
 #include "PerlinNoise.h"
 
+namespace
+{
+	// Perlin's twelve cube edge gradients, padded to sixteen so a hash only needs masking
+	constexpr float GradientTable[16][3] = {
+		{ 1.0f, 1.0f, 0.0f }, { -1.0f, 1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { -1.0f, -1.0f, 0.0f },
+		{ 1.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, -1.0f },
+		{ 0.0f, 1.0f, 1.0f }, { 0.0f, -1.0f, 1.0f }, { 0.0f, 1.0f, -1.0f }, { 0.0f, -1.0f, -1.0f },
+		{ 1.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, -1.0f },
+	};
+
+	constexpr int32 NumLanes = 4;
+}
+
 FPerlinNoise::FPerlinNoise()
 {
 	InitializePermutationTable(91);
@@ -12,8 +25,6 @@ FPerlinNoise::FPerlinNoise(int32 Seed)
 
 void FPerlinNoise::InitializePermutationTable(int32 Seed)
 {
-	PermutationTable.SetNum(512);
-
 	TArray<int32> BasePermutation;
 	BasePermutation.SetNum(256);
 
@@ -32,8 +43,8 @@ void FPerlinNoise::InitializePermutationTable(int32 Seed)
 	}
 
 	for (int32 i = 0; i < 256; i++)	{
-		PermutationTable[i] = BasePermutation[i];
-		PermutationTable[256 + i] = BasePermutation[i];
+		PermutationTable[i] = (uint8)BasePermutation[i];
+		PermutationTable[256 + i] = (uint8)BasePermutation[i];
 	}
 }
 
@@ -42,6 +53,11 @@ float FPerlinNoise::Fade(float t)
 	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
 }
 
+float FPerlinNoise::FadeDerivative(float t)
+{
+	return 30.0f * t * t * (t * (t - 2.0f) + 1.0f);
+}
+
 float FPerlinNoise::Lerp(float t, float A, float B)
 {
 	return A + t * (B - A);
@@ -56,6 +72,12 @@ float FPerlinNoise::Grad(int32 Hash, float X, float Y)
 	return ((H & 1) ? -U : U) + ((H & 2) ? -2.0f * V : 2.0f * V);
 }
 
+float FPerlinNoise::Grad(int32 Hash, float X, float Y, float Z)
+{
+	const float* Gradient = GradientTable[Hash & 15];
+	return Gradient[0] * X + Gradient[1] * Y + Gradient[2] * Z;
+}
+
 float FPerlinNoise::Noise2D(float X, float Y) const
 {
 	int32 Xi = FMath::FloorToInt(X) & 255;
@@ -95,4 +117,365 @@ float FPerlinNoise::FractalNoise2D(float X, float Y, int32 Octaves, float Persis
 	}
 
 	return Total / MaxValue;
-}
\ No newline at end of file
+}
+
+float FPerlinNoise::Noise3D(float X, float Y, float Z) const
+{
+	const float FloorX = FMath::FloorToFloat(X);
+	const float FloorY = FMath::FloorToFloat(Y);
+	const float FloorZ = FMath::FloorToFloat(Z);
+
+	const int32 Xi = (int32)FloorX & 255;
+	const int32 Yi = (int32)FloorY & 255;
+	const int32 Zi = (int32)FloorZ & 255;
+
+	const float Xf = X - FloorX;
+	const float Yf = Y - FloorY;
+	const float Zf = Z - FloorZ;
+
+	const float U = Fade(Xf);
+	const float V = Fade(Yf);
+	const float W = Fade(Zf);
+
+	const int32 A = PermutationTable[Xi] + Yi;
+	const int32 AA = PermutationTable[A] + Zi;
+	const int32 AB = PermutationTable[A + 1] + Zi;
+	const int32 B = PermutationTable[Xi + 1] + Yi;
+	const int32 BA = PermutationTable[B] + Zi;
+	const int32 BB = PermutationTable[B + 1] + Zi;
+
+	const float X1 = Lerp(U, Grad(PermutationTable[AA], Xf, Yf, Zf), Grad(PermutationTable[BA], Xf - 1, Yf, Zf));
+	const float X2 = Lerp(U, Grad(PermutationTable[AB], Xf, Yf - 1, Zf), Grad(PermutationTable[BB], Xf - 1, Yf - 1, Zf));
+	const float X3 = Lerp(U, Grad(PermutationTable[AA + 1], Xf, Yf, Zf - 1), Grad(PermutationTable[BA + 1], Xf - 1, Yf, Zf - 1));
+	const float X4 = Lerp(U, Grad(PermutationTable[AB + 1], Xf, Yf - 1, Zf - 1), Grad(PermutationTable[BB + 1], Xf - 1, Yf - 1, Zf - 1));
+
+	return Lerp(W, Lerp(V, X1, X2), Lerp(V, X3, X4));
+}
+
+float FPerlinNoise::FractalNoise3D(float X, float Y, float Z, int32 Octaves, float Persistence, float Lacunarity) const
+{
+	float Total = 0.0f;
+	float Frequency = 1.0f;
+	float Amplitude = 1.0f;
+	float MaxValue = 0.0f;
+
+	for (int32 i = 0; i < Octaves; i++) {
+		Total += Noise3D(X * Frequency, Y * Frequency, Z * Frequency) * Amplitude;
+
+		MaxValue += Amplitude;
+		Amplitude *= Persistence;
+		Frequency *= Lacunarity;
+	}
+
+	return Total / MaxValue;
+}
+
+float FPerlinNoise::Noise3D(float X, float Y, float Z, FVector3f& OutGradient) const
+{
+	const float FloorX = FMath::FloorToFloat(X);
+	const float FloorY = FMath::FloorToFloat(Y);
+	const float FloorZ = FMath::FloorToFloat(Z);
+
+	const int32 Xi = (int32)FloorX & 255;
+	const int32 Yi = (int32)FloorY & 255;
+	const int32 Zi = (int32)FloorZ & 255;
+
+	const float Xf = X - FloorX;
+	const float Yf = Y - FloorY;
+	const float Zf = Z - FloorZ;
+
+	const int32 A = PermutationTable[Xi] + Yi;
+	const int32 AA = PermutationTable[A] + Zi;
+	const int32 AB = PermutationTable[A + 1] + Zi;
+	const int32 B = PermutationTable[Xi + 1] + Yi;
+	const int32 BA = PermutationTable[B] + Zi;
+	const int32 BB = PermutationTable[B + 1] + Zi;
+
+	// Corner bits are the x, y and z offsets
+	const int32 Hashes[8] = {
+		PermutationTable[AA], PermutationTable[BA], PermutationTable[AB], PermutationTable[BB],
+		PermutationTable[AA + 1], PermutationTable[BA + 1], PermutationTable[AB + 1], PermutationTable[BB + 1],
+	};
+
+	FVector3f Gradients[8];
+	float Dots[8];
+
+	for (int32 Corner = 0; Corner < 8; ++Corner) {
+		const float* Gradient = GradientTable[Hashes[Corner] & 15];
+		Gradients[Corner] = FVector3f(Gradient[0], Gradient[1], Gradient[2]);
+		Dots[Corner] = Grad(Hashes[Corner], Xf - (Corner & 1), Yf - ((Corner >> 1) & 1), Zf - (Corner >> 2));
+	}
+
+	const float U = Fade(Xf);
+	const float V = Fade(Yf);
+	const float W = Fade(Zf);
+
+	const float X1 = Lerp(U, Dots[0], Dots[1]);
+	const float X2 = Lerp(U, Dots[2], Dots[3]);
+	const float X3 = Lerp(U, Dots[4], Dots[5]);
+	const float X4 = Lerp(U, Dots[6], Dots[7]);
+	const float Y1 = Lerp(V, X1, X2);
+	const float Y2 = Lerp(V, X3, X4);
+
+	// The corner gradients blended with the same weights, plus how the weights themselves move
+	const FVector3f Blended = FMath::Lerp(
+		FMath::Lerp(FMath::Lerp(Gradients[0], Gradients[1], U), FMath::Lerp(Gradients[2], Gradients[3], U), V),
+		FMath::Lerp(FMath::Lerp(Gradients[4], Gradients[5], U), FMath::Lerp(Gradients[6], Gradients[7], U), V),
+		W);
+
+	const float DValueDU = Lerp(W, Lerp(V, Dots[1] - Dots[0], Dots[3] - Dots[2]), Lerp(V, Dots[5] - Dots[4], Dots[7] - Dots[6]));
+	const float DValueDV = Lerp(W, X2 - X1, X4 - X3);
+	const float DValueDW = Y2 - Y1;
+
+	OutGradient = Blended + FVector3f(FadeDerivative(Xf) * DValueDU, FadeDerivative(Yf) * DValueDV, FadeDerivative(Zf) * DValueDW);
+	return Lerp(W, Y1, Y2);
+}
+
+float FPerlinNoise::FractalNoise3D(float X, float Y, float Z, FVector3f& OutGradient, int32 Octaves, float Persistence, float Lacunarity) const
+{
+	float Total = 0.0f;
+	float Frequency = 1.0f;
+	float Amplitude = 1.0f;
+	float MaxValue = 0.0f;
+
+	OutGradient = FVector3f::ZeroVector;
+
+	for (int32 i = 0; i < Octaves; i++) {
+		FVector3f Gradient;
+		Total += Noise3D(X * Frequency, Y * Frequency, Z * Frequency, Gradient) * Amplitude;
+
+		// Chain rule through the octave frequency
+		OutGradient += Gradient * (Amplitude * Frequency);
+
+		MaxValue += Amplitude;
+		Amplitude *= Persistence;
+		Frequency *= Lacunarity;
+	}
+
+	OutGradient /= MaxValue;
+	return Total / MaxValue;
+}
+
+// Same corners and gradients as Noise3D. Only the table lookups are done per lane,
+// fade, gradient dot products and interpolation run on all four lanes at once.
+VectorRegister4Float FPerlinNoise::Noise3DLanes(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z, VectorRegister4Float* OutGradient) const
+{
+	const VectorRegister4Float FloorX = VectorFloor(X);
+	const VectorRegister4Float FloorY = VectorFloor(Y);
+	const VectorRegister4Float FloorZ = VectorFloor(Z);
+
+	alignas(16) int32 Xi[NumLanes];
+	alignas(16) int32 Yi[NumLanes];
+	alignas(16) int32 Zi[NumLanes];
+	VectorIntStoreAligned(VectorFloatToInt(FloorX), Xi);
+	VectorIntStoreAligned(VectorFloatToInt(FloorY), Yi);
+	VectorIntStoreAligned(VectorFloatToInt(FloorZ), Zi);
+
+	// Gradient components per corner, corner bits are the x, y and z offsets
+	alignas(16) float Gradients[8][3][NumLanes];
+
+	for (int32 Lane = 0; Lane < NumLanes; ++Lane) {
+		const int32 X0 = Xi[Lane] & 255;
+		const int32 Y0 = Yi[Lane] & 255;
+		const int32 Z0 = Zi[Lane] & 255;
+
+		const int32 A = PermutationTable[X0] + Y0;
+		const int32 B = PermutationTable[X0 + 1] + Y0;
+		const int32 Corners[4] = {
+			PermutationTable[A] + Z0,
+			PermutationTable[B] + Z0,
+			PermutationTable[A + 1] + Z0,
+			PermutationTable[B + 1] + Z0,
+		};
+
+		for (int32 Corner = 0; Corner < 8; ++Corner) {
+			const float* Gradient = GradientTable[PermutationTable[Corners[Corner & 3] + (Corner >> 2)] & 15];
+			Gradients[Corner][0][Lane] = Gradient[0];
+			Gradients[Corner][1][Lane] = Gradient[1];
+			Gradients[Corner][2][Lane] = Gradient[2];
+		}
+	}
+
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float Offsets[2][3] = {
+		{ VectorSubtract(X, FloorX), VectorSubtract(Y, FloorY), VectorSubtract(Z, FloorZ) },
+		{ VectorSubtract(VectorSubtract(X, FloorX), One), VectorSubtract(VectorSubtract(Y, FloorY), One), VectorSubtract(VectorSubtract(Z, FloorZ), One) },
+	};
+
+	VectorRegister4Float Dots[8];
+	for (int32 Corner = 0; Corner < 8; ++Corner) {
+		Dots[Corner] = VectorMultiply(VectorLoadAligned(Gradients[Corner][0]), Offsets[Corner & 1][0]);
+		Dots[Corner] = VectorMultiplyAdd(VectorLoadAligned(Gradients[Corner][1]), Offsets[(Corner >> 1) & 1][1], Dots[Corner]);
+		Dots[Corner] = VectorMultiplyAdd(VectorLoadAligned(Gradients[Corner][2]), Offsets[Corner >> 2][2], Dots[Corner]);
+	}
+
+	// t * t * t * (t * (t * 6 - 15) + 10)
+	auto FadeLanes = [](const VectorRegister4Float& T) {
+		const VectorRegister4Float Inner = VectorMultiplyAdd(T, VectorMultiplyAdd(T, VectorSetFloat1(6.0f), VectorSetFloat1(-15.0f)), VectorSetFloat1(10.0f));
+		return VectorMultiply(VectorMultiply(VectorMultiply(T, T), T), Inner);
+	};
+
+	auto LerpLanes = [](const VectorRegister4Float& T, const VectorRegister4Float& A, const VectorRegister4Float& B) {
+		return VectorMultiplyAdd(T, VectorSubtract(B, A), A);
+	};
+
+	const VectorRegister4Float U = FadeLanes(Offsets[0][0]);
+	const VectorRegister4Float V = FadeLanes(Offsets[0][1]);
+	const VectorRegister4Float W = FadeLanes(Offsets[0][2]);
+
+	const VectorRegister4Float X1 = LerpLanes(U, Dots[0], Dots[1]);
+	const VectorRegister4Float X2 = LerpLanes(U, Dots[2], Dots[3]);
+	const VectorRegister4Float X3 = LerpLanes(U, Dots[4], Dots[5]);
+	const VectorRegister4Float X4 = LerpLanes(U, Dots[6], Dots[7]);
+
+	const VectorRegister4Float Y1 = LerpLanes(V, X1, X2);
+	const VectorRegister4Float Y2 = LerpLanes(V, X3, X4);
+
+	if (OutGradient) {
+		// 30 t^2 (t - 1)^2
+		auto FadeDerivativeLanes = [&One](const VectorRegister4Float& T) {
+			const VectorRegister4Float TMinusOne = VectorSubtract(T, One);
+			return VectorMultiply(VectorSetFloat1(30.0f), VectorMultiply(VectorMultiply(T, T), VectorMultiply(TMinusOne, TMinusOne)));
+		};
+
+		const VectorRegister4Float DValueDU = LerpLanes(W,
+			LerpLanes(V, VectorSubtract(Dots[1], Dots[0]), VectorSubtract(Dots[3], Dots[2])),
+			LerpLanes(V, VectorSubtract(Dots[5], Dots[4]), VectorSubtract(Dots[7], Dots[6])));
+		const VectorRegister4Float DValueDV = LerpLanes(W, VectorSubtract(X2, X1), VectorSubtract(X4, X3));
+		const VectorRegister4Float DValueDW = VectorSubtract(Y2, Y1);
+
+		const VectorRegister4Float WeightDerivatives[3] = {
+			VectorMultiply(FadeDerivativeLanes(Offsets[0][0]), DValueDU),
+			VectorMultiply(FadeDerivativeLanes(Offsets[0][1]), DValueDV),
+			VectorMultiply(FadeDerivativeLanes(Offsets[0][2]), DValueDW),
+		};
+
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			VectorRegister4Float G[8];
+			for (int32 Corner = 0; Corner < 8; ++Corner) {
+				G[Corner] = VectorLoadAligned(Gradients[Corner][Axis]);
+			}
+
+			const VectorRegister4Float Blended = LerpLanes(W,
+				LerpLanes(V, LerpLanes(U, G[0], G[1]), LerpLanes(U, G[2], G[3])),
+				LerpLanes(V, LerpLanes(U, G[4], G[5]), LerpLanes(U, G[6], G[7])));
+
+			OutGradient[Axis] = VectorAdd(Blended, WeightDerivatives[Axis]);
+		}
+	}
+
+	return LerpLanes(W, Y1, Y2);
+}
+
+template<int32 Octaves>
+void FPerlinNoise::FractalNoise3DLanes(TConstArrayView<FVector> Points, TArrayView<float> OutValues, TArrayView<FVector3f> OutGradients, float Scale, int32 RuntimeOctaves, float Persistence, float Lacunarity) const
+{
+	const int32 NumOctaves = Octaves > 0 ? Octaves : RuntimeOctaves;
+	const bool WithGradients = OutGradients.Num() > 0;
+
+	float MaxValue = 0.0f;
+	float Amplitude = 1.0f;
+	for (int32 i = 0; i < NumOctaves; i++) {
+		MaxValue += Amplitude;
+		Amplitude *= Persistence;
+	}
+
+	const VectorRegister4Float Normalize = VectorSetFloat1(1.0f / MaxValue);
+
+	// Points were scaled before sampling, so their gradient picks up Scale once more
+	const VectorRegister4Float NormalizeGradient = VectorSetFloat1(Scale / MaxValue);
+
+	for (int32 Start = 0; Start < Points.Num(); Start += NumLanes) {
+		const int32 Count = FMath::Min(NumLanes, Points.Num() - Start);
+
+		// The tail repeats its last point rather than reading past the end
+		alignas(16) float Xs[NumLanes];
+		alignas(16) float Ys[NumLanes];
+		alignas(16) float Zs[NumLanes];
+
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane) {
+			const FVector& Point = Points[Start + FMath::Min(Lane, Count - 1)];
+			Xs[Lane] = (float)Point.X * Scale;
+			Ys[Lane] = (float)Point.Y * Scale;
+			Zs[Lane] = (float)Point.Z * Scale;
+		}
+
+		const VectorRegister4Float X = VectorLoadAligned(Xs);
+		const VectorRegister4Float Y = VectorLoadAligned(Ys);
+		const VectorRegister4Float Z = VectorLoadAligned(Zs);
+
+		VectorRegister4Float Total = VectorZeroFloat();
+		VectorRegister4Float TotalGradient[3] = { VectorZeroFloat(), VectorZeroFloat(), VectorZeroFloat() };
+		float Frequency = 1.0f;
+		Amplitude = 1.0f;
+
+		for (int32 i = 0; i < NumOctaves; i++) {
+			const VectorRegister4Float FrequencyLanes = VectorSetFloat1(Frequency);
+			VectorRegister4Float Gradient[3];
+			const VectorRegister4Float Noise = Noise3DLanes(VectorMultiply(X, FrequencyLanes), VectorMultiply(Y, FrequencyLanes), VectorMultiply(Z, FrequencyLanes), WithGradients ? Gradient : nullptr);
+			Total = VectorMultiplyAdd(Noise, VectorSetFloat1(Amplitude), Total);
+
+			if (WithGradients) {
+				const VectorRegister4Float GradientScale = VectorSetFloat1(Amplitude * Frequency);
+				for (int32 Axis = 0; Axis < 3; ++Axis) {
+					TotalGradient[Axis] = VectorMultiplyAdd(Gradient[Axis], GradientScale, TotalGradient[Axis]);
+				}
+			}
+
+			Amplitude *= Persistence;
+			Frequency *= Lacunarity;
+		}
+
+		alignas(16) float Values[NumLanes];
+		VectorStoreAligned(VectorMultiply(Total, Normalize), Values);
+
+		for (int32 Lane = 0; Lane < Count; ++Lane) {
+			OutValues[Start + Lane] = Values[Lane];
+		}
+
+		if (WithGradients) {
+			alignas(16) float Gradients[3][NumLanes];
+			for (int32 Axis = 0; Axis < 3; ++Axis) {
+				VectorStoreAligned(VectorMultiply(TotalGradient[Axis], NormalizeGradient), Gradients[Axis]);
+			}
+
+			for (int32 Lane = 0; Lane < Count; ++Lane) {
+				OutGradients[Start + Lane] = FVector3f(Gradients[0][Lane], Gradients[1][Lane], Gradients[2][Lane]);
+			}
+		}
+	}
+}
+
+void FPerlinNoise::FractalNoise3DBatch(TConstArrayView<FVector> Points, TArrayView<float> OutValues, float Scale, int32 Octaves, float Persistence, float Lacunarity) const
+{
+	FractalNoise3DBatch(Points, OutValues, TArrayView<FVector3f>(), Scale, Octaves, Persistence, Lacunarity);
+}
+
+void FPerlinNoise::FractalNoise3DBatch(TConstArrayView<FVector> Points, TArrayView<float> OutValues, TArrayView<FVector3f> OutGradients, float Scale, int32 Octaves, float Persistence, float Lacunarity) const
+{
+	check(OutValues.Num() >= Points.Num());
+	check(OutGradients.Num() == 0 || OutGradients.Num() >= Points.Num());
+
+	if (Octaves <= 0) {
+		for (int32 i = 0; i < Points.Num(); i++) {
+			OutValues[i] = 0.0f;
+		}
+		for (int32 i = 0; i < OutGradients.Num(); i++) {
+			OutGradients[i] = FVector3f::ZeroVector;
+		}
+		return;
+	}
+
+	// The usual octave counts get a fully unrolled loop
+	switch (Octaves) {
+	case 1: FractalNoise3DLanes<1>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 2: FractalNoise3DLanes<2>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 3: FractalNoise3DLanes<3>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 4: FractalNoise3DLanes<4>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 5: FractalNoise3DLanes<5>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 6: FractalNoise3DLanes<6>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 7: FractalNoise3DLanes<7>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	case 8: FractalNoise3DLanes<8>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	default: FractalNoise3DLanes<0>(Points, OutValues, OutGradients, Scale, Octaves, Persistence, Lacunarity); break;
+	}
+}
@@ -12,15 +12,44 @@ public:
 
 	float FractalNoise2D(float X, float Y, int32 Octaves = 4, float Persistence = 0.5f, float Lacunarity = 2.0f) const;
 
+	// Improved Perlin noise, roughly in [-1, 1]
+	float Noise3D(float X, float Y, float Z) const;
+
+	float FractalNoise3D(float X, float Y, float Z, int32 Octaves = 4, float Persistence = 0.5f, float Lacunarity = 2.0f) const;
+
+	// Value plus its analytic gradient with respect to X, Y and Z
+	float Noise3D(float X, float Y, float Z, FVector3f& OutGradient) const;
+
+	float FractalNoise3D(float X, float Y, float Z, FVector3f& OutGradient, int32 Octaves = 4, float Persistence = 0.5f, float Lacunarity = 2.0f) const;
+
+	// FractalNoise3D of every point scaled by Scale, evaluated four points per vector register.
+	// OutValues must hold at least as many entries as Points.
+	void FractalNoise3DBatch(TConstArrayView<FVector> Points, TArrayView<float> OutValues, float Scale, int32 Octaves = 4, float Persistence = 0.5f, float Lacunarity = 2.0f) const;
+
+	// Also writes the gradient with respect to the unscaled points when OutGradients is not empty
+	void FractalNoise3DBatch(TConstArrayView<FVector> Points, TArrayView<float> OutValues, TArrayView<FVector3f> OutGradients, float Scale, int32 Octaves = 4, float Persistence = 0.5f, float Lacunarity = 2.0f) const;
+
 private:
-	TArray<int32> PermutationTable;
+	// Two copies of a 0..255 shuffle, so nested lookups never wrap
+	uint8 PermutationTable[512];
 
 	void InitializePermutationTable(int32 Seed);
 
 	// t = time ?
 	static float Fade(float t);
 
+	static float FadeDerivative(float t);
+
 	static float Lerp(float t, float A, float B);
 
 	static float Grad(int32 Hash, float X, float Y);
-};
\ No newline at end of file
+
+	static float Grad(int32 Hash, float X, float Y, float Z);
+
+	// OutGradient, when given, receives the x, y and z derivative lanes
+	VectorRegister4Float Noise3DLanes(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z, VectorRegister4Float* OutGradient = nullptr) const;
+
+	// Octaves > 0 fixes the octave loop at compile time, 0 reads RuntimeOctaves instead
+	template<int32 Octaves>
+	void FractalNoise3DLanes(TConstArrayView<FVector> Points, TArrayView<float> OutValues, TArrayView<FVector3f> OutGradients, float Scale, int32 RuntimeOctaves, float Persistence, float Lacunarity) const;
+};
@@ -0,0 +1,352 @@
+#include "PlanetHeightField.h"
+#include "SolarSystemStats.h"
+#include "PerlinNoise.h"
+#include "Async/ParallelFor.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	// Face normal and in-face axes, the texel at (X, Y) looks along Normal + U * u + V * v with u, v in [-1, 1]
+	const FVector HeightFaceAxes[FPlanetHeightField::NumFaces][3] = {
+		{ FVector(1, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1) },
+		{ FVector(-1, 0, 0), FVector(0, 0, 1), FVector(0, 1, 0) },
+		{ FVector(0, 1, 0), FVector(0, 0, 1), FVector(1, 0, 0) },
+		{ FVector(0, -1, 0), FVector(1, 0, 0), FVector(0, 0, 1) },
+		{ FVector(0, 0, 1), FVector(1, 0, 0), FVector(0, 1, 0) },
+		{ FVector(0, 0, -1), FVector(0, 1, 0), FVector(1, 0, 0) },
+	};
+
+	constexpr uint32 HeightFileMagic = 0x48544650; // 'PFTH'
+
+	struct FHeightFileHeader
+	{
+		uint32 Magic = HeightFileMagic;
+		uint32 Version = FPlanetHeightCache::FileVersion;
+		uint64 Key = 0;
+		int32 Resolution = 0;
+		int32 Reserved = 0;
+	};
+
+	// Every noise input in four byte fields, so the hash never sees padding
+	struct FHeightFieldKeyData
+	{
+		uint32 Version;
+		int32 Resolution;
+		int32 Seed;
+		float Scale;
+		int32 Octaves;
+		float Persistence;
+		float Lacunarity;
+	};
+
+	SIZE_T GetTexelBytes(int32 Resolution)
+	{
+		return (SIZE_T)FPlanetHeightField::NumFaces * Resolution * Resolution * sizeof(FFloat16);
+	}
+}
+
+FPlanetHeightField::~FPlanetHeightField()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+float FPlanetHeightField::Sample(const FVector& Direction) const
+{
+	const FVector Abs = Direction.GetAbs();
+
+	// The face whose normal is closest to the direction
+	int32 Face = Abs.X >= Abs.Y && Abs.X >= Abs.Z ? (Direction.X >= 0.0 ? 0 : 1)
+		: Abs.Y >= Abs.Z ? (Direction.Y >= 0.0 ? 2 : 3)
+		: (Direction.Z >= 0.0 ? 4 : 5);
+
+	const FVector(&Axes)[3] = HeightFaceAxes[Face];
+	const double Major = FMath::Max(FVector::DotProduct(Direction, Axes[0]), UE_SMALL_NUMBER);
+
+	const double Last = Resolution - 1;
+	const double TexelX = FMath::Clamp((FVector::DotProduct(Direction, Axes[1]) / Major + 1.0) * 0.5 * Last, 0.0, Last);
+	const double TexelY = FMath::Clamp((FVector::DotProduct(Direction, Axes[2]) / Major + 1.0) * 0.5 * Last, 0.0, Last);
+
+	const int32 X0 = FMath::Min((int32)TexelX, Resolution - 2);
+	const int32 Y0 = FMath::Min((int32)TexelY, Resolution - 2);
+	const float AlphaX = (float)(TexelX - X0);
+	const float AlphaY = (float)(TexelY - Y0);
+
+	return FMath::Lerp(
+		FMath::Lerp(GetTexel(Face, X0, Y0), GetTexel(Face, X0 + 1, Y0), AlphaX),
+		FMath::Lerp(GetTexel(Face, X0, Y0 + 1), GetTexel(Face, X0 + 1, Y0 + 1), AlphaX),
+		AlphaY);
+}
+
+FVector3f FPlanetHeightField::SampleGradient(const FVector& Direction) const
+{
+	// One texel at the face center, in radians
+	const double Step = 2.0 / (Resolution - 1);
+
+	FVector TangentA;
+	FVector TangentB;
+	Direction.FindBestAxisVectors(TangentA, TangentB);
+
+	const double SlopeA = (Sample((Direction + TangentA * Step).GetUnsafeNormal()) - Sample((Direction - TangentA * Step).GetUnsafeNormal())) / (2.0 * Step);
+	const double SlopeB = (Sample((Direction + TangentB * Step).GetUnsafeNormal()) - Sample((Direction - TangentB * Step).GetUnsafeNormal())) / (2.0 * Step);
+
+	return FVector3f(TangentA * SlopeA + TangentB * SlopeB);
+}
+
+FPlanetHeightCache& FPlanetHeightCache::Get()
+{
+	static FPlanetHeightCache Instance;
+	return Instance;
+}
+
+uint64 FPlanetHeightCache::ComputeKey(const FPlanetMeshSettings& Settings)
+{
+	FHeightFieldKeyData Data;
+	Data.Version = FileVersion;
+	Data.Resolution = Settings.HeightCacheResolution;
+	Data.Seed = Settings.NoiseSeed;
+	Data.Scale = Settings.NoiseScale;
+	Data.Octaves = Settings.NoiseOctaves;
+	Data.Persistence = Settings.NoisePersistence;
+	Data.Lacunarity = Settings.NoiseLacunarity;
+
+	return CityHash64((const char*)&Data, sizeof(Data));
+}
+
+FString FPlanetHeightCache::GetCachePath(uint64 Key)
+{
+	return FPaths::ProjectSavedDir() / TEXT("PlanetCache") / FString::Printf(TEXT("Heights_%016llx.bin"), Key);
+}
+
+TSharedRef<const FPlanetHeightField, ESPMode::ThreadSafe> FPlanetHeightCache::FindOrBake(const FPlanetMeshSettings& Settings)
+{
+	check(Settings.HeightCacheResolution > 1);
+
+	const uint64 Key = ComputeKey(Settings);
+
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe>* Field = Fields.Find(Key)) {
+			return Field->ToSharedRef();
+		}
+	}
+
+	TPromise<FFieldPtr> Promise;
+	TSharedFuture<FFieldPtr> Pending;
+
+	{
+		FWriteScopeLock WriteLock(Lock);
+
+		// Another thread may have loaded it while this one waited for the write lock
+		if (const FFieldPtr* Field = Fields.Find(Key)) {
+			return Field->ToSharedRef();
+		}
+
+		if (const TSharedFuture<FFieldPtr>* Future = InFlight.Find(Key)) {
+			Pending = *Future;
+		} else {
+			InFlight.Add(Key, Promise.GetFuture().Share());
+		}
+	}
+
+	if (Pending.IsValid()) {
+		return Pending.Get().ToSharedRef();
+	}
+
+	const FString Path = GetCachePath(Key);
+	FFieldPtr Field = Load(Path, Key, Settings.HeightCacheResolution);
+
+	if (Field.IsValid()) {
+		// Marks the file as recently used for TrimDiskCache
+		IFileManager::Get().SetTimeStamp(*Path, FDateTime::UtcNow());
+	} else {
+		TSharedRef<FPlanetHeightField, ESPMode::ThreadSafe> Baked = Bake(Settings);
+
+		// A failed write only costs the next run another bake
+		if (Save(Path, Key, *Baked)) {
+			TrimDiskCache(Path);
+		} else {
+			UE_LOG(LogTemp, Warning, TEXT("Could not write planet height cache %s"), *Path);
+		}
+
+		Field = Baked;
+	}
+
+	{
+		FWriteScopeLock WriteLock(Lock);
+		Fields.Add(Key, Field);
+		InFlight.Remove(Key);
+	}
+
+	Promise.SetValue(Field);
+	return Field.ToSharedRef();
+}
+
+void FPlanetHeightCache::TrimDiskCache(const FString& KeepPath)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	const FString Directory = FPaths::GetPath(KeepPath);
+
+	TArray<FString> FileNames;
+	FileManager.FindFiles(FileNames, *(Directory / TEXT("Heights_*.bin")), true, false);
+
+	struct FCacheFile
+	{
+		FString Path;
+		int64 Size = 0;
+		FDateTime LastUsed;
+	};
+
+	TArray<FCacheFile> Files;
+	int64 TotalBytes = 0;
+
+	for (const FString& FileName : FileNames) {
+		FCacheFile& File = Files.AddDefaulted_GetRef();
+		File.Path = Directory / FileName;
+		File.Size = FMath::Max(FileManager.FileSize(*File.Path), (int64)0);
+		File.LastUsed = FileManager.GetTimeStamp(*File.Path);
+		TotalBytes += File.Size;
+	}
+
+	Files.Sort([](const FCacheFile& A, const FCacheFile& B) { return A.LastUsed < B.LastUsed; });
+
+	for (const FCacheFile& File : Files) {
+		if (TotalBytes <= MaxDiskBytes) {
+			break;
+		}
+
+		// A file still mapped by a loaded field may refuse to go, it is tried again after the next bake
+		if (File.Path != KeepPath && FileManager.Delete(*File.Path, false, false, true)) {
+			TotalBytes -= File.Size;
+		}
+	}
+}
+
+void FPlanetHeightCache::ReleaseUnused()
+{
+	FWriteScopeLock WriteLock(Lock);
+
+	for (auto It = Fields.CreateIterator(); It; ++It) {
+		if (It->Value.IsUnique()) {
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TSharedPtr<FPlanetHeightField, ESPMode::ThreadSafe> FPlanetHeightCache::Load(const FString& Path, uint64 Key, int32 Resolution)
+{
+	const int64 ExpectedSize = sizeof(FHeightFileHeader) + GetTexelBytes(Resolution);
+
+	if (IFileManager::Get().FileSize(*Path) != ExpectedSize) {
+		return nullptr;
+	}
+
+	auto IsValidHeader = [Key, Resolution](const uint8* Data) {
+		FHeightFileHeader Header;
+		FMemory::Memcpy(&Header, Data, sizeof(Header));
+		return Header.Magic == HeightFileMagic && Header.Version == FileVersion && Header.Key == Key && Header.Resolution == Resolution;
+	};
+
+	TSharedRef<FPlanetHeightField, ESPMode::ThreadSafe> Field = MakeShared<FPlanetHeightField, ESPMode::ThreadSafe>();
+	Field->Resolution = Resolution;
+
+	Field->MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (Field->MappedFile.IsValid()) {
+		Field->MappedRegion.Reset(Field->MappedFile->MapRegion(0, ExpectedSize));
+	}
+
+	if (Field->MappedRegion.IsValid()) {
+		const uint8* Data = Field->MappedRegion->GetMappedPtr();
+		if (!IsValidHeader(Data)) {
+			return nullptr;
+		}
+
+		Field->Texels = (const FFloat16*)(Data + sizeof(FHeightFileHeader));
+		return Field;
+	}
+
+	// Platforms without mapped files read the whole field instead
+	Field->MappedRegion.Reset();
+	Field->MappedFile.Reset();
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path) || Bytes.Num() != ExpectedSize || !IsValidHeader(Bytes.GetData())) {
+		return nullptr;
+	}
+
+	Field->OwnedTexels.SetNumUninitialized(FPlanetHeightField::NumFaces * Resolution * Resolution);
+	FMemory::Memcpy(Field->OwnedTexels.GetData(), Bytes.GetData() + sizeof(FHeightFileHeader), GetTexelBytes(Resolution));
+	Field->Texels = Field->OwnedTexels.GetData();
+	return Field;
+}
+
+TSharedRef<FPlanetHeightField, ESPMode::ThreadSafe> FPlanetHeightCache::Bake(const FPlanetMeshSettings& Settings)
+{
+	SOLARSYSTEM_SCOPE(HeightBake);
+
+	const int32 Resolution = Settings.HeightCacheResolution;
+	const FPerlinNoise Noise(Settings.NoiseSeed);
+
+	TSharedRef<FPlanetHeightField, ESPMode::ThreadSafe> Field = MakeShared<FPlanetHeightField, ESPMode::ThreadSafe>();
+	Field->Resolution = Resolution;
+	Field->OwnedTexels.SetNumUninitialized(FPlanetHeightField::NumFaces * Resolution * Resolution);
+
+	// One texel row per job, the edge rows of neighboring faces see the same directions
+	ParallelFor(FPlanetHeightField::NumFaces * Resolution, [&](int32 Row) {
+		const int32 Face = Row / Resolution;
+		const int32 Y = Row % Resolution;
+		const FVector(&Axes)[3] = HeightFaceAxes[Face];
+		const double V = Y * 2.0 / (Resolution - 1) - 1.0;
+
+		TArray<FVector> Directions;
+		TArray<float> Values;
+		Directions.SetNumUninitialized(Resolution);
+		Values.SetNumUninitialized(Resolution);
+
+		for (int32 X = 0; X < Resolution; ++X) {
+			const double U = X * 2.0 / (Resolution - 1) - 1.0;
+			Directions[X] = (Axes[0] + Axes[1] * U + Axes[2] * V).GetUnsafeNormal();
+		}
+
+		Noise.FractalNoise3DBatch(Directions, Values, Settings.NoiseScale, Settings.NoiseOctaves, Settings.NoisePersistence, Settings.NoiseLacunarity);
+
+		FFloat16* Texels = Field->OwnedTexels.GetData() + Row * Resolution;
+		for (int32 X = 0; X < Resolution; ++X) {
+			Texels[X] = FFloat16(Values[X]);
+		}
+	});
+
+	Field->Texels = Field->OwnedTexels.GetData();
+	return Field;
+}
+
+bool FPlanetHeightCache::Save(const FString& Path, uint64 Key, const FPlanetHeightField& Field)
+{
+	FHeightFileHeader Header;
+	Header.Key = Key;
+	Header.Resolution = Field.Resolution;
+
+	// Written next to the target and moved over it, a crash never leaves a half written cache behind
+	const FString TempPath = Path + TEXT(".tmp");
+
+	{
+		TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+		if (!Writer.IsValid()) {
+			return false;
+		}
+
+		Writer->Serialize(&Header, sizeof(Header));
+		Writer->Serialize((void*)Field.Texels, GetTexelBytes(Field.Resolution));
+
+		if (!Writer->Close()) {
+			return false;
+		}
+	}
+
+	return IFileManager::Get().Move(*Path, *TempPath, true, true);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16.h"
+#include "Async/Future.h"
+#include "PlanetMeshBuilder.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Fractal noise baked onto the six faces of a cube as float16 texels.
+// Holds the raw noise value, so radius and height multiplier can change without a rebake.
+class SOLARSYSTEM2_API FPlanetHeightField
+{
+public:
+	static constexpr int32 NumFaces = 6;
+
+	~FPlanetHeightField();
+
+	int32 GetResolution() const { return Resolution; }
+
+	// Bilinear noise value along a unit direction
+	float Sample(const FVector& Direction) const;
+
+	// Tangential gradient of the noise by central differences one texel apart
+	FVector3f SampleGradient(const FVector& Direction) const;
+
+	// Heap memory only, a mapped field lives in the page cache
+	SIZE_T GetAllocatedSize() const { return OwnedTexels.GetAllocatedSize(); }
+
+private:
+	friend class FPlanetHeightCache;
+
+	int32 Resolution = 0;
+
+	// Points either into OwnedTexels or into the mapped file
+	const FFloat16* Texels = nullptr;
+	TArray<FFloat16> OwnedTexels;
+
+	// The region is unmapped before the handle closes
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	float GetTexel(int32 Face, int32 X, int32 Y) const { return Texels[(Face * Resolution + Y) * Resolution + X].GetFloat(); }
+};
+
+// Baked height fields per noise parameter set, shared by every planet and kept on disk under Saved/PlanetCache.
+// A later run maps the file instead of evaluating the noise again.
+// The directory is trimmed to MaxDiskBytes after every bake, least recently used files first.
+class SOLARSYSTEM2_API FPlanetHeightCache
+{
+public:
+	// Bumped whenever the noise or the face layout changes, older files are then rebaked
+	static constexpr uint32 FileVersion = 1;
+
+	// Every slider step of a noise setting bakes another file, this keeps them from piling up
+	static constexpr int64 MaxDiskBytes = 512ll * 1024 * 1024;
+
+	static FPlanetHeightCache& Get();
+
+	// Settings.HeightCacheResolution must be positive.
+	// Loading and baking happen outside the lock, a second request for a key being baked waits for that bake.
+	TSharedRef<const FPlanetHeightField, ESPMode::ThreadSafe> FindOrBake(const FPlanetMeshSettings& Settings);
+
+	// Drops the fields no planet references anymore
+	void ReleaseUnused();
+
+	// Hash of the noise parameters, the resolution and the file version
+	static uint64 ComputeKey(const FPlanetMeshSettings& Settings);
+
+	static FString GetCachePath(uint64 Key);
+
+private:
+	using FFieldPtr = TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe>;
+
+	FRWLock Lock;
+	TMap<uint64, FFieldPtr> Fields;
+
+	// Keys some thread is loading or baking right now
+	TMap<uint64, TSharedFuture<FFieldPtr>> InFlight;
+
+	// Deletes the least recently used files until the directory fits MaxDiskBytes, never KeepPath
+	static void TrimDiskCache(const FString& KeepPath);
+
+	static TSharedPtr<FPlanetHeightField, ESPMode::ThreadSafe> Load(const FString& Path, uint64 Key, int32 Resolution);
+	static TSharedRef<FPlanetHeightField, ESPMode::ThreadSafe> Bake(const FPlanetMeshSettings& Settings);
+	static bool Save(const FString& Path, uint64 Key, const FPlanetHeightField& Field);
+};
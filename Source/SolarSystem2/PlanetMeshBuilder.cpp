@@ -0,0 +1,172 @@
+#include "PlanetMeshBuilder.h"
+#include "SolarSystemStats.h"
+#include "PlanetHeightField.h"
+
+void FPlanetMeshData::Reset()
+{
+	Topology.Reset();
+	HeightField.Reset();
+	Vertices.Reset();
+	Normals.Reset();
+	VertexColors.Reset();
+	Tangents.Reset();
+}
+
+FPlanetMeshBuilder::FPlanetMeshBuilder(const FPlanetMeshSettings& InSettings, FPlanetMeshData& InMesh, const FPlanetTopology& InTopology)
+	: Settings(InSettings)
+	, Mesh(InMesh)
+	, Topology(InTopology)
+	, NoiseGenerator(InSettings.NoiseSeed)
+{
+}
+
+void FPlanetMeshBuilder::Build(const FPlanetMeshSettings& Settings, FPlanetMeshData& OutMesh)
+{
+	SOLARSYSTEM_SCOPE(GeneratePlanet);
+
+	OutMesh.Reset();
+	OutMesh.Topology = FPlanetTopologyCache::Get().FindOrBuild(Settings.Subdivisions);
+	OutMesh.HeightField = FindHeightField(Settings);
+
+	FPlanetMeshBuilder Builder(Settings, OutMesh, *OutMesh.Topology);
+
+	OutMesh.Vertices.SetNumUninitialized(OutMesh.Topology->UnitPositions.Num());
+	OutMesh.Normals.SetNumUninitialized(OutMesh.Topology->UnitPositions.Num());
+
+	if (Settings.ApplyNoise) {
+		SOLARSYSTEM_SCOPE(Noise);
+		Builder.ApplyNoiseToVertices();
+	} else {
+		Builder.ScaleVertices();
+	}
+
+	// Smooth normals come out of the displacement pass, only faceted shading walks the triangles
+	if (!Settings.SmoothShading) {
+		SOLARSYSTEM_SCOPE(Normals);
+		Builder.CalculateFaceNormals();
+	}
+}
+
+void FPlanetMeshBuilder::ScaleVertices()
+{
+	for (int32 i = 0; i < Mesh.Vertices.Num(); i++) {
+		Mesh.Vertices[i] = Topology.UnitPositions[i] * Settings.Radius;
+	}
+
+	FMemory::Memcpy(Mesh.Normals.GetData(), Topology.UnitPositions.GetData(), Mesh.Normals.Num() * sizeof(FVector));
+}
+
+void FPlanetMeshBuilder::ApplyNoiseToVertices()
+{
+	TArray<float> Radii;
+	Radii.SetNumUninitialized(Mesh.Vertices.Num());
+	SampleRadii(Settings, NoiseGenerator, Topology.UnitPositions, Radii, Settings.SmoothShading ? TArrayView<FVector>(Mesh.Normals) : TArrayView<FVector>());
+
+	for (int32 i = 0; i < Mesh.Vertices.Num(); i++) {
+		Mesh.Vertices[i] = Topology.UnitPositions[i] * Radii[i];
+	}
+}
+
+float FPlanetMeshBuilder::SampleRadius(const FPlanetMeshSettings& Settings, const FPerlinNoise& Noise, const FVector& UnitPosition)
+{
+	float Radius = Settings.Radius;
+	SampleRadii(Settings, Noise, MakeArrayView(&UnitPosition, 1), MakeArrayView(&Radius, 1));
+	return Radius;
+}
+
+TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe> FPlanetMeshBuilder::FindHeightField(const FPlanetMeshSettings& Settings)
+{
+	if (!Settings.ApplyNoise || Settings.HeightCacheResolution <= 1) {
+		return nullptr;
+	}
+
+	return FPlanetHeightCache::Get().FindOrBake(Settings);
+}
+
+void FPlanetMeshBuilder::SampleRadii(const FPlanetMeshSettings& Settings, const FPerlinNoise& Noise, TConstArrayView<FVector> UnitPositions, TArrayView<float> OutRadii, TArrayView<FVector> OutNormals)
+{
+	const bool WithNormals = OutNormals.Num() > 0;
+
+	if (!Settings.ApplyNoise) {
+		for (int32 i = 0; i < UnitPositions.Num(); i++) {
+			OutRadii[i] = Settings.Radius;
+		}
+		for (int32 i = 0; WithNormals && i < UnitPositions.Num(); i++) {
+			OutNormals[i] = UnitPositions[i];
+		}
+		return;
+	}
+
+	TArray<FVector3f> Gradients;
+	if (WithNormals) {
+		Gradients.SetNumUninitialized(UnitPositions.Num());
+	}
+
+	if (Settings.HeightCacheResolution > 1) {
+		const TSharedRef<const FPlanetHeightField, ESPMode::ThreadSafe> HeightField = FPlanetHeightCache::Get().FindOrBake(Settings);
+
+		for (int32 i = 0; i < UnitPositions.Num(); i++) {
+			OutRadii[i] = HeightField->Sample(UnitPositions[i]);
+		}
+		for (int32 i = 0; i < Gradients.Num(); i++) {
+			Gradients[i] = HeightField->SampleGradient(UnitPositions[i]);
+		}
+	} else {
+		Noise.FractalNoise3DBatch(UnitPositions, OutRadii, Gradients, Settings.NoiseScale, Settings.NoiseOctaves, Settings.NoisePersistence, Settings.NoiseLacunarity);
+	}
+
+	// Radius = Base + Slope * Noise, so its gradient is Slope times the noise gradient
+	const float Slope = Settings.Radius * Settings.NoiseHeightMultiplier * 0.5f;
+
+	for (int32 i = 0; i < UnitPositions.Num(); i++) {
+		const float HeightOffset = (OutRadii[i] + 1.0f) * 0.5f;
+		OutRadii[i] = Settings.Radius * (1.0f + HeightOffset * Settings.NoiseHeightMultiplier);
+
+		if (WithNormals) {
+			// For the surface Direction * Radius(Direction) the normal leans against the tangential part of the radius gradient
+			const FVector& Direction = UnitPositions[i];
+			const FVector RadiusGradient = FVector(Gradients[i]) * Slope;
+			const FVector Tangential = RadiusGradient - Direction * FVector::DotProduct(RadiusGradient, Direction);
+
+			OutNormals[i] = (Direction - Tangential / OutRadii[i]).GetSafeNormal(UE_SMALL_NUMBER, Direction);
+		}
+	}
+}
+
+void FPlanetMeshBuilder::CalculateFaceNormals()
+{
+	TArray<int32> NormalCount;
+	NormalCount.SetNumZeroed(Mesh.Vertices.Num());
+
+	for (int32 i = 0; i < Mesh.Normals.Num(); i++) {
+		Mesh.Normals[i] = FVector::ZeroVector;
+	}
+
+	for (int32 i = 0; i < Topology.Triangles.Num(); i += 3) {
+		int32 VertexIndexA = Topology.Triangles[i];
+		int32 VertexIndexB = Topology.Triangles[i + 1];
+		int32 VertexIndexC = Topology.Triangles[i + 2];
+
+		FVector VertexA = Mesh.Vertices[VertexIndexA];
+		FVector VertexB = Mesh.Vertices[VertexIndexB];
+		FVector VertexC = Mesh.Vertices[VertexIndexC];
+
+		FVector Edge1 = VertexB - VertexA;
+		FVector Edge2 = VertexC - VertexA;
+		FVector FaceNormal = FVector::CrossProduct(Edge1, Edge2).GetSafeNormal();
+
+		Mesh.Normals[VertexIndexA] += FaceNormal;
+		Mesh.Normals[VertexIndexB] += FaceNormal;
+		Mesh.Normals[VertexIndexC] += FaceNormal;
+
+		NormalCount[VertexIndexA]++;
+		NormalCount[VertexIndexB]++;
+		NormalCount[VertexIndexC]++;
+	}
+
+	for (int32 i = 0; i < Mesh.Normals.Num(); i++) {
+		if (NormalCount[i] > 0) {
+			Mesh.Normals[i] = (Mesh.Normals[i] / NormalCount[i]).GetSafeNormal();
+		}
+	}
+}
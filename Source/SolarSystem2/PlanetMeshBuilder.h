@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "PerlinNoise.h"
+#include "PlanetTopology.h"
+
+class FPlanetHeightField;
+
+// Everything that shapes a planet mesh, copied out of the component so a build can run on any thread
+struct FPlanetMeshSettings
+{
+	float Radius = 100.0f;
+	int32 Subdivisions = 2;
+	bool SmoothShading = true;
+
+	bool ApplyNoise = true;
+	float NoiseScale = 10.0f;
+	float NoiseHeightMultiplier = 0.1f;
+	int32 NoiseOctaves = 4;
+	float NoisePersistence = 0.5f;
+	float NoiseLacunarity = 2.0f;
+	int32 NoiseSeed = 91;
+
+	// Texels per cube face edge of the baked height field, 0 samples the noise directly
+	int32 HeightCacheResolution = 0;
+
+	bool operator==(const FPlanetMeshSettings& Other) const
+	{
+		return Radius == Other.Radius && Subdivisions == Other.Subdivisions && SmoothShading == Other.SmoothShading
+			&& ApplyNoise == Other.ApplyNoise && NoiseScale == Other.NoiseScale && NoiseHeightMultiplier == Other.NoiseHeightMultiplier
+			&& NoiseOctaves == Other.NoiseOctaves && NoisePersistence == Other.NoisePersistence && NoiseLacunarity == Other.NoiseLacunarity
+			&& NoiseSeed == Other.NoiseSeed && HeightCacheResolution == Other.HeightCacheResolution;
+	}
+
+	bool operator!=(const FPlanetMeshSettings& Other) const { return !(*this == Other); }
+};
+
+// Buffers in the layout CreateMeshSection_LinearColor expects.
+// Triangles and UVs come from the shared topology, only positions and normals belong to this planet.
+struct FPlanetMeshData
+{
+	TSharedPtr<const FPlanetTopology, ESPMode::ThreadSafe> Topology;
+
+	// Baked field the heights came from, held so the cache keeps it while the mesh is in use
+	TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe> HeightField;
+
+	TArray<FVector> Vertices;
+	TArray<FVector> Normals;
+	TArray<FLinearColor> VertexColors;
+	TArray<FProcMeshTangent> Tangents;
+
+	void Reset();
+};
+
+// Displaces the cached unit icosphere into a planet. Touches no UObject, so it can run on worker threads.
+class SOLARSYSTEM2_API FPlanetMeshBuilder
+{
+public:
+	static void Build(const FPlanetMeshSettings& Settings, FPlanetMeshData& OutMesh);
+
+	// Surface radius along a unit direction, the single height function behind every planet mesh.
+	// Goes through SampleRadii, so it reads the baked field whenever the meshes do.
+	static float SampleRadius(const FPlanetMeshSettings& Settings, const FPerlinNoise& Noise, const FVector& UnitPosition);
+
+	// SampleRadius for a whole array of directions through the batched noise.
+	// When OutNormals is not empty it also gets the displaced surface normals, straight from the noise gradient.
+	static void SampleRadii(const FPlanetMeshSettings& Settings, const FPerlinNoise& Noise, TConstArrayView<FVector> UnitPositions, TArrayView<float> OutRadii, TArrayView<FVector> OutNormals = TArrayView<FVector>());
+
+	// The baked field the settings read from, null when they sample the noise directly
+	static TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe> FindHeightField(const FPlanetMeshSettings& Settings);
+
+private:
+	FPlanetMeshBuilder(const FPlanetMeshSettings& InSettings, FPlanetMeshData& InMesh, const FPlanetTopology& InTopology);
+
+	const FPlanetMeshSettings& Settings;
+	FPlanetMeshData& Mesh;
+	const FPlanetTopology& Topology;
+	FPerlinNoise NoiseGenerator;
+
+	void ScaleVertices();
+	void ApplyNoiseToVertices();
+	void CalculateFaceNormals();
+};
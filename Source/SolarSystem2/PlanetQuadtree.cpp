@@ -0,0 +1,156 @@
+#include "PlanetQuadtree.h"
+#include "SolarSystemStats.h"
+
+namespace
+{
+	// Face normal and the two in-face axes, chosen so that U x V = Normal and triangles wind like the icosphere
+	const FVector FaceAxes[FPlanetChunkKey::NumFaces][3] = {
+		{ FVector(1, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1) },
+		{ FVector(-1, 0, 0), FVector(0, 0, 1), FVector(0, 1, 0) },
+		{ FVector(0, 1, 0), FVector(0, 0, 1), FVector(1, 0, 0) },
+		{ FVector(0, -1, 0), FVector(1, 0, 0), FVector(0, 0, 1) },
+		{ FVector(0, 0, 1), FVector(1, 0, 0), FVector(0, 1, 0) },
+		{ FVector(0, 0, -1), FVector(0, 1, 0), FVector(1, 0, 0) },
+	};
+
+	// Spreads the cube grid more evenly over the sphere than a plain normalize
+	FVector CubeToSphere(const FVector& Point)
+	{
+		const double X2 = Point.X * Point.X;
+		const double Y2 = Point.Y * Point.Y;
+		const double Z2 = Point.Z * Point.Z;
+
+		return FVector(
+			Point.X * FMath::Sqrt(1.0 - Y2 * 0.5 - Z2 * 0.5 + Y2 * Z2 / 3.0),
+			Point.Y * FMath::Sqrt(1.0 - Z2 * 0.5 - X2 * 0.5 + Z2 * X2 / 3.0),
+			Point.Z * FMath::Sqrt(1.0 - X2 * 0.5 - Y2 * 0.5 + X2 * Y2 / 3.0)).GetSafeNormal();
+	}
+}
+
+FPlanetChunkKey FPlanetChunkKey::GetChild(int32 ChildIndex) const
+{
+	FPlanetChunkKey Child;
+	Child.Face = Face;
+	Child.Depth = Depth + 1;
+	Child.X = X * 2 + (ChildIndex & 1);
+	Child.Y = Y * 2 + (ChildIndex >> 1);
+	return Child;
+}
+
+FVector FPlanetChunkKey::GetUnitPosition(double U, double V) const
+{
+	const double CellSize = 1.0 / (double)(1 << Depth);
+	const double FaceU = (X + U) * CellSize * 2.0 - 1.0;
+	const double FaceV = (Y + V) * CellSize * 2.0 - 1.0;
+	const FVector(&Axes)[3] = FaceAxes[Face];
+
+	return CubeToSphere(Axes[0] + Axes[1] * FaceU + Axes[2] * FaceV);
+}
+
+SIZE_T FPlanetChunkMesh::GetAllocatedSize() const
+{
+	return Vertices.GetAllocatedSize() + Triangles.GetAllocatedSize() + Normals.GetAllocatedSize() + UVs.GetAllocatedSize()
+		+ VertexColors.GetAllocatedSize() + Tangents.GetAllocatedSize();
+}
+
+void FPlanetChunkBuilder::Build(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, int32 Resolution, FPlanetChunkMesh& OutMesh)
+{
+	SOLARSYSTEM_SCOPE(ChunkBuild);
+
+	const int32 Row = Resolution + 1;
+	const int32 NumGridVertices = Row * Row;
+	const int32 NumSkirtVertices = Row * 4;
+	const double SkirtDepth = GetVertexSpacing(Settings, Key, Resolution) * 2.0;
+
+	const FPerlinNoise Noise(Settings.NoiseSeed);
+	OutMesh.HeightField = FPlanetMeshBuilder::FindHeightField(Settings);
+
+	OutMesh.Vertices.SetNumUninitialized(NumGridVertices + NumSkirtVertices);
+	OutMesh.Normals.SetNumUninitialized(NumGridVertices + NumSkirtVertices);
+	OutMesh.UVs.SetNumUninitialized(NumGridVertices + NumSkirtVertices);
+	OutMesh.Triangles.Reset(Resolution * Resolution * 6 + Resolution * 4 * 12);
+
+	TArray<FVector> Directions;
+	Directions.SetNumUninitialized(NumGridVertices);
+
+	for (int32 Y = 0; Y < Row; ++Y) {
+		for (int32 X = 0; X < Row; ++X) {
+			const int32 Index = Y * Row + X;
+			Directions[Index] = Key.GetUnitPosition((double)X / Resolution, (double)Y / Resolution);
+			OutMesh.UVs[Index] = FPlanetTopology::ComputeUV(Directions[Index]);
+		}
+	}
+
+	// Heights and normals for the whole grid in one batched pass
+	TArray<float> Radii;
+	Radii.SetNumUninitialized(NumGridVertices);
+	FPlanetMeshBuilder::SampleRadii(Settings, Noise, Directions, Radii, MakeArrayView(OutMesh.Normals.GetData(), NumGridVertices));
+
+	for (int32 Index = 0; Index < NumGridVertices; ++Index) {
+		OutMesh.Vertices[Index] = Directions[Index] * Radii[Index];
+	}
+
+	for (int32 Y = 0; Y < Resolution; ++Y) {
+		for (int32 X = 0; X < Resolution; ++X) {
+			const int32 I00 = Y * Row + X;
+			const int32 I10 = I00 + 1;
+			const int32 I01 = I00 + Row;
+			const int32 I11 = I01 + 1;
+
+			OutMesh.Triangles.Append({ I00, I10, I01 });
+			OutMesh.Triangles.Append({ I10, I11, I01 });
+		}
+	}
+
+	// Walk the border once, each edge vertex gets a copy pulled down towards the center
+	int32 Skirt = NumGridVertices;
+
+	auto AddSkirtEdge = [&](int32 Start, int32 Stride) {
+		const int32 First = Skirt;
+
+		for (int32 k = 0; k < Row; ++k) {
+			const int32 Edge = Start + k * Stride;
+			OutMesh.Vertices[Skirt] = OutMesh.Vertices[Edge] - Directions[Edge] * SkirtDepth;
+			OutMesh.Normals[Skirt] = OutMesh.Normals[Edge];
+			OutMesh.UVs[Skirt] = OutMesh.UVs[Edge];
+			Skirt++;
+		}
+
+		// Both windings, the skirt is seen from whichever side the crack opens on
+		for (int32 k = 0; k < Resolution; ++k) {
+			const int32 A = Start + k * Stride;
+			const int32 B = Start + (k + 1) * Stride;
+			const int32 C = First + k;
+			const int32 D = First + k + 1;
+
+			OutMesh.Triangles.Append({ A, C, B, B, C, D });
+			OutMesh.Triangles.Append({ A, B, C, B, D, C });
+		}
+	};
+
+	AddSkirtEdge(0, 1);
+	AddSkirtEdge(Resolution * Row, 1);
+	AddSkirtEdge(0, Row);
+	AddSkirtEdge(Resolution, Row);
+}
+
+void FPlanetChunkBuilder::GetBounds(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, FVector& OutCenter, double& OutRadius)
+{
+	const double MaxRadius = Settings.Radius * (1.0 + (Settings.ApplyNoise ? FMath::Max(Settings.NoiseHeightMultiplier, 0.0f) : 0.0));
+	const FVector Center = Key.GetUnitPosition(0.5, 0.5);
+
+	double CornerDistance = 0.0;
+	for (int32 Corner = 0; Corner < 4; ++Corner) {
+		const FVector Unit = Key.GetUnitPosition(Corner & 1, Corner >> 1);
+		CornerDistance = FMath::Max(CornerDistance, FVector::Dist(Unit, Center));
+	}
+
+	OutCenter = Center * Settings.Radius;
+	OutRadius = CornerDistance * MaxRadius + (MaxRadius - Settings.Radius);
+}
+
+double FPlanetChunkBuilder::GetVertexSpacing(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, int32 Resolution)
+{
+	const double EdgeLength = FVector::Dist(Key.GetUnitPosition(0.0, 0.0), Key.GetUnitPosition(1.0, 0.0));
+	return EdgeLength * Settings.Radius / FMath::Max(Resolution, 1);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlanetMeshBuilder.h"
+
+// One node of the cube-sphere quadtree: a face of the cube, a depth and a cell on that face's 2^Depth grid
+struct SOLARSYSTEM2_API FPlanetChunkKey
+{
+	uint8 Face = 0;
+	uint8 Depth = 0;
+	int32 X = 0;
+	int32 Y = 0;
+
+	static constexpr int32 NumFaces = 6;
+
+	// Deep enough to reach centimeters on an Earth sized planet
+	static constexpr int32 MaxDepth = 24;
+
+	uint64 Pack() const { return ((uint64)Face << 56) | ((uint64)Depth << 48) | ((uint64)X << 24) | (uint64)Y; }
+
+	FPlanetChunkKey GetChild(int32 ChildIndex) const;
+
+	// Corner on the unit sphere for face coordinates in [0, 1] across this chunk
+	FVector GetUnitPosition(double U, double V) const;
+};
+
+// Grid of (Resolution + 1)^2 vertices plus a skirt hanging below every edge.
+// The skirts hide the T-junction cracks where neighbors sit at different depths.
+struct FPlanetChunkMesh
+{
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UVs;
+	TArray<FLinearColor> VertexColors;
+	TArray<FProcMeshTangent> Tangents;
+
+	// Baked field the heights came from, see FPlanetMeshData
+	TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe> HeightField;
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+class SOLARSYSTEM2_API FPlanetChunkBuilder
+{
+public:
+	static void Build(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, int32 Resolution, FPlanetChunkMesh& OutMesh);
+
+	// Sphere around the chunk including the highest terrain noise can raise
+	static void GetBounds(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, FVector& OutCenter, double& OutRadius);
+
+	// Distance between neighboring grid vertices, the chunk's geometric error
+	static double GetVertexSpacing(const FPlanetMeshSettings& Settings, const FPlanetChunkKey& Key, int32 Resolution);
+};
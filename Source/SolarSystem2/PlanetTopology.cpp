@@ -0,0 +1,266 @@
+#include "PlanetTopology.h"
+#include "SolarSystemStats.h"
+
+namespace
+{
+	// Subdivides the icosahedron into a FPlanetTopology, vertices are created in first-encounter order
+	class FPlanetTopologyBuilder
+	{
+	public:
+		explicit FPlanetTopologyBuilder(FPlanetTopology& InTopology)
+			: Topology(InTopology)
+		{
+		}
+
+		void GenerateIcosahedron();
+		void SubdivideMesh(int32 SubdivisionLevel);
+		void NormalizeVertices();
+		void CalculateUVs();
+
+	private:
+		FPlanetTopology& Topology;
+
+		// Every vertex of a subdivided icosahedron has at most six neighbors
+		static constexpr int32 MaxEdgesPerVertex = 6;
+
+		// Midpoint table, row v lists the higher neighbors of v and the midpoint created for each edge
+		TArray<int32> EdgeNeighbors;
+		TArray<int32> EdgeMidpoints;
+
+		// Vertices written so far, UnitPositions is sized for the final level
+		int32 NumVertices = 0;
+
+		int32 GetMiddlePoint(int32 PointA, int32 PointB);
+	};
+
+	void FPlanetTopologyBuilder::GenerateIcosahedron()
+	{
+		const float Phi = (1.0f + FMath::Sqrt(5.0f)) / 2.0f;
+		const float Scale = 1.0f / FMath::Sqrt(Phi * Phi + 1.0f);
+
+		Topology.UnitPositions.Add(FVector(-1, Phi, 0) * Scale);
+		Topology.UnitPositions.Add(FVector(1, Phi, 0) * Scale);
+		Topology.UnitPositions.Add(FVector(-1, -Phi, 0) * Scale);
+		Topology.UnitPositions.Add(FVector(1, -Phi, 0) * Scale);
+
+		Topology.UnitPositions.Add(FVector(0, -1, Phi) * Scale);
+		Topology.UnitPositions.Add(FVector(0, 1, Phi) * Scale);
+		Topology.UnitPositions.Add(FVector(0, -1, -Phi) * Scale);
+		Topology.UnitPositions.Add(FVector(0, 1, -Phi) * Scale);
+
+		Topology.UnitPositions.Add(FVector(Phi, 0, -1) * Scale);
+		Topology.UnitPositions.Add(FVector(Phi, 0, 1) * Scale);
+		Topology.UnitPositions.Add(FVector(-Phi, 0, -1) * Scale);
+		Topology.UnitPositions.Add(FVector(-Phi, 0, 1) * Scale);
+
+		Topology.Triangles.Append({ 0, 11, 5 });
+		Topology.Triangles.Append({ 0, 5, 1 });
+		Topology.Triangles.Append({ 0, 1, 7 });
+		Topology.Triangles.Append({ 0, 7, 10 });
+		Topology.Triangles.Append({ 0, 10, 11 });
+
+		Topology.Triangles.Append({ 1, 5, 9 });
+		Topology.Triangles.Append({ 5, 11, 4 });
+		Topology.Triangles.Append({ 11, 10, 2 });
+		Topology.Triangles.Append({ 10, 7, 6 });
+		Topology.Triangles.Append({ 7, 1, 8 });
+
+		Topology.Triangles.Append({ 3, 9, 4 });
+		Topology.Triangles.Append({ 3, 4, 2 });
+		Topology.Triangles.Append({ 3, 2, 6 });
+		Topology.Triangles.Append({ 3, 6, 8 });
+		Topology.Triangles.Append({ 3, 8, 9 });
+
+		Topology.Triangles.Append({ 4, 9, 5 });
+		Topology.Triangles.Append({ 2, 4, 11 });
+		Topology.Triangles.Append({ 6, 2, 10 });
+		Topology.Triangles.Append({ 8, 6, 7 });
+		Topology.Triangles.Append({ 9, 8, 1 });
+	}
+
+	int32 FPlanetTopologyBuilder::GetMiddlePoint(int32 PointA, int32 PointB)
+	{
+		// Edges are filed under their lower vertex, which owns at most MaxEdgesPerVertex of them
+		const int32 Owner = FMath::Min(PointA, PointB);
+		const int32 Other = FMath::Max(PointA, PointB);
+		int32* Neighbors = EdgeNeighbors.GetData() + Owner * MaxEdgesPerVertex;
+		int32* Midpoints = EdgeMidpoints.GetData() + Owner * MaxEdgesPerVertex;
+
+		int32 Slot = 0;
+		for (; Slot < MaxEdgesPerVertex && Neighbors[Slot] != INDEX_NONE; ++Slot) {
+			if (Neighbors[Slot] == Other) {
+				return Midpoints[Slot];
+			}
+		}
+
+		check(Slot < MaxEdgesPerVertex);
+
+		const int32 Index = NumVertices++;
+		Topology.UnitPositions[Index] = (Topology.UnitPositions[PointA] + Topology.UnitPositions[PointB]) / 2.0f;
+
+		Neighbors[Slot] = Other;
+		Midpoints[Slot] = Index;
+
+		return Index;
+	}
+
+	void FPlanetTopologyBuilder::SubdivideMesh(int32 SubdivisionLevel)
+	{
+		if (SubdivisionLevel <= 0) {
+			return;
+		}
+
+		// Every buffer is sized for the final level up front, nothing grows while subdividing
+		const int32 FinalTriangleIndices = FPlanetTopology::NumTrianglesAtLevel(SubdivisionLevel) * 3;
+		const int32 LargestEdgeTable = FPlanetTopology::NumVerticesAtLevel(SubdivisionLevel - 1) * MaxEdgesPerVertex;
+
+		NumVertices = Topology.UnitPositions.Num();
+		Topology.UnitPositions.SetNumUninitialized(FPlanetTopology::NumVerticesAtLevel(SubdivisionLevel));
+
+		TArray<int32> NewTriangles;
+		NewTriangles.Reserve(FinalTriangleIndices);
+		Topology.Triangles.Reserve(FinalTriangleIndices);
+
+		EdgeNeighbors.SetNumUninitialized(LargestEdgeTable);
+		EdgeMidpoints.SetNumUninitialized(LargestEdgeTable);
+
+		for (int32 level = 0; level < SubdivisionLevel; level++) {
+			FMemory::Memset(EdgeNeighbors.GetData(), 0xFF, NumVertices * MaxEdgesPerVertex * sizeof(int32));
+
+			const int32 NumIndices = Topology.Triangles.Num();
+			NewTriangles.SetNumUninitialized(NumIndices * 4, EAllowShrinking::No);
+
+			const int32* Source = Topology.Triangles.GetData();
+			int32* Out = NewTriangles.GetData();
+
+			for (int32 i = 0; i < NumIndices; i += 3) {
+				const int32 LocalPointA = Source[i];
+				const int32 LocalPointB = Source[i + 1];
+				const int32 LocalPointC = Source[i + 2];
+
+				const int32 MidAB = GetMiddlePoint(LocalPointA, LocalPointB);
+				const int32 MidBC = GetMiddlePoint(LocalPointB, LocalPointC);
+				const int32 MidCA = GetMiddlePoint(LocalPointC, LocalPointA);
+
+				Out[0] = LocalPointA; Out[1] = MidAB; Out[2] = MidCA;
+				Out[3] = LocalPointB; Out[4] = MidBC; Out[5] = MidAB;
+				Out[6] = LocalPointC; Out[7] = MidCA; Out[8] = MidBC;
+				Out[9] = MidAB; Out[10] = MidBC; Out[11] = MidCA;
+				Out += 12;
+			}
+
+			// Swapping keeps both allocations alive for the next level
+			Swap(Topology.Triangles, NewTriangles);
+		}
+
+		check(NumVertices == Topology.UnitPositions.Num());
+	}
+
+	void FPlanetTopologyBuilder::NormalizeVertices()
+	{
+		for (FVector& Position : Topology.UnitPositions) {
+			Position = Position.GetSafeNormal();
+		}
+	}
+
+	void FPlanetTopologyBuilder::CalculateUVs()
+	{
+		Topology.UVs.SetNumUninitialized(Topology.UnitPositions.Num());
+
+		for (int32 i = 0; i < Topology.UnitPositions.Num(); i++) {
+			Topology.UVs[i] = FPlanetTopology::ComputeUV(Topology.UnitPositions[i]);
+		}
+	}
+}
+
+int32 FPlanetTopology::NumVerticesAtLevel(int32 SubdivisionLevel)
+{
+	return 10 * (1 << (2 * SubdivisionLevel)) + 2;
+}
+
+int32 FPlanetTopology::NumTrianglesAtLevel(int32 SubdivisionLevel)
+{
+	return 20 * (1 << (2 * SubdivisionLevel));
+}
+
+FVector2D FPlanetTopology::ComputeUV(const FVector& UnitPosition)
+{
+	float U = 0.5f + (FMath::Atan2(UnitPosition.Y, UnitPosition.X) / (2.0f * PI));
+	float V = 0.5f - (FMath::Asin(UnitPosition.Z) / PI);
+	return FVector2D(U, V);
+}
+
+SIZE_T FPlanetTopology::GetAllocatedSize() const
+{
+	return UnitPositions.GetAllocatedSize() + Triangles.GetAllocatedSize() + UVs.GetAllocatedSize();
+}
+
+TSharedRef<const FPlanetTopology, ESPMode::ThreadSafe> FPlanetTopology::Build(int32 SubdivisionLevel)
+{
+	TSharedRef<FPlanetTopology, ESPMode::ThreadSafe> Topology = MakeShared<FPlanetTopology, ESPMode::ThreadSafe>();
+	Topology->Level = FMath::Clamp(SubdivisionLevel, 0, MaxSubdivisions);
+
+	// Sized for the final level so nothing grows while subdividing
+	Topology->UnitPositions.Reserve(NumVerticesAtLevel(Topology->Level));
+	Topology->Triangles.Reserve(NumTrianglesAtLevel(Topology->Level) * 3);
+
+	FPlanetTopologyBuilder Builder(*Topology);
+
+	{
+		SOLARSYSTEM_SCOPE(Icosahedron);
+		Builder.GenerateIcosahedron();
+	}
+
+	{
+		SOLARSYSTEM_SCOPE(Subdivide);
+		Builder.SubdivideMesh(Topology->Level);
+		Builder.NormalizeVertices();
+	}
+
+	{
+		SOLARSYSTEM_SCOPE(UVs);
+		Builder.CalculateUVs();
+	}
+
+	return Topology;
+}
+
+FPlanetTopologyCache& FPlanetTopologyCache::Get()
+{
+	static FPlanetTopologyCache Instance;
+	return Instance;
+}
+
+TSharedRef<const FPlanetTopology, ESPMode::ThreadSafe> FPlanetTopologyCache::FindOrBuild(int32 SubdivisionLevel)
+{
+	const int32 Level = FMath::Clamp(SubdivisionLevel, 0, FPlanetTopology::MaxSubdivisions);
+
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (Levels[Level].IsValid()) {
+			return Levels[Level].ToSharedRef();
+		}
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+
+	// Another thread may have built it while this one waited for the write lock
+	if (!Levels[Level].IsValid()) {
+		Levels[Level] = FPlanetTopology::Build(Level);
+		INC_MEMORY_STAT_BY(STAT_SolarSystem_TopologyMemory, Levels[Level]->GetAllocatedSize());
+	}
+
+	return Levels[Level].ToSharedRef();
+}
+
+void FPlanetTopologyCache::ReleaseUnused()
+{
+	FWriteScopeLock WriteLock(Lock);
+
+	for (TSharedPtr<const FPlanetTopology, ESPMode::ThreadSafe>& Topology : Levels) {
+		if (Topology.IsValid() && Topology.IsUnique()) {
+			DEC_MEMORY_STAT_BY(STAT_SolarSystem_TopologyMemory, Topology->GetAllocatedSize());
+			Topology.Reset();
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Unit icosphere at one subdivision level. Immutable once built and shared by every planet at that level.
+struct SOLARSYSTEM2_API FPlanetTopology
+{
+	// 10 * 4^10 + 2 vertices, about ten million
+	static constexpr int32 MaxSubdivisions = 10;
+
+	int32 Level = 0;
+
+	// Unit length, also the smooth shading normals
+	TArray<FVector> UnitPositions;
+	TArray<int32> Triangles;
+	TArray<FVector2D> UVs;
+
+	SIZE_T GetAllocatedSize() const;
+
+	// Equirectangular mapping of a unit direction, shared with the LOD chunks
+	static FVector2D ComputeUV(const FVector& UnitPosition);
+
+	static TSharedRef<const FPlanetTopology, ESPMode::ThreadSafe> Build(int32 SubdivisionLevel);
+
+	// Closed forms for the subdivided icosahedron: 10 * 4^n + 2 vertices, 20 * 4^n triangles
+	static int32 NumVerticesAtLevel(int32 SubdivisionLevel);
+	static int32 NumTrianglesAtLevel(int32 SubdivisionLevel);
+};
+
+// Process-wide topology per subdivision level, built on first use from any thread
+class SOLARSYSTEM2_API FPlanetTopologyCache
+{
+public:
+	static FPlanetTopologyCache& Get();
+
+	TSharedRef<const FPlanetTopology, ESPMode::ThreadSafe> FindOrBuild(int32 SubdivisionLevel);
+
+	// Drops the levels no planet references anymore, generators call it whenever they let go of one
+	void ReleaseUnused();
+
+private:
+	FRWLock Lock;
+	TSharedPtr<const FPlanetTopology, ESPMode::ThreadSafe> Levels[FPlanetTopology::MaxSubdivisions + 1];
+};
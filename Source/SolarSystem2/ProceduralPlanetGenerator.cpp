@@ -1,235 +1,484 @@
 #include "ProceduralPlanetGenerator.h"
+#include "SolarSystemStats.h"
+#include "PlanetHeightField.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 
 UProceduralPlanetGenerator::UProceduralPlanetGenerator(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
-	PrimaryComponentTick.bCanEverTick = false;
+	// Only the quadtree LOD mode ticks
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	// Terrain edits rebuild the collision, keep the cook off the game thread
+	bUseAsyncCooking = true;
+}
+
+FPlanetMeshSettings UProceduralPlanetGenerator::GetMeshSettings() const
+{
+	FPlanetMeshSettings Settings;
+	Settings.Radius = Radius;
+	Settings.Subdivisions = Subdivisions;
+	Settings.SmoothShading = SmoothShading;
+	Settings.ApplyNoise = ApplyNoise;
+	Settings.NoiseScale = NoiseScale;
+	Settings.NoiseHeightMultiplier = NoiseHeightMultiplier;
+	Settings.NoiseOctaves = NoiseOctaves;
+	Settings.NoisePersistence = NoisePersistence;
+	Settings.NoiseLacunarity = NoiseLacunarity;
+	Settings.NoiseSeed = NoiseSeed;
+	Settings.HeightCacheResolution = UseHeightCache ? FMath::Clamp(HeightCacheResolution, 16, 4096) : 0;
+	return Settings;
 }
 
 void UProceduralPlanetGenerator::GeneratePlanet()
 {
-	NoiseGenerator = MakeUnique<FPerlinNoise>(NoiseSeed);
+	if (UseQuadtreeLOD) {
+		ResetChunks();
+		SetComponentTickEnabled(true);
+		return;
+	}
 
-	Vertices.Empty();
-	Triangles.Empty();
-	Normals.Empty();
-	UVs.Empty();
-	VertexColors.Empty();
-	Tangents.Empty();
+	// Leaving LOD mode, the chunk sections go before the icosphere takes section 0
+	if (Chunks.Num() > 0) {
+		ResetChunks();
+	}
 
-	GenerateIcosahedron();
-	SubdivideMesh(Subdivisions);
-	NormalizeVertices();
+	GenerationId++;
+	Generating = false;
 
-	if (ApplyNoise) {
-		ApplyNoiseToVertices();
+	FPlanetMeshData Mesh;
+	FPlanetMeshBuilder::Build(GetMeshSettings(), Mesh);
+
+	UploadMesh(Mesh);
+	OnPlanetGenerated.Broadcast(this);
+}
+
+void UProceduralPlanetGenerator::GeneratePlanetAsync()
+{
+	// Chunks always build on worker threads
+	if (UseQuadtreeLOD) {
+		GeneratePlanet();
+		return;
 	}
 
-	CalculateNormals();
-	CalculateUVs();
+	if (Chunks.Num() > 0) {
+		ResetChunks();
+	}
 
-	CreateMeshSection_LinearColor(
-		0,
-		Vertices,
-		Triangles,
-		Normals,
-		UVs,
-		VertexColors,
-		Tangents,
-		true
-	);
+	const FPlanetMeshSettings Settings = GetMeshSettings();
+	const uint32 Generation = ++GenerationId;
+	Generating = true;
+
+	if (ShowPlaceholderWhileBuilding && GetNumSections() == 0) {
+		FPlanetMeshSettings PlaceholderSettings = Settings;
+		PlaceholderSettings.Subdivisions = FMath::Min(Settings.Subdivisions, 1);
+		PlaceholderSettings.ApplyNoise = false;
+
+		FPlanetMeshData Placeholder;
+		FPlanetMeshBuilder::Build(PlaceholderSettings, Placeholder);
+		UploadMesh(Placeholder);
+	}
+
+	TWeakObjectPtr<UProceduralPlanetGenerator> WeakThis(this);
+
+	// Every planet gets its own task, so a level full of bodies builds them all in parallel
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Settings, Generation]() {
+		FPlanetMeshData Mesh;
+		FPlanetMeshBuilder::Build(Settings, Mesh);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Mesh = MoveTemp(Mesh), Generation]() {
+			UProceduralPlanetGenerator* Generator = WeakThis.Get();
+
+			if (!Generator || Generator->GenerationId != Generation) {
+				return;
+			}
+
+			Generator->Generating = false;
+			Generator->UploadMesh(Mesh);
+			Generator->OnPlanetGenerated.Broadcast(Generator);
+		});
+	});
+}
+
+void UProceduralPlanetGenerator::UploadMesh(const FPlanetMeshData& Mesh)
+{
+	const FProcMeshSection* Section = GetProcMeshSection(0);
+	const bool SameTopology = UploadedTopology == Mesh.Topology && Section && Section->ProcVertexBuffer.Num() == Mesh.Vertices.Num();
+
+	{
+		SOLARSYSTEM_SCOPE(MeshSection);
+
+		if (SameTopology) {
+			// Empty UV, color and tangent arrays leave those buffers as they are
+			UpdateMeshSection_LinearColor(0, Mesh.Vertices, Mesh.Normals, TArray<FVector2D>(), TArray<FLinearColor>(), TArray<FProcMeshTangent>());
+		} else {
+			CreateMeshSection_LinearColor(
+				0,
+				Mesh.Vertices,
+				Mesh.Topology->Triangles,
+				Mesh.Normals,
+				Mesh.Topology->UVs,
+				Mesh.VertexColors,
+				Mesh.Tangents,
+				true
+			);
+			// Another subdivision level, the one drawn so far may be unused now
+			const bool TopologyChanged = UploadedTopology.IsValid();
+			UploadedTopology = Mesh.Topology;
+
+			if (TopologyChanged) {
+				FPlanetTopologyCache::Get().ReleaseUnused();
+			}
+		}
+	}
+
+	// New noise settings, the field behind the previous mesh may be unused now
+	if (UploadedHeightField != Mesh.HeightField) {
+		const bool HeightFieldChanged = UploadedHeightField.IsValid();
+		UploadedHeightField = Mesh.HeightField;
+
+		if (HeightFieldChanged) {
+			FPlanetHeightCache::Get().ReleaseUnused();
+		}
+	}
+
+	// Section 0 is the only one outside LOD mode, it replaces whatever was counted before
+	DEC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, ResidentVertices);
+	ResidentVertices = Mesh.Vertices.Num();
+	INC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, ResidentVertices);
 
 	SetVisibility(true);
 	SetHiddenInGame(false);
 
 	UE_LOG(LogTemp, Log, TEXT("Generated planet with %d vertices and %d triangles (Noise: %s)"),
-		Vertices.Num(), Triangles.Num() / 3, ApplyNoise ? TEXT("ON") : TEXT("OFF"));
+		Mesh.Vertices.Num(), Mesh.Topology->Triangles.Num() / 3, ApplyNoise ? TEXT("ON") : TEXT("OFF"));
 }
 
-void UProceduralPlanetGenerator::ApplyNoiseToVertices()
+void UProceduralPlanetGenerator::ReleaseCachedData()
 {
-	if (!NoiseGenerator.IsValid()) {
-		return;
+	if (UploadedTopology.IsValid()) {
+		UploadedTopology.Reset();
+		FPlanetTopologyCache::Get().ReleaseUnused();
 	}
 
-	for (int32 i = 0; i < Vertices.Num(); i++) {
-		FVector Point = Vertices[i].GetSafeNormal();
+	if (UploadedHeightField.IsValid()) {
+		UploadedHeightField.Reset();
+		FPlanetHeightCache::Get().ReleaseUnused();
+	}
+}
+
+void UProceduralPlanetGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ReleaseCachedData();
+	Super::EndPlay(EndPlayReason);
+}
+
+void UProceduralPlanetGenerator::BeginDestroy()
+{
+	// Components destroyed outside play, in the editor for one, never see EndPlay
+	ReleaseCachedData();
+
+	DEC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, ResidentVertices);
+	ResidentVertices = 0;
 
-		float NoiseValue = NoiseGenerator->FractalNoise2D(
-			Point.X * NoiseScale,
-			Point.Y * NoiseScale,
-			NoiseOctaves,
-			NoisePersistence,
-			NoiseLacunarity
-		);
+	Super::BeginDestroy();
+}
 
-		float HeightOffset = (NoiseValue + 1.0f) * 0.5f;
-		float FinalRadius = Radius * (1.0f + HeightOffset * NoiseHeightMultiplier);
+#if WITH_EDITOR
+void UProceduralPlanetGenerator::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
 
-		Vertices[i] = Point * FinalRadius;
+	const FProperty* Property = PropertyChangedEvent.MemberProperty;
+	if (!Property || Property->GetOwnerClass() != UProceduralPlanetGenerator::StaticClass()) {
+		return;
 	}
 
-	UE_LOG(LogTemp, Log, TEXT("Applied noise to %d vertices (Scale=%.2f, Height=%.2f, Octaves=%d)"),
-		Vertices.Num(), NoiseScale, NoiseHeightMultiplier, NoiseOctaves);
+	// Only a planet that already exists follows its properties, slider drags land here every frame
+	if (GetNumSections() > 0 || IsComponentTickEnabled()) {
+		GeneratePlanetAsync();
+	}
 }
+#endif
 
-void UProceduralPlanetGenerator::GenerateIcosahedron()
+void UProceduralPlanetGenerator::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
-	const float Phi = (1.0f + FMath::Sqrt(5.0f)) / 2.0f;
-	const float Scale = 1.0f / FMath::Sqrt(Phi * Phi + 1.0f);
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	Vertices.Add(FVector(-1, Phi, 0) * Scale);
-	Vertices.Add(FVector(1, Phi, 0) * Scale);
-	Vertices.Add(FVector(-1, -Phi, 0) * Scale);
-	Vertices.Add(FVector(1, -Phi, 0) * Scale);
-
-	Vertices.Add(FVector(0, -1, Phi) * Scale);
-	Vertices.Add(FVector(0, 1, Phi) * Scale);
-	Vertices.Add(FVector(0, -1, -Phi) * Scale);
-	Vertices.Add(FVector(0, 1, -Phi) * Scale);
+	if (!UseQuadtreeLOD) {
+		SetComponentTickEnabled(false);
+		return;
+	}
 
-	Vertices.Add(FVector(Phi, 0, -1) * Scale);
-	Vertices.Add(FVector(Phi, 0, 1) * Scale);
-	Vertices.Add(FVector(-Phi, 0, -1) * Scale);
-	Vertices.Add(FVector(-Phi, 0, 1) * Scale);
+	APlayerController* PlayerController = GetWorld() ? GetWorld()->GetFirstPlayerController() : nullptr;
+	if (!PlayerController || !PlayerController->PlayerCameraManager) {
+		return;
+	}
 
-	Triangles.Append({ 0, 11, 5 });
-	Triangles.Append({ 0, 5, 1 });
-	Triangles.Append({ 0, 1, 7 });
-	Triangles.Append({ 0, 7, 10 });
-	Triangles.Append({ 0, 10, 11 });
+	int32 ViewportWidth = 0;
+	int32 ViewportHeight = 0;
+	PlayerController->GetViewportSize(ViewportWidth, ViewportHeight);
 
-	Triangles.Append({ 1, 5, 9 });
-	Triangles.Append({ 5, 11, 4 });
-	Triangles.Append({ 11, 10, 2 });
-	Triangles.Append({ 10, 7, 6 });
-	Triangles.Append({ 7, 1, 8 });
+	// Pixels per unit of size at unit distance
+	const float FieldOfView = PlayerController->PlayerCameraManager->GetFOVAngle();
+	const double ScreenScale = FMath::Max(ViewportWidth, 1) / (2.0 * FMath::Tan(FMath::DegreesToRadians(FieldOfView) * 0.5));
 
-	Triangles.Append({ 3, 9, 4 });
-	Triangles.Append({ 3, 4, 2 });
-	Triangles.Append({ 3, 2, 6 });
-	Triangles.Append({ 3, 6, 8 });
-	Triangles.Append({ 3, 8, 9 });
+	const FVector CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+	UpdateChunkLOD(GetComponentTransform().InverseTransformPosition(CameraLocation), ScreenScale);
+}
 
-	Triangles.Append({ 4, 9, 5 });
-	Triangles.Append({ 2, 4, 11 });
-	Triangles.Append({ 6, 2, 10 });
-	Triangles.Append({ 8, 6, 7 });
-	Triangles.Append({ 9, 8, 1 });
+void UProceduralPlanetGenerator::ResetChunks()
+{
+	ClearAllMeshSections();
+	ReleaseCachedData();
+	DEC_MEMORY_STAT_BY(STAT_SolarSystem_ChunkMemory, ChunkBytes);
+	DEC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, ResidentVertices);
+	ResidentVertices = 0;
+
+	Chunks.Reset();
+	PendingUploads.Reset();
+	VisibleChunks.Reset();
+	FreeSections.Reset();
+	NextSection = 0;
+	ChunkBytes = 0;
+
+	// Builds still in flight carry the old id and are dropped when they land, they keep counting against
+	// MaxChunkBuildsInFlight until then
+	GenerationId++;
+	Generating = true;
+	ChunkRootsAnnounced = false;
+
+	ChunkSettings = GetMeshSettings();
+	BuiltChunkResolution = FMath::Clamp(ChunkResolution, 2, 128);
+	BuiltCollisionDepth = ChunkCollisionDepth;
 }
 
-int32 UProceduralPlanetGenerator::GetMiddlePoint(int32 PointA, int32 PointB, TMap<int64, int32>& MiddlePointCache)
+void UProceduralPlanetGenerator::UpdateChunkLOD(const FVector& LocalCameraPosition, double ScreenScale)
 {
-	bool FirstIsSmaller = PointA < PointB;
-	int64 SmallerIndex = FirstIsSmaller ? PointA : PointB;
-	int64 GreaterIndex = FirstIsSmaller ? PointB : PointA;
-	int64 Key = (SmallerIndex << 32) + GreaterIndex;
+	SOLARSYSTEM_SCOPE(ChunkLOD);
 
-	if (MiddlePointCache.Contains(Key))	{
-		return MiddlePointCache[Key];
+	if (GetMeshSettings() != ChunkSettings || FMath::Clamp(ChunkResolution, 2, 128) != BuiltChunkResolution || ChunkCollisionDepth != BuiltCollisionDepth) {
+		ResetChunks();
 	}
 
-	FVector LocalPointA = Vertices[PointA];
-	FVector LocalPointB = Vertices[PointB];
-	FVector Middle = (LocalPointA + LocalPointB) / 2.0f;
+	LODFrame++;
 
-	int32 Index = Vertices.Add(Middle);
-	MiddlePointCache.Add(Key, Index);
+	ReceiveChunks();
+	UploadChunks();
 
-	return Index;
-}
+	TArray<uint64> Selected;
+	int32 RootsReady = 0;
 
-void UProceduralPlanetGenerator::SubdivideMesh(int32 SubdivisionLevel)
-{
-	TMap<int64, int32> MiddlePointCache;
+	for (int32 Face = 0; Face < FPlanetChunkKey::NumFaces; ++Face) {
+		FPlanetChunkKey Root;
+		Root.Face = Face;
 
-	for (int32 level = 0; level < SubdivisionLevel; level++) {
-		TArray<int32> NewTriangles;
-		MiddlePointCache.Empty();
+		if (IsChunkReady(Root)) {
+			SelectChunk(Root, LocalCameraPosition, ScreenScale, Selected);
+			RootsReady++;
+		}
+	}
+
+	// Show the new cut before hiding the old one so no frame has a hole
+	for (uint64 Key : Selected) {
+		FChunk& Chunk = Chunks[Key];
+		if (!Chunk.Visible) {
+			SetMeshSectionVisible(Chunk.Section, true);
+			Chunk.Visible = true;
+		}
+	}
 
-		for (int32 i = 0; i < Triangles.Num(); i += 3) {
-			int32 LocalPointA = Triangles[i];
-			int32 LocalPointB = Triangles[i + 1];
-			int32 LocalPointC = Triangles[i + 2];
+	for (uint64 Key : VisibleChunks) {
+		FChunk* Chunk = Chunks.Find(Key);
+		if (Chunk && Chunk->Visible && Chunk->SelectedFrame != LODFrame) {
+			SetMeshSectionVisible(Chunk->Section, false);
+			Chunk->Visible = false;
+		}
+	}
 
-			int32 MidAB = GetMiddlePoint(LocalPointA, LocalPointB, MiddlePointCache);
-			int32 MidBC = GetMiddlePoint(LocalPointB, LocalPointC, MiddlePointCache);
-			int32 MidCA = GetMiddlePoint(LocalPointC, LocalPointA, MiddlePointCache);
+	VisibleChunks = MoveTemp(Selected);
+	SET_DWORD_STAT(STAT_SolarSystem_VisibleChunks, VisibleChunks.Num());
 
-			NewTriangles.Append({ LocalPointA, MidAB, MidCA });
-			NewTriangles.Append({ LocalPointB, MidBC, MidAB });
-			NewTriangles.Append({ LocalPointC, MidCA, MidBC });
-			NewTriangles.Append({ MidAB, MidBC, MidCA });
+	EvictChunks();
+
+	if (!ChunkRootsAnnounced && RootsReady == FPlanetChunkKey::NumFaces) {
+		ChunkRootsAnnounced = true;
+		Generating = false;
+		OnPlanetGenerated.Broadcast(this);
+	}
+}
+
+void UProceduralPlanetGenerator::SelectChunk(const FPlanetChunkKey& Key, const FVector& LocalCameraPosition, double ScreenScale, TArray<uint64>& OutSelected)
+{
+	FVector Center;
+	double BoundsRadius = 0.0;
+	FPlanetChunkBuilder::GetBounds(ChunkSettings, Key, Center, BoundsRadius);
+
+	const double Distance = FMath::Max(FVector::Dist(LocalCameraPosition, Center) - BoundsRadius, UE_KINDA_SMALL_NUMBER);
+	const double ScreenSpaceError = FPlanetChunkBuilder::GetVertexSpacing(ChunkSettings, Key, BuiltChunkResolution) * ScreenScale / Distance;
+
+	if (ScreenSpaceError > MaxScreenSpaceError && Key.Depth < FMath::Min(MaxLODDepth, FPlanetChunkKey::MaxDepth)) {
+		// Split only once every child can be drawn, until then this chunk stays in place
+		bool ChildrenReady = true;
+		for (int32 Child = 0; Child < 4; ++Child) {
+			ChildrenReady = IsChunkReady(Key.GetChild(Child)) && ChildrenReady;
 		}
 
-		Triangles = MoveTemp(NewTriangles);
+		if (ChildrenReady) {
+			for (int32 Child = 0; Child < 4; ++Child) {
+				SelectChunk(Key.GetChild(Child), LocalCameraPosition, ScreenScale, OutSelected);
+			}
+			return;
+		}
 	}
+
+	FChunk& Chunk = Chunks[Key.Pack()];
+	Chunk.SelectedFrame = LODFrame;
+	OutSelected.Add(Key.Pack());
 }
 
-void UProceduralPlanetGenerator::NormalizeVertices()
+bool UProceduralPlanetGenerator::IsChunkReady(const FPlanetChunkKey& Key)
 {
-	for (int32 i =0; i < Vertices.Num(); i++) {
-		FVector Normalized = Vertices[i].GetSafeNormal();
+	FChunk* Chunk = Chunks.Find(Key.Pack());
 
-		Vertices[i] = Normalized * Radius;
+	if (!Chunk) {
+		RequestChunk(Key);
+		return false;
 	}
+
+	Chunk->LastUsedFrame = LODFrame;
+	return Chunk->Section != INDEX_NONE;
 }
 
-void UProceduralPlanetGenerator::CalculateNormals()
+void UProceduralPlanetGenerator::RequestChunk(const FPlanetChunkKey& Key)
 {
-	Normals.SetNum(Vertices.Num());
+	// Asked for again next frame when the builders are busy
+	if (ChunkBuildsInFlight >= FMath::Max(MaxChunkBuildsInFlight, 1)) {
+		return;
+	}
 
-	if (SmoothShading) {
-		for (int32 i = 0; i < Vertices.Num(); i++) {
-			Normals[i] = Vertices[i].GetSafeNormal();
+	FChunk& Chunk = Chunks.Add(Key.Pack());
+	Chunk.Key = Key;
+	Chunk.Building = true;
+	Chunk.LastUsedFrame = LODFrame;
+	ChunkBuildsInFlight++;
+
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [Results = ChunkResults, Settings = ChunkSettings, Key, Resolution = BuiltChunkResolution, Generation = GenerationId]() {
+		FChunkBuildResult Result;
+		Result.Key = Key.Pack();
+		Result.Generation = Generation;
+		Result.Mesh = MakeShared<FPlanetChunkMesh, ESPMode::ThreadSafe>();
+
+		FPlanetChunkBuilder::Build(Settings, Key, Resolution, *Result.Mesh);
+		Results->Enqueue(MoveTemp(Result));
+	});
+}
+
+void UProceduralPlanetGenerator::ReceiveChunks()
+{
+	FChunkBuildResult Result;
+
+	while (ChunkResults->Dequeue(Result)) {
+		ChunkBuildsInFlight--;
+
+		if (Result.Generation != GenerationId) {
+			continue;
 		}
-	} else {
-		TArray<int32> NormalCount;
-		NormalCount.SetNumZeroed(Vertices.Num());
 
-		for (int32 i = 0; i < Normals.Num(); i += 3) {
-			Normals[i] = FVector::ZeroVector;
+		if (FChunk* Chunk = Chunks.Find(Result.Key)) {
+			Chunk->Building = false;
+			Chunk->PendingMesh = MoveTemp(Result.Mesh);
+			PendingUploads.Add(Result.Key);
 		}
+	}
+}
 
-		for (int32 i = 0; i < Triangles.Num(); i += 3) {
-			int32 VertexIndexA = Triangles[i];
-			int32 VertexIndexB = Triangles[i + 1];
-			int32 VertexIndexC = Triangles[i + 2];
+void UProceduralPlanetGenerator::UploadChunks()
+{
+	if (!ChunkMaterial) {
+		ChunkMaterial = GetMaterial(0);
+	}
+
+	int32 Uploaded = 0;
+	int32 Consumed = 0;
 
-			FVector VertexA = Vertices[VertexIndexA];
-			FVector VertexB = Vertices[VertexIndexB];
-			FVector VertexC = Vertices[VertexIndexC];
+	for (; Consumed < PendingUploads.Num() && Uploaded < FMath::Max(MaxChunkUploadsPerFrame, 1); ++Consumed) {
+		FChunk* Chunk = Chunks.Find(PendingUploads[Consumed]);
+		if (!Chunk || !Chunk->PendingMesh.IsValid()) {
+			continue;
+		}
 
-			FVector Edge1 = VertexB - VertexA;
-			FVector Edge2 = VertexC - VertexA;
-			FVector FaceNormal = FVector::CrossProduct(Edge1, Edge2).GetSafeNormal();
+		const FPlanetChunkMesh& Mesh = *Chunk->PendingMesh;
+		Chunk->Section = FreeSections.Num() > 0 ? FreeSections.Pop(EAllowShrinking::No) : NextSection++;
 
-			Normals[VertexIndexA] += FaceNormal;
-			Normals[VertexIndexB] += FaceNormal;
-			Normals[VertexIndexC] += FaceNormal;
+		// One level collides, so no two overlapping chunks ever do, and it stays put while the view refines below it
+		const bool CreateCollision = Chunk->Key.Depth == FMath::Min(ChunkCollisionDepth, MaxLODDepth);
 
-			NormalCount[VertexIndexA]++;
-			NormalCount[VertexIndexB]++;
-			NormalCount[VertexIndexC]++;
+		{
+			SOLARSYSTEM_SCOPE(MeshSection);
+			CreateMeshSection_LinearColor(Chunk->Section, Mesh.Vertices, Mesh.Triangles, Mesh.Normals, Mesh.UVs, Mesh.VertexColors, Mesh.Tangents, CreateCollision);
 		}
 
-		for (int32 i = 0; i < Normals.Num(); i++) {
-			if (NormalCount[i] > 0) {
-				Normals[i] = (Normals[i] / NormalCount[i]).GetSafeNormal();
-			}
+		SetMeshSectionVisible(Chunk->Section, false);
+		if (ChunkMaterial) {
+			SetMaterial(Chunk->Section, ChunkMaterial);
 		}
+
+		// The section keeps its own copy, the chunk only remembers what it costs
+		Chunk->Bytes = Mesh.GetAllocatedSize();
+		UploadedHeightField = Mesh.HeightField;
+		ChunkBytes += Chunk->Bytes;
+		INC_MEMORY_STAT_BY(STAT_SolarSystem_ChunkMemory, Chunk->Bytes);
+		Chunk->NumVertices = Mesh.Vertices.Num();
+		ResidentVertices += Chunk->NumVertices;
+		INC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, Chunk->NumVertices);
+
+		Chunk->PendingMesh.Reset();
+		Uploaded++;
 	}
+
+	PendingUploads.RemoveAt(0, Consumed, EAllowShrinking::No);
 }
 
-void UProceduralPlanetGenerator::CalculateUVs()
+void UProceduralPlanetGenerator::EvictChunks()
 {
-	UVs.SetNum(Vertices.Num());
+	const SIZE_T Budget = (SIZE_T)(FMath::Max(ChunkMemoryBudgetMB, 1.0f) * 1024.0 * 1024.0);
+	if (ChunkBytes <= Budget) {
+		return;
+	}
+
+	// Least recently used first, nothing drawn or touched this frame is a candidate
+	TArray<FChunk*> Candidates;
+	for (TPair<uint64, FChunk>& Pair : Chunks) {
+		FChunk& Chunk = Pair.Value;
+		if (Chunk.Section != INDEX_NONE && !Chunk.Visible && Chunk.LastUsedFrame < LODFrame) {
+			Candidates.Add(&Chunk);
+		}
+	}
 
-	for (int32 i = 0; i < Vertices.Num(); i++) {
-		FVector Normal = Vertices[i].GetSafeNormal();
+	Candidates.Sort([](const FChunk& A, const FChunk& B) { return A.LastUsedFrame < B.LastUsedFrame; });
 
-		float U = 0.5f + (FMath::Atan2(Normal.Y, Normal.X) / (2.0f * PI));
-		float V = 0.5f - (FMath::Asin(Normal.Z) / PI);
-		UVs[i] = FVector2D(U, V);
+	TArray<uint64> Evicted;
+	for (FChunk* Chunk : Candidates) {
+		if (ChunkBytes <= Budget) {
+			break;
+		}
+
+		ClearMeshSection(Chunk->Section);
+		FreeSections.Add(Chunk->Section);
+
+		ChunkBytes -= Chunk->Bytes;
+		DEC_MEMORY_STAT_BY(STAT_SolarSystem_ChunkMemory, Chunk->Bytes);
+		ResidentVertices -= Chunk->NumVertices;
+		DEC_DWORD_STAT_BY(STAT_SolarSystem_PlanetVertices, Chunk->NumVertices);
+		Evicted.Add(Chunk->Key.Pack());
 	}
-}
\ No newline at end of file
+
+	for (uint64 Key : Evicted) {
+		Chunks.Remove(Key);
+	}
+}
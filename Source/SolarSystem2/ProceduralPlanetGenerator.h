@@ -2,9 +2,15 @@
 
 #include "CoreMinimal.h"
 #include "ProceduralMeshComponent.h"
-#include "PerlinNoise.h"
+#include "PlanetMeshBuilder.h"
+#include "PlanetQuadtree.h"
+#include "Containers/Queue.h"
 #include "ProceduralPlanetGenerator.generated.h"
 
+class UProceduralPlanetGenerator;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPlanetGenerated, UProceduralPlanetGenerator*, Generator);
+
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
 class SOLARSYSTEM2_API UProceduralPlanetGenerator : public UProceduralMeshComponent
 {
@@ -16,12 +22,39 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation")
 	float Radius = 100.0f;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation", meta = (ClampMin = "0", ClampMax = "5"))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation", meta = (ClampMin = "0", ClampMax = "10", UIMax = "8", ToolTip = "Each level quadruples the triangles, 10 * 4^n + 2 vertices"))
 	int32 Subdivisions = 2;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation", meta = (ToolTip = "Per-vertex normals from the analytic noise gradient, off averages the face normals around each vertex"))
 	bool SmoothShading = true;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Generation", meta = (ToolTip = "Show a coarse untextured sphere until an async build finishes"))
+	bool ShowPlaceholderWhileBuilding = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ToolTip = "Replace the single icosphere with camera driven cube-sphere chunks"))
+	bool UseQuadtreeLOD = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "2", ClampMax = "128", ToolTip = "Grid cells along one chunk edge"))
+	int32 ChunkResolution = 32;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "0.1", ToolTip = "Projected vertex spacing in pixels above which a chunk splits"))
+	float MaxScreenSpaceError = 4.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "0", ClampMax = "24"))
+	int32 MaxLODDepth = 16;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "-1", ClampMax = "24", ToolTip = "Chunks at this depth carry collision. The LOD passes through it wherever it refines around the camera, so the ground there collides at one resolution while the drawn detail keeps changing. -1 turns chunk collision off"))
+	int32 ChunkCollisionDepth = 4;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "1", ToolTip = "Chunk meshes kept around, least recently used hidden chunks are evicted beyond this"))
+	float ChunkMemoryBudgetMB = 64.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "1"))
+	int32 MaxChunkBuildsInFlight = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet LOD", meta = (ClampMin = "1", ToolTip = "Mesh sections created per frame, bounds the game thread cost of streaming"))
+	int32 MaxChunkUploadsPerFrame = 4;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain Noise")
 	bool ApplyNoise = true;
 
@@ -43,27 +76,115 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain Noise")
 	int32 NoiseSeed = 91;
 
-	UFUNCTION(BlueprintCallable, Category = "Planet Generation")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain Noise", meta = (ToolTip = "Bake the noise once into Saved/PlanetCache and sample the memory mapped field on later runs"))
+	bool UseHeightCache = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain Noise", meta = (ClampMin = "16", ClampMax = "4096", UIMax = "2048", ToolTip = "Texels per cube face edge, also the finest terrain detail LOD chunks can show"))
+	int32 HeightCacheResolution = 512;
+
+	// Fired on the game thread once a new mesh has been uploaded
+	UPROPERTY(BlueprintAssignable, Category = "Planet Generation")
+	FOnPlanetGenerated OnPlanetGenerated;
+
+	// Builds and uploads the mesh on the calling thread.
+	// With the subdivision level unchanged only positions and normals are pushed to the existing section.
+	UFUNCTION(BlueprintCallable, CallInEditor, Category = "Planet Generation")
 	void GeneratePlanet();
 
-private:
-	TArray<FVector> Vertices;
-	TArray<int32> Triangles;
-	TArray<FVector> Normals;
-	TArray<FVector2D> UVs;
-	TArray<FLinearColor> VertexColors;
-	TArray<FProcMeshTangent> Tangents;
+	// Builds the mesh on a worker thread, only the upload happens on the game thread.
+	// A newer request supersedes a build still in flight.
+	UFUNCTION(BlueprintCallable, Category = "Planet Generation")
+	void GeneratePlanetAsync();
+
+	UFUNCTION(BlueprintPure, Category = "Planet Generation")
+	bool IsGenerating() const { return Generating; }
 
-	TUniquePtr<FPerlinNoise> NoiseGenerator;
+	FPlanetMeshSettings GetMeshSettings() const;
 
-	void GenerateIcosahedron();
-	void SubdivideMesh(int32 SubdivisionLevel);
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
-	void NormalizeVertices();
-	void CalculateNormals();
-	void CalculateUVs();
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	void ApplyNoiseToVertices();
+	virtual void BeginDestroy() override;
 
-	int32 GetMiddlePoint(int32 PointA, int32 PointB, TMap<int64, int32>& MiddlePointCache);
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	// Incremented by every request so a stale async build is dropped instead of uploaded
+	uint32 GenerationId = 0;
+
+	bool Generating = false;
+
+	void UploadMesh(const FPlanetMeshData& Mesh);
+
+	// Topology behind section 0, a mesh on the same one only needs its positions and normals updated
+	TSharedPtr<const FPlanetTopology, ESPMode::ThreadSafe> UploadedTopology;
+
+	// Height field the drawn meshes were sampled from, keeps it in the shared cache while this planet uses it
+	TSharedPtr<const FPlanetHeightField, ESPMode::ThreadSafe> UploadedHeightField;
+
+	// Lets go of UploadedTopology and UploadedHeightField and drops whatever no planet holds anymore from the shared caches
+	void ReleaseCachedData();
+
+	struct FChunk
+	{
+		FPlanetChunkKey Key;
+
+		// Built mesh waiting for its section, released once uploaded
+		TSharedPtr<FPlanetChunkMesh, ESPMode::ThreadSafe> PendingMesh;
+
+		int32 Section = INDEX_NONE;
+		SIZE_T Bytes = 0;
+		int32 NumVertices = 0;
+		bool Building = false;
+		bool Visible = false;
+		uint64 LastUsedFrame = 0;
+		uint64 SelectedFrame = 0;
+	};
+
+	struct FChunkBuildResult
+	{
+		uint64 Key = 0;
+		uint32 Generation = 0;
+		TSharedPtr<FPlanetChunkMesh, ESPMode::ThreadSafe> Mesh;
+	};
+
+	// Outlives the component so builds finishing after it is destroyed have somewhere to go
+	using FChunkResultQueue = TQueue<FChunkBuildResult, EQueueMode::Mpsc>;
+	TSharedRef<FChunkResultQueue, ESPMode::ThreadSafe> ChunkResults = MakeShared<FChunkResultQueue, ESPMode::ThreadSafe>();
+
+	TMap<uint64, FChunk> Chunks;
+	TArray<uint64> PendingUploads;
+	TArray<uint64> VisibleChunks;
+	TArray<int32> FreeSections;
+	int32 NextSection = 0;
+	// Counts every build still running, those of earlier generations included
+	int32 ChunkBuildsInFlight = 0;
+	SIZE_T ChunkBytes = 0;
+	uint64 LODFrame = 0;
+
+	// Settings the chunks were built with, a change throws them all away
+	FPlanetMeshSettings ChunkSettings;
+	int32 BuiltChunkResolution = 0;
+	int32 BuiltCollisionDepth = INDEX_NONE;
+
+	// Vertices in the sections of this component, what it adds to STAT_SolarSystem_PlanetVertices
+	int32 ResidentVertices = 0;
+
+	// OnPlanetGenerated fires once all six root chunks are up
+	bool ChunkRootsAnnounced = false;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UMaterialInterface> ChunkMaterial;
+
+	void ResetChunks();
+	void UpdateChunkLOD(const FVector& LocalCameraPosition, double ScreenScale);
+	void SelectChunk(const FPlanetChunkKey& Key, const FVector& LocalCameraPosition, double ScreenScale, TArray<uint64>& OutSelected);
+	bool IsChunkReady(const FPlanetChunkKey& Key);
+	void RequestChunk(const FPlanetChunkKey& Key);
+	void ReceiveChunks();
+	void UploadChunks();
+	void EvictChunks();
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "SimulationThread.h"
+#include "SolarSystemStats.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+
+FSimulationThread::~FSimulationThread()
+{
+	Shutdown();
+
+	if (WakeEvent) {
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+}
+
+void FSimulationThread::Start(const FNBodySimulation& Settings, const FNBodyState& InitialState, const FSimulationThreadSettings& InThreadSettings)
+{
+	Shutdown();
+
+	// Edits and a snapshot left over from the previous run refer to another state
+	Commands.Empty();
+	if (Snapshots.IsDirty()) {
+		Snapshots.SwapReadBuffers();
+	}
+
+	Simulation.CopySettings(Settings);
+	Simulation.State = InitialState;
+	ThreadSettings = InThreadSettings;
+	SentSimulation.CopySettings(Settings);
+	SentSettings = InThreadSettings;
+	TimeAccumulator = 0.0;
+	AccelerationsStale = true;
+	StateChanged = false;
+
+	if (!WakeEvent) {
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+
+	StopRequested = false;
+	Thread = FRunnableThread::Create(this, TEXT("SolarSystemSimulation"), 0, TPri_AboveNormal);
+}
+
+void FSimulationThread::Shutdown()
+{
+	if (!Thread) {
+		return;
+	}
+
+	// Kill calls Stop and waits for Run to return
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+}
+
+void FSimulationThread::Stop()
+{
+	StopRequested = true;
+
+	if (WakeEvent) {
+		WakeEvent->Trigger();
+	}
+}
+
+void FSimulationThread::UpdateSettings(const FNBodySimulation& Settings, const FSimulationThreadSettings& InThreadSettings)
+{
+	if (SentSimulation.HasSameSettings(Settings) && SentSettings == InThreadSettings) {
+		return;
+	}
+
+	SentSimulation.CopySettings(Settings);
+	SentSettings = InThreadSettings;
+
+	// A settings only copy, its state and scratch buffers are empty
+	FNBodySimulation NewSettings;
+	NewSettings.CopySettings(Settings);
+
+	Commands.Enqueue([this, NewSettings = MoveTemp(NewSettings), NewThreadSettings = InThreadSettings]() {
+		Simulation.CopySettings(NewSettings);
+		ThreadSettings = NewThreadSettings;
+		AccelerationsStale = true;
+	});
+}
+
+void FSimulationThread::SetBodyPosition(int32 BodyIndex, const FVector3d& Position)
+{
+	Commands.Enqueue([this, BodyIndex, Position]() {
+		if (Simulation.State.Positions.IsValidIndex(BodyIndex)) {
+			Simulation.State.Positions[BodyIndex] = Position;
+			AccelerationsStale = true;
+			StateChanged = true;
+		}
+	});
+}
+
+void FSimulationThread::SetBodyVelocity(int32 BodyIndex, const FVector3d& Velocity)
+{
+	Commands.Enqueue([this, BodyIndex, Velocity]() {
+		if (Simulation.State.Velocities.IsValidIndex(BodyIndex)) {
+			Simulation.State.Velocities[BodyIndex] = Velocity;
+			StateChanged = true;
+		}
+	});
+}
+
+void FSimulationThread::SetBodyMass(int32 BodyIndex, double Mass)
+{
+	Commands.Enqueue([this, BodyIndex, Mass]() {
+		if (Simulation.State.Masses.IsValidIndex(BodyIndex)) {
+			Simulation.State.Masses[BodyIndex] = Mass;
+			AccelerationsStale = true;
+			StateChanged = true;
+		}
+	});
+}
+
+void FSimulationThread::AddBody(const FVector3d& Position, const FVector3d& Velocity, double Mass)
+{
+	Commands.Enqueue([this, Position, Velocity, Mass]() {
+		Simulation.State.AddBody(Position, Velocity, Mass);
+		AccelerationsStale = true;
+		StateChanged = true;
+	});
+}
+
+const FSimulationSnapshot* FSimulationThread::ReceiveSnapshot()
+{
+	if (!Snapshots.IsDirty()) {
+		return nullptr;
+	}
+
+	Snapshots.SwapReadBuffers();
+	return &Snapshots.Read();
+}
+
+uint32 FSimulationThread::Run()
+{
+	double LastTime = FPlatformTime::Seconds();
+
+	while (!StopRequested) {
+		const double StartTime = FPlatformTime::Seconds();
+		const double DeltaTime = StartTime - LastTime;
+		LastTime = StartTime;
+
+		TUniqueFunction<void()> Command;
+		while (Commands.Dequeue(Command)) {
+			Command();
+		}
+
+		Advance(DeltaTime);
+
+		// Sleep off the rest of the period, an update that ran late starts the next one right away
+		const double Remaining = 1.0 / FMath::Max(ThreadSettings.UpdateRate, 1.0) - (FPlatformTime::Seconds() - StartTime);
+		if (Remaining > 0.0) {
+			WakeEvent->Wait(FTimespan::FromSeconds(Remaining));
+		}
+	}
+
+	return 0;
+}
+
+void FSimulationThread::Advance(double DeltaTime)
+{
+	SOLARSYSTEM_SCOPE(SimulationThread);
+
+	const double StepSize = FMath::Max(ThreadSettings.StepSize, 0.0001);
+	const int32 MaxSubsteps = FMath::Max(ThreadSettings.MaxSubsteps, 1);
+	int32 Substeps = 0;
+
+	// Forward only like the integrator in Tick, a negative time scale pauses it and zero holds it during playback
+	TimeAccumulator += DeltaTime * FMath::Max(ThreadSettings.TimeScale, 0.0);
+
+	// The integrator expects the cached accelerations to match the current positions
+	if (AccelerationsStale && Simulation.State.Num() > 0) {
+		Simulation.ComputeAccelerations();
+		AccelerationsStale = false;
+	}
+
+	while (TimeAccumulator >= StepSize && Substeps < MaxSubsteps) {
+		Simulation.Step(StepSize);
+		TimeAccumulator -= StepSize;
+		Substeps++;
+	}
+
+	// Same budget as in Tick, time it could not cover is dropped rather than carried over
+	if (TimeAccumulator >= StepSize) {
+		TimeAccumulator = FMath::Fmod(TimeAccumulator, StepSize);
+	}
+
+	if (Substeps > 0 || StateChanged) {
+		Publish();
+		StateChanged = false;
+	}
+}
+
+void FSimulationThread::Publish()
+{
+	const FNBodyState& State = Simulation.State;
+	FSimulationSnapshot& Snapshot = Snapshots.GetWriteBuffer();
+
+	// Each of the three buffers keeps its allocations, so a publish only copies once the body count settles
+	Snapshot.Positions = State.Positions;
+	Snapshot.Velocities = State.Velocities;
+	Snapshot.Accelerations = State.Accelerations;
+	Snapshot.Masses = State.Masses;
+	Snapshot.Time = State.Time;
+	Snapshot.PublishTime = FPlatformTime::Seconds();
+
+	Snapshots.SwapWriteBuffers();
+}
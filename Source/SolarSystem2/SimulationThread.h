@@ -0,0 +1,106 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimulation.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "Containers/TripleBuffer.h"
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+
+// State of every body after one update of the simulation thread, left alone by the thread once published
+struct FSimulationSnapshot
+{
+	TArray<FVector3d> Positions;
+	TArray<FVector3d> Velocities;
+	TArray<FVector3d> Accelerations;
+	TArray<double> Masses;
+
+	// Simulated time of the state
+	double Time = 0.0;
+
+	// FPlatformTime::Seconds() at publish, the game thread interpolates on this clock
+	double PublishTime = 0.0;
+};
+
+struct FSimulationThreadSettings
+{
+	double TimeScale = 1.0;
+	double StepSize = 0.02;
+	int32 MaxSubsteps = 64;
+
+	// Wall clock updates per second, each one takes as many fixed steps as its scaled time covers
+	double UpdateRate = 120.0;
+
+	bool operator==(const FSimulationThreadSettings& Other) const
+	{
+		return TimeScale == Other.TimeScale && StepSize == Other.StepSize && MaxSubsteps == Other.MaxSubsteps && UpdateRate == Other.UpdateRate;
+	}
+
+	bool operator!=(const FSimulationThreadSettings& Other) const { return !(*this == Other); }
+};
+
+// Integrates the bodies on a thread of its own at a fixed wall clock rate.
+// The game thread hands edits over through a lock-free command queue and picks the newest state out of a triple buffer,
+// so neither side ever waits for the other and the step cost stays off the frame.
+class SOLARSYSTEM2_API FSimulationThread : public FRunnable
+{
+public:
+	virtual ~FSimulationThread() override;
+
+	// Starts from a copy of InitialState, stopping the running thread first
+	void Start(const FNBodySimulation& Settings, const FNBodyState& InitialState, const FSimulationThreadSettings& InThreadSettings);
+
+	void Shutdown();
+
+	bool IsRunning() const { return Thread != nullptr; }
+
+	// Game thread only, forwards the settings when they differ from the ones sent last
+	void UpdateSettings(const FNBodySimulation& Settings, const FSimulationThreadSettings& InThreadSettings);
+
+	// Edits may come from any thread, they are applied between two updates in the order they were made
+	void SetBodyPosition(int32 BodyIndex, const FVector3d& Position);
+
+	void SetBodyVelocity(int32 BodyIndex, const FVector3d& Velocity);
+
+	void SetBodyMass(int32 BodyIndex, double Mass);
+
+	void AddBody(const FVector3d& Position, const FVector3d& Velocity, double Mass);
+
+	// Game thread only, the newest snapshot or nullptr when none was published since the last call
+	const FSimulationSnapshot* ReceiveSnapshot();
+
+	virtual uint32 Run() override;
+
+	virtual void Stop() override;
+
+private:
+	FRunnableThread* Thread = nullptr;
+
+	// Wakes the thread out of its wait between updates when it has to stop
+	FEvent* WakeEvent = nullptr;
+
+	std::atomic<bool> StopRequested { false };
+
+	TQueue<TUniqueFunction<void()>, EQueueMode::Mpsc> Commands;
+
+	// Written only by whoever owns the simulation, the thread while it runs
+	TTripleBuffer<FSimulationSnapshot> Snapshots;
+
+	// Owned by the thread while it runs
+	FNBodySimulation Simulation;
+	FSimulationThreadSettings ThreadSettings;
+	double TimeAccumulator = 0.0;
+	bool AccelerationsStale = true;
+	bool StateChanged = false;
+
+	// Last settings handed to the thread, only touched by the game thread
+	FNBodySimulation SentSimulation;
+	FSimulationThreadSettings SentSettings;
+
+	void Advance(double DeltaTime);
+
+	void Publish();
+};
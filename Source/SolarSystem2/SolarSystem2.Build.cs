@@ -17,6 +17,6 @@ public class SolarSystem2 : ModuleRules
 			"ProceduralMeshComponent",
         });
 
-		PrivateDependencyModuleNames.AddRange(new string[] {  });
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json", "RenderCore" });
 	}
 }
@@ -1,6 +1,52 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "SolarSystem2.h"
+#include "SolarSystemStats.h"
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, SolarSystem2, "SolarSystem2" );
+
+DEFINE_STAT(STAT_SolarSystem_GravitationalForces);
+DEFINE_STAT(STAT_SolarSystem_Step);
+DEFINE_STAT(STAT_SolarSystem_SimulationThread);
+DEFINE_STAT(STAT_SolarSystem_SnapshotApply);
+DEFINE_STAT(STAT_SolarSystem_Kepler);
+DEFINE_STAT(STAT_SolarSystem_UpdatePositions);
+DEFINE_STAT(STAT_SolarSystem_SimulateOrbits);
+DEFINE_STAT(STAT_SolarSystem_SimulateOrbitBody);
+DEFINE_STAT(STAT_SolarSystem_OrbitPrediction);
+DEFINE_STAT(STAT_SolarSystem_Collisions);
+DEFINE_STAT(STAT_SolarSystem_TrajectoryRecord);
+DEFINE_STAT(STAT_SolarSystem_TrajectoryDecode);
+DEFINE_STAT(STAT_SolarSystem_Ephemeris);
+DEFINE_STAT(STAT_SolarSystem_EphemerisBake);
+DEFINE_STAT(STAT_SolarSystem_ScenarioLoad);
+DEFINE_STAT(STAT_SolarSystem_ScenarioSpawn);
+DEFINE_STAT(STAT_SolarSystem_Particles);
+DEFINE_STAT(STAT_SolarSystem_ParticleInstances);
+
+DEFINE_STAT(STAT_SolarSystem_GeneratePlanet);
+DEFINE_STAT(STAT_SolarSystem_Icosahedron);
+DEFINE_STAT(STAT_SolarSystem_Subdivide);
+DEFINE_STAT(STAT_SolarSystem_Noise);
+DEFINE_STAT(STAT_SolarSystem_Normals);
+DEFINE_STAT(STAT_SolarSystem_UVs);
+DEFINE_STAT(STAT_SolarSystem_MeshSection);
+DEFINE_STAT(STAT_SolarSystem_ChunkLOD);
+DEFINE_STAT(STAT_SolarSystem_ChunkBuild);
+DEFINE_STAT(STAT_SolarSystem_HeightBake);
+
+DEFINE_STAT(STAT_SolarSystem_Bodies);
+DEFINE_STAT(STAT_SolarSystem_NumParticles);
+DEFINE_STAT(STAT_SolarSystem_PairInteractions);
+DEFINE_STAT(STAT_SolarSystem_Contacts);
+DEFINE_STAT(STAT_SolarSystem_OrbitPoints);
+DEFINE_STAT(STAT_SolarSystem_PlanetVertices);
+DEFINE_STAT(STAT_SolarSystem_VisibleChunks);
+
+DEFINE_STAT(STAT_SolarSystem_TopologyMemory);
+DEFINE_STAT(STAT_SolarSystem_ChunkMemory);
+
+CSV_DEFINE_CATEGORY_MODULE(SOLARSYSTEM2_API, SolarSystem, true);
+
+UE_TRACE_CHANNEL_DEFINE(SolarSystemChannel);
@@ -0,0 +1,657 @@
+#include "SolarSystemBenchmarkCommandlet.h"
+#include "BodyCollision.h"
+#include "NBodySimulation.h"
+#include "OrbitPredictor.h"
+#include "ParticleBelt.h"
+#include "ProceduralPlanetGenerator.h"
+#include "PerlinNoise.h"
+#include "PlanetTopology.h"
+#include "SolarSystemScenario.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+namespace
+{
+	const float LegacyG = 0.0000000000674f;
+
+	void BuildRandomSystem(int32 NumBodies, int32 Seed, FNBodyState& OutState)
+	{
+		FRandomStream RandomStream(Seed);
+		OutState.Empty(NumBodies);
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			const FVector3d Position = FVector3d(RandomStream.VRand()) * RandomStream.FRandRange(1000.0f, 100000.0f);
+			const FVector3d Velocity = FVector3d(RandomStream.VRand()) * RandomStream.FRandRange(0.0f, 50.0f);
+			OutState.AddBody(Position, Velocity, FMath::Pow(10.0, RandomStream.FRandRange(10.0f, 15.0f)));
+		}
+	}
+
+	// Pair loop as it was written against the actors, float FVector math with two square roots per pair
+	void LegacyPairLoop(const TArray<FVector>& Positions, const TArray<float>& Masses, TArray<FVector>& OutAccelerations)
+	{
+		for (FVector& Acceleration : OutAccelerations) {
+			Acceleration = FVector::ZeroVector;
+		}
+
+		for (int32 i = 0; i < Positions.Num(); ++i) {
+			for (int32 j = i + 1; j < Positions.Num(); j++) {
+				FVector Direction = Positions[j] - Positions[i];
+				float Distance = Direction.Size();
+
+				if (Distance < 1.0f) {
+					continue;
+				}
+
+				FVector Fdir = Direction.GetSafeNormal();
+				float ForceMagnitude = LegacyG * (Masses[i] * Masses[j]) / (Distance * Distance);
+				FVector Force = Fdir * ForceMagnitude;
+
+				OutAccelerations[i] += Force / Masses[i];
+				OutAccelerations[j] -= Force / Masses[j];
+			}
+		}
+	}
+
+	// Pairwise energy is quadratic, beyond this the drift column is left out
+	const int32 MaxEnergyBodies = 20000;
+
+	double GetPeakMemoryMB()
+	{
+		return FPlatformMemory::GetStats().PeakUsedPhysical / (1024.0 * 1024.0);
+	}
+}
+
+USolarSystemBenchmarkCommandlet::USolarSystemBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 USolarSystemBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumBodies = 1024;
+	int32 Iterations = 20;
+	int32 DirectLimit = 10000;
+	int32 MaxSubdivisions = 7;
+	int32 NumParticles = 100000;
+	int32 NumScenarioBodies = 10000;
+	FString SizeList = TEXT("10,100,1000,10000,100000");
+	FString Tag;
+	FString CsvPath;
+	FString JsonPath;
+
+	FParse::Value(*Params, TEXT("Bodies="), NumBodies);
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	FParse::Value(*Params, TEXT("DirectLimit="), DirectLimit);
+	FParse::Value(*Params, TEXT("MaxSubdivisions="), MaxSubdivisions);
+	FParse::Value(*Params, TEXT("Particles="), NumParticles);
+	FParse::Value(*Params, TEXT("ScenarioBodies="), NumScenarioBodies);
+	FParse::Value(*Params, TEXT("Sizes="), SizeList);
+	FParse::Value(*Params, TEXT("Tag="), Tag);
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+	FParse::Value(*Params, TEXT("Json="), JsonPath);
+
+	NumBodies = FMath::Max(NumBodies, 2);
+	Iterations = FMath::Max(Iterations, 1);
+
+	TArray<FString> SizeTokens;
+	SizeList.ParseIntoArray(SizeTokens, TEXT(","));
+
+	TArray<int32> Sizes;
+	for (const FString& Token : SizeTokens) {
+		Sizes.Add(FMath::Max(FCString::Atoi(*Token), 2));
+	}
+
+	Results.Reset();
+
+	RunGravityKernelBenchmark(NumBodies, Iterations);
+	RunThreadScalingBenchmark(NumBodies, Iterations);
+	RunSimulationScalingBenchmark(Sizes, Iterations, DirectLimit);
+	RunPlanetMeshBenchmark(FMath::Max(MaxSubdivisions, 0), Iterations);
+	RunParticleBenchmark(FMath::Max(NumParticles, 1), Iterations);
+	RunCollisionBenchmark(Sizes, Iterations);
+	RunScenarioLoadBenchmark(FMath::Max(NumScenarioBodies, 2), Iterations);
+
+	if (CsvPath.IsEmpty() && JsonPath.IsEmpty()) {
+		const FString Directory = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+		CsvPath = Directory / TEXT("SolarSystemBenchmark.csv");
+		JsonPath = Directory / TEXT("SolarSystemBenchmark.json");
+	}
+
+	bool Written = true;
+	if (!CsvPath.IsEmpty()) {
+		Written &= WriteCsv(CsvPath, Tag);
+	}
+	if (!JsonPath.IsEmpty()) {
+		Written &= WriteJson(JsonPath, Tag);
+	}
+
+	return Written ? 0 : 1;
+}
+
+FSolarSystemBenchmarkResult& USolarSystemBenchmarkCommandlet::AddResult(const TCHAR* Suite, const FString& Case, int64 Size)
+{
+	FSolarSystemBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+	Result.Suite = Suite;
+	Result.Case = Case;
+	Result.Size = Size;
+	return Result;
+}
+
+void USolarSystemBenchmarkCommandlet::RunGravityKernelBenchmark(int32 NumBodies, int32 Iterations)
+{
+	FNBodySimulation Simulation;
+	Simulation.GravitationalConstant = LegacyG;
+	BuildRandomSystem(NumBodies, 1337, Simulation.State);
+
+	TArray<FVector> LegacyPositions;
+	TArray<float> LegacyMasses;
+	TArray<FVector> LegacyAccelerations;
+	for (int32 i = 0; i < NumBodies; ++i) {
+		LegacyPositions.Add(Simulation.State.Positions[i]);
+		LegacyMasses.Add((float)Simulation.State.Masses[i]);
+	}
+	LegacyAccelerations.SetNum(NumBodies);
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+		LegacyPairLoop(LegacyPositions, LegacyMasses, LegacyAccelerations);
+	}
+	const double LegacySeconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+	// Single threaded so the kernel itself is measured
+	Simulation.MaxThreads = 1;
+	Simulation.UseSimdKernel = false;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+		Simulation.ComputeAccelerations();
+	}
+	const double ScalarSeconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+	const TArray<FVector3d> Reference = Simulation.State.Accelerations;
+
+	Simulation.UseSimdKernel = true;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+		Simulation.ComputeAccelerations();
+	}
+	const double SimdSeconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+	double MaxRelativeError = 0.0;
+	for (int32 i = 0; i < NumBodies; ++i) {
+		const double ReferenceSize = Reference[i].Size();
+		if (ReferenceSize > 0.0) {
+			MaxRelativeError = FMath::Max(MaxRelativeError, FVector3d::Dist(Reference[i], Simulation.State.Accelerations[i]) / ReferenceSize);
+		}
+	}
+
+	// Every evaluation resolves all N * (N - 1) ordered interactions, whichever way the loop is written
+	const double Interactions = (double)NumBodies * (NumBodies - 1);
+
+	UE_LOG(LogTemp, Display, TEXT("Gravity kernel, N=%d, %d iterations"), NumBodies, Iterations);
+	UE_LOG(LogTemp, Display, TEXT("  Legacy pair loop : %8.3f ms/eval  %6.2f ns/interaction"), LegacySeconds * 1000.0, LegacySeconds * 1.0e9 / Interactions);
+	UE_LOG(LogTemp, Display, TEXT("  Scalar direct    : %8.3f ms/eval  %6.2f ns/interaction"), ScalarSeconds * 1000.0, ScalarSeconds * 1.0e9 / Interactions);
+	UE_LOG(LogTemp, Display, TEXT("  SIMD kernel      : %8.3f ms/eval  %6.2f ns/interaction"), SimdSeconds * 1000.0, SimdSeconds * 1.0e9 / Interactions);
+	UE_LOG(LogTemp, Display, TEXT("  Speedup vs legacy: %.2fx, max relative error vs scalar: %.3e"), LegacySeconds / FMath::Max(SimdSeconds, 1.0e-12), MaxRelativeError);
+
+	const TCHAR* CaseNames[] = { TEXT("Legacy"), TEXT("Scalar"), TEXT("Simd") };
+	const double CaseSeconds[] = { LegacySeconds, ScalarSeconds, SimdSeconds };
+
+	for (int32 Case = 0; Case < UE_ARRAY_COUNT(CaseNames); ++Case) {
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("GravityKernel"), CaseNames[Case], NumBodies);
+		Result.Add(TEXT("ForceMs"), CaseSeconds[Case] * 1000.0);
+		Result.Add(TEXT("NsPerInteraction"), CaseSeconds[Case] * 1.0e9 / Interactions);
+		if (Case == 2) {
+			Result.Add(TEXT("MaxRelativeError"), MaxRelativeError);
+		}
+	}
+}
+
+void USolarSystemBenchmarkCommandlet::RunThreadScalingBenchmark(int32 NumBodies, int32 Iterations)
+{
+	FNBodySimulation Simulation;
+	Simulation.GravitationalConstant = LegacyG;
+	Simulation.ParallelThreshold = 2;
+	BuildRandomSystem(NumBodies, 1337, Simulation.State);
+
+	const int32 MaxWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	double SingleThreadSeconds = 0.0;
+
+	UE_LOG(LogTemp, Display, TEXT("Force pass thread scaling, N=%d, up to %d threads"), NumBodies, MaxWorkers);
+
+	for (int32 Threads = 1; ; Threads = FMath::Min(Threads * 2, MaxWorkers)) {
+		Simulation.MaxThreads = Threads;
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+			Simulation.ComputeAccelerations();
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+		if (Threads == 1) {
+			SingleThreadSeconds = Seconds;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("  %2d threads : %8.3f ms/eval  %.2fx"), Threads, Seconds * 1000.0, SingleThreadSeconds / FMath::Max(Seconds, 1.0e-12));
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("ThreadScaling"), FString::Printf(TEXT("%dThreads"), Threads), NumBodies);
+		Result.Add(TEXT("Threads"), Threads);
+		Result.Add(TEXT("ForceMs"), Seconds * 1000.0);
+		Result.Add(TEXT("Speedup"), SingleThreadSeconds / FMath::Max(Seconds, 1.0e-12));
+
+		if (Threads == MaxWorkers) {
+			break;
+		}
+	}
+}
+
+void USolarSystemBenchmarkCommandlet::RunSimulationScalingBenchmark(const TArray<int32>& Sizes, int32 Iterations, int32 DirectLimit)
+{
+	const double StepSize = 0.1;
+
+	UE_LOG(LogTemp, Display, TEXT("Simulation scaling, direct sum up to N=%d, Barnes-Hut beyond"), DirectLimit);
+
+	for (int32 NumBodies : Sizes) {
+		FNBodySimulation Simulation;
+		Simulation.GravitationalConstant = LegacyG;
+		Simulation.Softening = 10.0;
+		Simulation.Solver = NumBodies <= DirectLimit ? EGravitySolver::Direct : EGravitySolver::BarnesHut;
+		BuildRandomSystem(NumBodies, 1337, Simulation.State);
+
+		// Keep the large systems to a handful of steps so the sweep finishes in minutes
+		const int32 Steps = FMath::Clamp(Iterations * 1024 / NumBodies, 1, Iterations);
+
+		double StartTime = FPlatformTime::Seconds();
+		Simulation.ComputeAccelerations();
+		const double ForceSeconds = FPlatformTime::Seconds() - StartTime;
+
+		const bool MeasureEnergy = NumBodies <= MaxEnergyBodies;
+		const double InitialEnergy = MeasureEnergy ? Simulation.ComputeTotalEnergy(Simulation.State) : 0.0;
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Steps; ++Step) {
+			Simulation.Step(StepSize);
+		}
+		const double StepSeconds = (FPlatformTime::Seconds() - StartTime) / Steps;
+
+		const double FinalEnergy = MeasureEnergy ? Simulation.ComputeTotalEnergy(Simulation.State) : 0.0;
+		const double EnergyDrift = MeasureEnergy ? FMath::Abs((FinalEnergy - InitialEnergy) / FMath::Max(FMath::Abs(InitialEnergy), UE_DOUBLE_SMALL_NUMBER)) : 0.0;
+
+		// Same sampling as the manager's shared prediction, one step per sample
+		FOrbitPredictor Predictor;
+		Predictor.Capacity = FMath::Clamp(64 * 1024 / NumBodies, 2, 64);
+		Predictor.SampleInterval = StepSize;
+		Predictor.MaxStepSize = StepSize;
+
+		FNBodySimulation PredictionSimulation;
+		PredictionSimulation.CopySettings(Simulation);
+
+		StartTime = FPlatformTime::Seconds();
+		Predictor.Update(Simulation.State, PredictionSimulation, Predictor.Capacity);
+		const double PredictionSeconds = FPlatformTime::Seconds() - StartTime;
+
+		const TCHAR* SolverName = Simulation.Solver == EGravitySolver::Direct ? TEXT("Direct") : TEXT("BarnesHut");
+
+		UE_LOG(LogTemp, Display, TEXT("  N=%6d %-9s : %10.1f steps/s  force %8.3f ms  prediction %8.3f ms (%d samples)  drift %.3e"),
+			NumBodies, SolverName, 1.0 / FMath::Max(StepSeconds, 1.0e-12), ForceSeconds * 1000.0, PredictionSeconds * 1000.0, Predictor.NumSamples(), EnergyDrift);
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("Simulation"), SolverName, NumBodies);
+		Result.Add(TEXT("StepsPerSecond"), 1.0 / FMath::Max(StepSeconds, 1.0e-12));
+		Result.Add(TEXT("ForceMs"), ForceSeconds * 1000.0);
+		if (Simulation.Solver == EGravitySolver::Direct) {
+			Result.Add(TEXT("NsPerInteraction"), ForceSeconds * 1.0e9 / ((double)NumBodies * (NumBodies - 1)));
+		}
+		Result.Add(TEXT("PredictionMs"), PredictionSeconds * 1000.0);
+		Result.Add(TEXT("PredictionSamples"), Predictor.NumSamples());
+		if (MeasureEnergy) {
+			Result.Add(TEXT("EnergyDrift"), EnergyDrift);
+		}
+		Result.Add(TEXT("PeakMemoryMB"), GetPeakMemoryMB());
+	}
+}
+
+void USolarSystemBenchmarkCommandlet::RunPlanetMeshBenchmark(int32 MaxSubdivisions, int32 Iterations)
+{
+	UProceduralPlanetGenerator* Generator = NewObject<UProceduralPlanetGenerator>(GetTransientPackage());
+
+	UE_LOG(LogTemp, Display, TEXT("Planet mesh generation, subdivisions 0..%d"), MaxSubdivisions);
+
+	for (int32 Level = 0; Level <= MaxSubdivisions; ++Level) {
+		Generator->Subdivisions = Level;
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+			Generator->GeneratePlanet();
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+		const FProcMeshSection* Section = Generator->GetProcMeshSection(0);
+		const int32 NumVertices = Section ? Section->ProcVertexBuffer.Num() : 0;
+		const int32 NumTriangles = Section ? Section->ProcIndexBuffer.Num() / 3 : 0;
+
+		// Terrain displacement alone, one sample per call against the batched path
+		const FPlanetMeshSettings Settings = Generator->GetMeshSettings();
+		const FPerlinNoise Noise(Settings.NoiseSeed);
+		const TSharedPtr<const FPlanetTopology, ESPMode::ThreadSafe> Topology = FPlanetTopologyCache::Get().FindOrBuild(Level);
+
+		TArray<float> Values;
+		Values.SetNumUninitialized(Topology->UnitPositions.Num());
+
+		double NoiseStartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+			for (int32 i = 0; i < Values.Num(); ++i) {
+				const FVector Point = Topology->UnitPositions[i] * Settings.NoiseScale;
+				Values[i] = Noise.FractalNoise3D(Point.X, Point.Y, Point.Z, Settings.NoiseOctaves, Settings.NoisePersistence, Settings.NoiseLacunarity);
+			}
+		}
+		const double ScalarNoiseSeconds = (FPlatformTime::Seconds() - NoiseStartTime) / Iterations;
+
+		NoiseStartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+			Noise.FractalNoise3DBatch(Topology->UnitPositions, Values, Settings.NoiseScale, Settings.NoiseOctaves, Settings.NoisePersistence, Settings.NoiseLacunarity);
+		}
+		const double BatchNoiseSeconds = (FPlatformTime::Seconds() - NoiseStartTime) / Iterations;
+
+		UE_LOG(LogTemp, Display, TEXT("  Level %d : %8.3f ms  %7d vertices  %7d triangles  noise %7.3f ms scalar, %7.3f ms batch"),
+			Level, Seconds * 1000.0, NumVertices, NumTriangles, ScalarNoiseSeconds * 1000.0, BatchNoiseSeconds * 1000.0);
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("PlanetMesh"), FString::Printf(TEXT("Level%d"), Level), Level);
+		Result.Add(TEXT("MeshMs"), Seconds * 1000.0);
+		Result.Add(TEXT("Vertices"), NumVertices);
+		Result.Add(TEXT("Triangles"), NumTriangles);
+		Result.Add(TEXT("ScalarNoiseMs"), ScalarNoiseSeconds * 1000.0);
+		Result.Add(TEXT("BatchNoiseMs"), BatchNoiseSeconds * 1000.0);
+		Result.Add(TEXT("PeakMemoryMB"), GetPeakMemoryMB());
+	}
+
+	Generator->MarkAsGarbage();
+}
+
+void USolarSystemBenchmarkCommandlet::RunParticleBenchmark(int32 NumParticles, int32 Iterations)
+{
+	const double StepSize = 0.1;
+
+	UE_LOG(LogTemp, Display, TEXT("Test particles, %d particles"), NumParticles);
+
+	for (int32 NumMassive : { 1, 10, 100 }) {
+		FNBodySimulation Simulation;
+		Simulation.GravitationalConstant = LegacyG;
+		BuildRandomSystem(NumMassive, 1337, Simulation.State);
+
+		FTestParticleSimulation Particles;
+		Particles.GravitationalConstant = LegacyG;
+		Particles.Empty(NumParticles);
+
+		FRandomStream RandomStream(7);
+		for (int32 i = 0; i < NumParticles; ++i) {
+			Particles.AddParticle(FVector3d(RandomStream.VRand()) * RandomStream.FRandRange(1000.0f, 100000.0f), FVector3d(RandomStream.VRand()) * RandomStream.FRandRange(0.0f, 50.0f));
+		}
+
+		Particles.ComputeAccelerations(Simulation.State);
+
+		// Massive bodies stay put, only the particle pass is timed
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Iterations; ++Step) {
+			Particles.Step(Simulation.State, StepSize);
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+		const double Interactions = (double)NumParticles * NumMassive;
+
+		UE_LOG(LogTemp, Display, TEXT("  %3d massive : %8.3f ms/step  %6.2f ns/interaction"), NumMassive, Seconds * 1000.0, Seconds * 1.0e9 / Interactions);
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("Particles"), FString::Printf(TEXT("Massive%d"), NumMassive), NumParticles);
+		Result.Add(TEXT("StepMs"), Seconds * 1000.0);
+		Result.Add(TEXT("NsPerInteraction"), Seconds * 1.0e9 / Interactions);
+		Result.Add(TEXT("PeakMemoryMB"), GetPeakMemoryMB());
+	}
+}
+
+void USolarSystemBenchmarkCommandlet::RunCollisionBenchmark(const TArray<int32>& Sizes, int32 Iterations)
+{
+	const double StepSize = 0.1;
+
+	UE_LOG(LogTemp, Display, TEXT("Collision broadphase"));
+
+	for (int32 NumBodies : Sizes) {
+		FNBodyState State;
+		BuildRandomSystem(NumBodies, 1337, State);
+
+		TArray<double> Radii;
+		TArray<FVector3d> Ends;
+		FRandomStream RandomStream(7);
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			Radii.Add(RandomStream.FRandRange(10.0f, 200.0f));
+			Ends.Add(State.Positions[i] + State.Velocities[i] * StepSize);
+		}
+
+		FBodySpatialHash Hash;
+		TArray<FBodyContact> Contacts;
+		int64 Candidates = 0;
+
+		// Same work as one manager step: rebuild, then sweep every candidate pair
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Iterations; ++Step) {
+			Hash.Build(State.Positions, Ends, Radii);
+			Hash.FindContacts(State.Positions, Ends, Radii, Contacts);
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+		Hash.ForEachCandidatePair([&Candidates](int32, int32) { Candidates++; });
+
+		UE_LOG(LogTemp, Display, TEXT("  N=%6d : %8.3f ms/step  %7.1f ns/body  %lld candidate pairs  %d contacts"),
+			NumBodies, Seconds * 1000.0, Seconds * 1.0e9 / NumBodies, Candidates, Contacts.Num());
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("Collisions"), TEXT("SpatialHash"), NumBodies);
+		Result.Add(TEXT("StepMs"), Seconds * 1000.0);
+		Result.Add(TEXT("NsPerBody"), Seconds * 1.0e9 / NumBodies);
+		Result.Add(TEXT("CandidatePairs"), Candidates);
+		Result.Add(TEXT("Contacts"), Contacts.Num());
+		Result.Add(TEXT("PeakMemoryMB"), GetPeakMemoryMB());
+	}
+}
+
+void USolarSystemBenchmarkCommandlet::RunScenarioLoadBenchmark(int32 NumBodies, int32 Iterations)
+{
+	// Budget the manager has to hand a system of this size to the first frame
+	const double TargetMs = 1000.0;
+
+	UE_LOG(LogTemp, Display, TEXT("Scenario load"));
+
+	// One star and every other body on an orbit around it, so Resolve turns elements into state vectors for all of them
+	FSolarSystemScenario Source;
+	FRandomStream RandomStream(1337);
+	Source.Bodies.SetNum(NumBodies);
+
+	Source.Bodies[0].Name = TEXT("Star");
+	Source.Bodies[0].Mass = 1.0e18;
+	Source.Bodies[0].Radius = 500.0f;
+
+	for (int32 i = 1; i < NumBodies; ++i) {
+		FScenarioBody& Body = Source.Bodies[i];
+		Body.Name = FString::Printf(TEXT("Body%d"), i);
+		Body.Mass = FMath::Pow(10.0, RandomStream.FRandRange(8.0f, 12.0f));
+		Body.Radius = RandomStream.FRandRange(1.0f, 20.0f);
+		Body.Parent = TEXT("Star");
+		Body.SemiMajorAxis = RandomStream.FRandRange(5000.0f, 500000.0f);
+		Body.Eccentricity = RandomStream.FRandRange(0.0f, 0.2f);
+		Body.Inclination = RandomStream.FRandRange(0.0f, 10.0f);
+		Body.AscendingNode = RandomStream.FRandRange(0.0f, 360.0f);
+		Body.ArgumentOfPeriapsis = RandomStream.FRandRange(0.0f, 360.0f);
+		Body.MeanAnomaly = RandomStream.FRandRange(0.0f, 360.0f);
+		Body.Visual = i % 10 == 0;
+	}
+
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+	const FString Paths[] = { Directory / TEXT("ScenarioLoad.scenario"), Directory / TEXT("ScenarioLoad.json") };
+
+	for (const FString& Path : Paths) {
+		if (!Source.SaveToFile(Path)) {
+			UE_LOG(LogTemp, Warning, TEXT("  Could not write %s, skipped"), *Path);
+			continue;
+		}
+
+		const TCHAR* Format = FSolarSystemScenario::IsTextFile(Path) ? TEXT("Json") : TEXT("Binary");
+		double LoadSeconds = 0.0;
+		double ResolveSeconds = 0.0;
+		double FillSeconds = 0.0;
+		bool Loaded = true;
+
+		for (int32 Iteration = 0; Iteration < Iterations && Loaded; ++Iteration) {
+			FSolarSystemScenario Scenario;
+			FString Error;
+
+			double StartTime = FPlatformTime::Seconds();
+			Loaded = Scenario.LoadFromFile(Path, Error);
+			LoadSeconds += FPlatformTime::Seconds() - StartTime;
+
+			StartTime = FPlatformTime::Seconds();
+			Loaded = Loaded && Scenario.Resolve(LegacyG, Error);
+			ResolveSeconds += FPlatformTime::Seconds() - StartTime;
+
+			if (!Loaded) {
+				UE_LOG(LogTemp, Warning, TEXT("  Could not load %s: %s"), *Path, *Error);
+				break;
+			}
+
+			// The game thread part of ApplyScenario without the world: the state moved in and the per body arrays filled
+			StartTime = FPlatformTime::Seconds();
+			FNBodySimulation Simulation;
+			Simulation.State = MoveTemp(Scenario.State);
+
+			TArray<float> Radii;
+			TArray<FString> Names;
+			TArray<EOrbitPropagation> Modes;
+			Radii.SetNumUninitialized(NumBodies);
+			Names.SetNum(NumBodies);
+			Modes.SetNum(NumBodies);
+
+			for (int32 i = 0; i < NumBodies; ++i) {
+				Radii[i] = Scenario.Bodies[i].Radius;
+				Names[i] = Scenario.Bodies[i].Name;
+				Modes[i] = Scenario.Bodies[i].PropagationMode;
+			}
+			FillSeconds += FPlatformTime::Seconds() - StartTime;
+		}
+
+		if (!Loaded) {
+			continue;
+		}
+
+		LoadSeconds /= Iterations;
+		ResolveSeconds /= Iterations;
+		FillSeconds /= Iterations;
+		const double TotalMs = (LoadSeconds + ResolveSeconds + FillSeconds) * 1000.0;
+		const int64 FileBytes = IFileManager::Get().FileSize(*Path);
+
+		UE_LOG(LogTemp, Display, TEXT("  %-6s N=%6d : load %8.3f ms  resolve %8.3f ms  fill %8.3f ms  total %8.3f ms (%s the %.0f ms target)  %lld bytes"),
+			Format, NumBodies, LoadSeconds * 1000.0, ResolveSeconds * 1000.0, FillSeconds * 1000.0, TotalMs,
+			TotalMs <= TargetMs ? TEXT("within") : TEXT("over"), TargetMs, FileBytes);
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("Scenario"), Format, NumBodies);
+		Result.Add(TEXT("LoadMs"), LoadSeconds * 1000.0);
+		Result.Add(TEXT("ResolveMs"), ResolveSeconds * 1000.0);
+		Result.Add(TEXT("FillMs"), FillSeconds * 1000.0);
+		Result.Add(TEXT("TotalMs"), TotalMs);
+		Result.Add(TEXT("FileBytes"), FileBytes);
+		Result.Add(TEXT("PeakMemoryMB"), GetPeakMemoryMB());
+	}
+
+	// What OnBodySetChanged used to pay before the first frame, now left to the first substep
+	FNBodySimulation Simulation;
+	FString Error;
+	FSolarSystemScenario Scenario = Source;
+
+	if (Scenario.Resolve(LegacyG, Error)) {
+		Simulation.GravitationalConstant = LegacyG;
+		Simulation.State = MoveTemp(Scenario.State);
+
+		const double StartTime = FPlatformTime::Seconds();
+		Simulation.ComputeAccelerations();
+		const double ForceMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		UE_LOG(LogTemp, Display, TEXT("  Deferred first force pass N=%6d : %8.3f ms"), NumBodies, ForceMs);
+
+		FSolarSystemBenchmarkResult& Result = AddResult(TEXT("Scenario"), TEXT("FirstForcePass"), NumBodies);
+		Result.Add(TEXT("ForceMs"), ForceMs);
+	}
+}
+
+bool USolarSystemBenchmarkCommandlet::WriteCsv(const FString& Path, const FString& Tag) const
+{
+	TArray<FString> Columns;
+	for (const FSolarSystemBenchmarkResult& Result : Results) {
+		for (const TPair<FString, double>& Metric : Result.Metrics) {
+			Columns.AddUnique(Metric.Key);
+		}
+	}
+
+	FString Csv = TEXT("Tag,Platform,Suite,Case,Size");
+	for (const FString& Column : Columns) {
+		Csv += TEXT(",") + Column;
+	}
+	Csv += LINE_TERMINATOR;
+
+	const FString Platform = FPlatformMisc::GetCPUBrand().TrimStartAndEnd().Replace(TEXT(","), TEXT(" "));
+
+	for (const FSolarSystemBenchmarkResult& Result : Results) {
+		Csv += FString::Printf(TEXT("%s,%s,%s,%s,%lld"), *Tag, *Platform, *Result.Suite, *Result.Case, Result.Size);
+
+		// Missing metrics stay empty so every row lines up with the header
+		for (const FString& Column : Columns) {
+			const TPair<FString, double>* Metric = Result.Metrics.FindByPredicate([&Column](const TPair<FString, double>& Pair) { return Pair.Key == Column; });
+			Csv += Metric ? FString::Printf(TEXT(",%.6g"), Metric->Value) : FString(TEXT(","));
+		}
+		Csv += LINE_TERMINATOR;
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *Path)) {
+		UE_LOG(LogTemp, Error, TEXT("Could not write benchmark report %s"), *Path);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %s"), *Path);
+	return true;
+}
+
+bool USolarSystemBenchmarkCommandlet::WriteJson(const FString& Path, const FString& Tag) const
+{
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Tag"), Tag);
+	Root->SetStringField(TEXT("Platform"), FPlatformMisc::GetCPUBrand().TrimStartAndEnd());
+	Root->SetNumberField(TEXT("Cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+
+	TArray<TSharedPtr<FJsonValue>> Entries;
+	for (const FSolarSystemBenchmarkResult& Result : Results) {
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetStringField(TEXT("Suite"), Result.Suite);
+		Entry->SetStringField(TEXT("Case"), Result.Case);
+		Entry->SetNumberField(TEXT("Size"), (double)Result.Size);
+
+		for (const TPair<FString, double>& Metric : Result.Metrics) {
+			Entry->SetNumberField(Metric.Key, Metric.Value);
+		}
+
+		Entries.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+	Root->SetArrayField(TEXT("Results"), Entries);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	if (!FFileHelper::SaveStringToFile(Json, *Path)) {
+		UE_LOG(LogTemp, Error, TEXT("Could not write benchmark report %s"), *Path);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %s"), *Path);
+	return true;
+}
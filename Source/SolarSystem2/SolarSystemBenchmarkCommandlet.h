@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SolarSystemBenchmarkCommandlet.generated.h"
+
+// One measured case, Metrics keep their insertion order so CSV columns stay stable between runs
+struct FSolarSystemBenchmarkResult
+{
+	FString Suite;
+	FString Case;
+	int64 Size = 0;
+	TArray<TPair<FString, double>> Metrics;
+
+	void Add(const TCHAR* Name, double Value) { Metrics.Emplace(Name, Value); }
+};
+
+// Headless benchmarks for the simulation and generation hot paths.
+// UnrealEditor-Cmd SolarSystem2.uproject -run=SolarSystemBenchmark -nullrhi [-Bodies=1024] [-Iterations=20]
+//   [-Sizes=10,100,1000,10000,100000] [-DirectLimit=10000] [-MaxSubdivisions=7] [-Particles=100000] [-ScenarioBodies=10000]
+//   [-Tag=<commit>] [-Csv=<path>] [-Json=<path>]
+// Without -Csv or -Json both reports are written to Saved/Benchmarks.
+UCLASS()
+class SOLARSYSTEM2_API USolarSystemBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	USolarSystemBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	TArray<FSolarSystemBenchmarkResult> Results;
+
+	void RunGravityKernelBenchmark(int32 NumBodies, int32 Iterations);
+	void RunThreadScalingBenchmark(int32 NumBodies, int32 Iterations);
+	void RunSimulationScalingBenchmark(const TArray<int32>& Sizes, int32 Iterations, int32 DirectLimit);
+	void RunPlanetMeshBenchmark(int32 MaxSubdivisions, int32 Iterations);
+	void RunParticleBenchmark(int32 NumParticles, int32 Iterations);
+	void RunCollisionBenchmark(const TArray<int32>& Sizes, int32 Iterations);
+	void RunScenarioLoadBenchmark(int32 NumBodies, int32 Iterations);
+
+	FSolarSystemBenchmarkResult& AddResult(const TCHAR* Suite, const FString& Case, int64 Size);
+
+	bool WriteCsv(const FString& Path, const FString& Tag) const;
+	bool WriteJson(const FString& Path, const FString& Tag) const;
+};
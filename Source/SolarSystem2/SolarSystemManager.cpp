@@ -1,23 +1,42 @@
 #include "SolarSystemManager.h"
+#include "SolarSystemStats.h"
 #include "DrawDebugHelpers.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Misc/Paths.h"
+#include "Hash/CityHash.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 #include <Kismet/GameplayStatics.h>
 
 ASolarySystemManager::ASolarySystemManager()
 {
 	PrimaryActorTick.bCanEverTick = true;
+
+	// Bodies on rails are placed on their conics after every drift of the integrator
+	Simulation.PlaceKinematicBodies = [this](FNBodyState& State) { ApplyKeplerOrbits(State); };
 }
 
 void ASolarySystemManager::BeginPlay()
 {
 	Super::BeginPlay();
 
+	// A scenario brings its own bodies, the level is not scanned at all
+	if (!ScenarioFile.IsEmpty()) {
+		LoadScenario(ScenarioFile);
+		return;
+	}
+
 	TArray<AActor*> FoundBodies;
 	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ACelestialBody::StaticClass(), FoundBodies);
 
 
 	for (AActor* Actor : FoundBodies) {
 		if (ACelestialBody* Body = Cast<ACelestialBody>(Actor)) {
-			CelestialBodies.Add(Body);
+			Body->InitializePhysicalState();
+			CelestialBodies.AddUnique(Body);
 			UE_LOG(LogTemp, Warning, TEXT("Found Body: %s | Pos: %s | Mass: %.2e | Velocity: %s | VelMag: %.4f"),
 				*Body->BodyName,
 				*Body->GetActorLocation().ToString(),
@@ -51,272 +70,1790 @@ void ASolarySystemManager::BeginPlay()
 			}
 		}
 	}
+
+	BuildSimulationState();
+	StartState = Simulation.State;
+	StartBodyNames = BodyNames;
+
+	if (UseEphemeris) {
+		LoadEphemeris();
+	}
+
+	SpawnParticleBelts();
+	StartSimulationThread();
 }
 
-void ASolarySystemManager::Tick(float DeltaTime)
+void ASolarySystemManager::BuildSimulationState()
 {
-	Super::Tick(DeltaTime);
-
-	float ScaledDeltaTime = DeltaTime * TimeScale;
+	CelestialBodies.Remove(nullptr);
 
-	UpdateGravitationalForces(ScaledDeltaTime);
+	ApplySimulationSettings();
+	Simulation.State.Empty(CelestialBodies.Num());
+	BodyRadii.Reset(CelestialBodies.Num());
+	BodyNames.Reset(CelestialBodies.Num());
+	BodyPropagationModes.Reset(CelestialBodies.Num());
 
 	for (ACelestialBody* Body : CelestialBodies) {
-		if (Body) {
-			Body->UpdatePosition(ScaledDeltaTime);
+		Body->InitializePhysicalState();
+		Simulation.State.AddBody(Body->GetActorLocation(), Body->CurrentVelocity, Body->Mass);
+		BodyRadii.Add(FMath::Max(Body->Radius * CollisionRadiusScale, 0.0f));
+		BodyNames.Add(Body->BodyName);
+		BodyPropagationModes.Add(Body->PropagationMode);
+	}
+
+	OnBodySetChanged();
+	TimeAccumulator = 0.0;
+}
+
+void ASolarySystemManager::OnBodySetChanged()
+{
+	BodyHashStale = true;
+
+	// Indices moved, every body is integrated until the conics are fitted again
+	Simulation.SetKinematicBodies({});
+	InitializeKeplerOrbits();
+
+	// The first substep evaluates the forces, a load or a merge does not pay for an O(N^2) pass of its own
+	AccelerationsStale = true;
+
+	PreviousPositions = Simulation.State.Positions;
+
+	// A merge lands here in the middle of a step, with the bodies already at its end. The particles are still at its
+	// start, so their cached accelerations stay until the step has moved them or the next one begins.
+	if (Particles.Num() > 0) {
+		ParticleAccelerationsStale = true;
+		Particles.GetPositions(PreviousParticlePositions);
+	}
+
+	OrbitRequests.Reset();
+	OrbitPredictionDirty = true;
+}
+
+void ASolarySystemManager::RemoveBody(int32 BodyIndex)
+{
+	FNBodyState& State = Simulation.State;
+
+	State.Positions.RemoveAt(BodyIndex);
+	State.Velocities.RemoveAt(BodyIndex);
+	State.Accelerations.RemoveAt(BodyIndex);
+	State.Masses.RemoveAt(BodyIndex);
+	BodyRadii.RemoveAt(BodyIndex);
+	BodyNames.RemoveAt(BodyIndex);
+	BodyPropagationModes.RemoveAt(BodyIndex);
+
+	if (ACelestialBody* Body = CelestialBodies[BodyIndex]) {
+		ScenarioActors.Remove(Body);
+		Body->Destroy();
+	}
+	CelestialBodies.RemoveAt(BodyIndex);
+
+	// Queued actors behind the removed body move down with it
+	for (int32 i = PendingSpawnIndices.Num() - 1; i >= 0; --i) {
+		if (PendingSpawnIndices[i] == BodyIndex) {
+			PendingSpawnIndices.RemoveAt(i);
+			PendingSpawnBodies.RemoveAt(i);
+		} else if (PendingSpawnIndices[i] > BodyIndex) {
+			PendingSpawnIndices[i]--;
 		}
 	}
 
-	if (drawOrbits) {
-		SimulateOrbits();
+	if (OrbitPaths.IsValidIndex(BodyIndex)) {
+		if (UOrbitPathComponent* Path = OrbitPaths[BodyIndex]) {
+			Path->DestroyComponent();
+		}
+		OrbitPaths.RemoveAt(BodyIndex);
+	}
+}
+
+bool ASolarySystemManager::AddBody(ACelestialBody* Body)
+{
+	if (!Body || CelestialBodies.Contains(Body)) {
+		return false;
+	}
+
+	Body->InitializePhysicalState();
+
+	const FVector3d Position = Body->GetActorLocation();
+	const FVector3d Velocity = Body->CurrentVelocity;
+
+	CelestialBodies.Add(Body);
+	Simulation.State.AddBody(Position, Velocity, Body->Mass);
+	BodyRadii.Add(FMath::Max(Body->Radius * CollisionRadiusScale, 0.0f));
+	BodyNames.Add(Body->BodyName);
+	BodyPropagationModes.Add(Body->PropagationMode);
+
+	if (SimulationThread.IsRunning()) {
+		SimulationThread.AddBody(Position, Velocity, Body->Mass);
+	}
+
+	// The table has no entry for the new body
+	if (Ephemeris.IsValid()) {
+		UE_LOG(LogTemp, Log, TEXT("%s is not in the ephemeris, integrating from here"), *Body->BodyName);
+		Ephemeris.Reset();
+	}
+
+	OnBodySetChanged();
+	return true;
+}
+
+bool ASolarySystemManager::SetBodyVelocity(ACelestialBody* Body, FVector Velocity)
+{
+	const int32 BodyIndex = Body ? CelestialBodies.IndexOfByKey(Body) : INDEX_NONE;
+	if (BodyIndex == INDEX_NONE || BodyIndex >= Simulation.State.Num()) {
+		return false;
+	}
+
+	Simulation.State.Velocities[BodyIndex] = Velocity;
+	Body->CurrentVelocity = Velocity;
+
+	if (SimulationThread.IsRunning()) {
+		SimulationThread.SetBodyVelocity(BodyIndex, Velocity);
+	}
+
+	// Its conic no longer holds, UpdatePropagationModes fits a new one if its mode allows
+	LeaveRails(BodyIndex);
+	OrbitPredictionDirty = true;
+	return true;
+}
+
+bool ASolarySystemManager::SetBodyMass(ACelestialBody* Body, float Mass)
+{
+	const int32 BodyIndex = Body ? CelestialBodies.IndexOfByKey(Body) : INDEX_NONE;
+	if (BodyIndex == INDEX_NONE || BodyIndex >= Simulation.State.Num()) {
+		return false;
+	}
+
+	Simulation.State.Masses[BodyIndex] = FMath::Max(Mass, 0.0f);
+	Body->Mass = FMath::Max(Mass, 0.0f);
+
+	if (SimulationThread.IsRunning()) {
+		SimulationThread.SetBodyMass(BodyIndex, Simulation.State.Masses[BodyIndex]);
+	}
+
+	// Every conic around it depends on its mass
+	AccelerationsStale = true;
+	InitializeKeplerOrbits();
+	OrbitPredictionDirty = true;
+	return true;
+}
+
+void ASolarySystemManager::StartSimulationThread()
+{
+	SimulationThread.Shutdown();
+
+	if (!UseSimulationThread) {
+		return;
+	}
+
+	// These rewrite or read the state between two steps on the game thread
+	if (Ephemeris.IsValid() || Particles.Num() > 0 || CollisionResponse != EBodyCollisionResponse::None) {
+		UE_LOG(LogTemp, Warning, TEXT("The simulation thread does not run ephemerides, particle belts or collisions, stepping in Tick instead"));
+		return;
+	}
+
+	ApplySimulationSettings();
+	SimulationThread.Start(Simulation, Simulation.State, GetSimulationThreadSettings());
+
+	if (!SimulationThread.IsRunning()) {
+		UE_LOG(LogTemp, Warning, TEXT("Could not start the simulation thread, stepping in Tick instead"));
+		return;
+	}
+
+	OnRails.Init(false, Simulation.State.Num());
+	Simulation.SetKinematicBodies({});
+	PreviousPositions = Simulation.State.Positions;
+	PreviousSnapshotTime = FPlatformTime::Seconds();
+	LatestSnapshotTime = PreviousSnapshotTime;
+	TimeAccumulator = 0.0;
+	OrbitPredictionDirty = true;
+}
+
+FSimulationThreadSettings ASolarySystemManager::GetSimulationThreadSettings() const
+{
+	FSimulationThreadSettings Settings;
+	Settings.TimeScale = TimeScale;
+	Settings.StepSize = FMath::Max((double)FixedTimeStep, 0.0001);
+	Settings.MaxSubsteps = GetMaxSubsteps();
+	Settings.UpdateRate = FMath::Max(SimulationThreadRate, 1.0f);
+	return Settings;
+}
+
+void ASolarySystemManager::ReceiveSnapshot()
+{
+	const FSimulationSnapshot* Snapshot = SimulationThread.ReceiveSnapshot();
+	if (!Snapshot) {
+		return;
+	}
+
+	SOLARSYSTEM_SCOPE(SnapshotApply);
+
+	FNBodyState& State = Simulation.State;
+
+	// Bodies added after the snapshot was taken keep what the game thread gave them until the next one
+	const int32 NumBodies = FMath::Min(State.Num(), Snapshot->Masses.Num());
+
+	PreviousPositions = State.Positions;
+	PreviousSnapshotTime = LatestSnapshotTime;
+	LatestSnapshotTime = Snapshot->PublishTime;
+
+	FMemory::Memcpy(State.Positions.GetData(), Snapshot->Positions.GetData(), NumBodies * sizeof(FVector3d));
+	FMemory::Memcpy(State.Velocities.GetData(), Snapshot->Velocities.GetData(), NumBodies * sizeof(FVector3d));
+	FMemory::Memcpy(State.Accelerations.GetData(), Snapshot->Accelerations.GetData(), NumBodies * sizeof(FVector3d));
+	FMemory::Memcpy(State.Masses.GetData(), Snapshot->Masses.GetData(), NumBodies * sizeof(double));
+	State.Time = Snapshot->Time;
+
+	AccelerationsStale = NumBodies != State.Num();
+	BodyHashStale = true;
+
+	if (IsRecording()) {
+		RecordFrame();
 	}
 }
 
-FVector ASolarySystemManager::CalculateGravitationalForce(ACelestialBody* Body, ACelestialBody* OtherBody)
+bool ASolarySystemManager::LoadScenario(const FString& FileName)
 {
-	FVector Direction = OtherBody->GetActorLocation() - Body->GetActorLocation();
-	float Distance = Direction.Size();
+	const FString Path = GetScenarioPath(FileName);
 
-	if (Distance < 1.0f) {
-		return FVector::ZeroVector;
+	if (!FPaths::FileExists(Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("No scenario at %s"), *Path);
+		return false;
 	}
 
-	FVector Fdir = Direction.GetSafeNormal();
+	const uint32 Request = ++ScenarioRequest;
+	const double GravitationalConstant = G;
+	TWeakObjectPtr<ASolarySystemManager> WeakThis(this);
+	LoadingScenario = true;
+
+	// Parsing and resolving the orbits touch no UObject, only the spawn waits for the game thread
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Path, Request, GravitationalConstant]() {
+		TSharedRef<FSolarSystemScenario, ESPMode::ThreadSafe> Scenario = MakeShared<FSolarSystemScenario, ESPMode::ThreadSafe>();
+		FString Error;
+		bool Loaded;
+
+		{
+			SOLARSYSTEM_SCOPE(ScenarioLoad);
+			Loaded = Scenario->LoadFromFile(Path, Error) && Scenario->Resolve(GravitationalConstant, Error);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Path, Request, Scenario, Loaded, Error]() {
+			ASolarySystemManager* Manager = WeakThis.Get();
 
-	float ForceMagnitude = G * (Body->Mass * OtherBody->Mass) / (Distance * Distance);
+			if (!Manager || Manager->ScenarioRequest != Request) {
+				return;
+			}
+
+			Manager->LoadingScenario = false;
+
+			if (!Loaded) {
+				UE_LOG(LogTemp, Warning, TEXT("Could not load scenario %s: %s"), *Path, *Error);
+				return;
+			}
 
-	return Fdir * ForceMagnitude;
+			Manager->ApplyScenario(*Scenario);
+		});
+	});
+
+	return true;
 }
 
-void ASolarySystemManager::UpdateGravitationalForces(float DeltaTime)
+void ASolarySystemManager::ApplyScenario(FSolarSystemScenario& Scenario)
 {
-	for (int32 i = 0; i < CelestialBodies.Num(); ++i){
-		for (int32 j = i + 1; j < CelestialBodies.Num(); j++) {
-			ACelestialBody* Body = CelestialBodies[i];
-			ACelestialBody* OtherBody = CelestialBodies[j];
+	SOLARSYSTEM_SCOPE(ScenarioSpawn);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 NumBodies = Scenario.Bodies.Num();
+
+	// Recordings and tables belong to the old body set
+	StopRecording();
+	StopPlayback();
+	Ephemeris.Reset();
+
+	for (ACelestialBody* Body : ScenarioActors) {
+		if (Body) {
+			Body->Destroy();
+		}
+	}
+	ScenarioActors.Reset();
+	PendingSpawnIndices.Reset();
+	PendingSpawnBodies.Reset();
+	PendingPlanets.Reset();
+
+	for (UOrbitPathComponent* Path : OrbitPaths) {
+		if (Path) {
+			Path->DestroyComponent();
+		}
+	}
+	OrbitPaths.Reset();
+
+	ApplySimulationSettings();
+	Simulation.State = MoveTemp(Scenario.State);
 
-			if (Body && OtherBody) {
-				FVector Force = CalculateGravitationalForce(Body, OtherBody);
+	CelestialBodies.Init(nullptr, NumBodies);
+	BodyRadii.SetNumUninitialized(NumBodies);
+	BodyNames.SetNum(NumBodies);
+	BodyPropagationModes.SetNum(NumBodies);
+
+	for (int32 i = 0; i < NumBodies; ++i) {
+		const FScenarioBody& Entry = Scenario.Bodies[i];
+		BodyRadii[i] = FMath::Max(Entry.Radius * CollisionRadiusScale, 0.0f);
+		BodyNames[i] = Entry.Name;
+		BodyPropagationModes[i] = Entry.PropagationMode;
+	}
 
-				Body->ApplyGravitationalForce(Force, DeltaTime);
-				OtherBody->ApplyGravitationalForce(-Force, DeltaTime);
+	// Actors are only queued here, UpdateScenarioSpawns spawns them a frame's budget at a time. Popped from the back,
+	// so queued in reverse to come out in file order
+	if (SpawnScenarioVisuals) {
+		for (int32 i = NumBodies - 1; i >= 0; --i) {
+			if (Scenario.Bodies[i].Visual) {
+				PendingSpawnIndices.Add(i);
+				PendingSpawnBodies.Add(MoveTemp(Scenario.Bodies[i]));
 			}
 		}
 	}
+
+	OnBodySetChanged();
+	TimeAccumulator = 0.0;
+	StartState = Simulation.State;
+	StartBodyNames = BodyNames;
+
+	if (UseEphemeris) {
+		LoadEphemeris();
+	}
+
+	SpawnParticleBelts();
+	StartSimulationThread();
+
+	UE_LOG(LogTemp, Log, TEXT("Scenario with %d bodies applied in %.2f ms, %d actors queued"),
+		NumBodies, (FPlatformTime::Seconds() - StartTime) * 1000.0, PendingSpawnIndices.Num());
 }
 
-void ASolarySystemManager::SimulateOrbits()
+ACelestialBody* ASolarySystemManager::SpawnScenarioBody(int32 BodyIndex, const FScenarioBody& Entry, const FVector* CameraLocation)
 {
-	// TODO: refacto for better perf
+	const FNBodyState& State = Simulation.State;
+	UClass* BodyClass = ScenarioBodyClass ? ScenarioBodyClass.Get() : ACelestialBody::StaticClass();
 
-	for (ACelestialBody* Body : CelestialBodies) {
-		if (!Body || Body->CurrentVelocity.SizeSquared() < 0.01f) {
-			continue;
+	// Deferred so BeginPlay already sees the scenario's settings and builds the planet only once
+	const FTransform Transform(FVector(State.Positions[BodyIndex]));
+	ACelestialBody* Body = GetWorld()->SpawnActorDeferred<ACelestialBody>(BodyClass, Transform, this);
+
+	if (!Body) {
+		return nullptr;
+	}
+
+	Body->BodyName = Entry.Name;
+	Body->Mass = (float)State.Masses[BodyIndex];
+	Body->Radius = Entry.Radius;
+	Body->SurfaceGravity = Entry.SurfaceGravity;
+	Body->InitialVelocity = State.Velocities[BodyIndex];
+	Body->PropagationMode = Entry.PropagationMode;
+	Body->OrbitColor = Entry.Color;
+	Body->VisualScale = Entry.VisualScale;
+	Body->PlanetSubdivisions = Entry.Planet.Subdivisions;
+
+	// A planet too far away to see waits until the camera comes close
+	Body->DeferPlanetGeneration = CameraLocation && FVector::DistSquared(Transform.GetLocation(), *CameraLocation) > FMath::Square(ScenarioPlanetDistance);
+
+	if (UProceduralPlanetGenerator* Planet = Body->ProceduralMesh) {
+		Planet->SmoothShading = Entry.Planet.SmoothShading;
+		Planet->ApplyNoise = Entry.Planet.ApplyNoise;
+		Planet->NoiseScale = Entry.Planet.NoiseScale;
+		Planet->NoiseHeightMultiplier = Entry.Planet.NoiseHeightMultiplier;
+		Planet->NoiseOctaves = Entry.Planet.NoiseOctaves;
+		Planet->NoisePersistence = Entry.Planet.NoisePersistence;
+		Planet->NoiseLacunarity = Entry.Planet.NoiseLacunarity;
+		Planet->NoiseSeed = Entry.Planet.NoiseSeed;
+		Planet->UseHeightCache = Entry.Planet.HeightCacheResolution > 0;
+
+		if (Planet->UseHeightCache) {
+			Planet->HeightCacheResolution = Entry.Planet.HeightCacheResolution;
 		}
+	}
+
+	Body->FinishSpawning(Transform);
+	CelestialBodies[BodyIndex] = Body;
+	ScenarioActors.Add(Body);
+
+	if (Body->DeferPlanetGeneration) {
+		PendingPlanets.Add(Body);
+	}
+
+	return Body;
+}
+
+void ASolarySystemManager::UpdateScenarioSpawns()
+{
+	if (PendingSpawnIndices.Num() == 0 && PendingPlanets.Num() == 0) {
+		return;
+	}
+
+	SOLARSYSTEM_SCOPE(ScenarioSpawn);
+
+	FVector CameraLocation;
+	const bool BuildEveryPlanet = ScenarioPlanetDistance <= 0.0f;
+	const bool HasCamera = !BuildEveryPlanet && GetCameraLocation(CameraLocation);
+
+	int32 Budget = ScenarioSpawnsPerFrame > 0 ? ScenarioSpawnsPerFrame : PendingSpawnIndices.Num();
+	bool Spawned = false;
+
+	while (Budget-- > 0 && PendingSpawnIndices.Num() > 0) {
+		const int32 BodyIndex = PendingSpawnIndices.Pop(EAllowShrinking::No);
+		const FScenarioBody Entry = PendingSpawnBodies.Pop(EAllowShrinking::No);
+		Spawned |= SpawnScenarioBody(BodyIndex, Entry, HasCamera ? &CameraLocation : nullptr) != nullptr;
+	}
+
+	// Requests are only built for bodies with an actor, SimulateOrbits rebuilds them once they are reset
+	if (Spawned) {
+		OrbitRequests.Reset();
+		OrbitPredictionDirty = true;
+	}
+
+	if (!BuildEveryPlanet && !HasCamera) {
+		return;
+	}
 
-		FVector OriginalPosition = Body->GetActorLocation();
-		FVector OriginalVelocity = Body->CurrentVelocity;
+	const double BuildDistanceSquared = FMath::Square((double)ScenarioPlanetDistance);
 
-		ACelestialBody* CentralBody = nullptr;
-		float LargestMass = 0.0f;
+	for (int32 i = PendingPlanets.Num() - 1; i >= 0; --i) {
+		ACelestialBody* Body = PendingPlanets[i];
 
-		for (ACelestialBody* OtherBody : CelestialBodies) {
-			if (OtherBody && OtherBody != Body && OtherBody->Mass > LargestMass && OtherBody->CurrentVelocity.SizeSquared() < 0.1f) {
-				CentralBody = OtherBody;
-				LargestMass = OtherBody->Mass;
+		if (IsValid(Body) && !Body->HasPlanet()) {
+			if (!BuildEveryPlanet && FVector::DistSquared(Body->GetActorLocation(), CameraLocation) > BuildDistanceSquared) {
+				continue;
 			}
+			Body->RegeneratePlanet();
 		}
 
-		if (!CentralBody) {
-			UE_LOG(LogTemp, Warning, TEXT("No central body found for %s, skipping orbit"), *Body->BodyName);
+		PendingPlanets.RemoveAtSwap(i, 1, EAllowShrinking::No);
+	}
+}
+
+bool ASolarySystemManager::GetCameraLocation(FVector& OutLocation) const
+{
+	const APlayerController* PlayerController = GetWorld() ? GetWorld()->GetFirstPlayerController() : nullptr;
+	if (!PlayerController || !PlayerController->PlayerCameraManager) {
+		return false;
+	}
+
+	OutLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+	return true;
+}
+
+bool ASolarySystemManager::SaveScenario(const FString& FileName)
+{
+	const FNBodyState& State = Simulation.State;
+	FSolarSystemScenario Scenario;
+	Scenario.Bodies.SetNum(State.Num());
+
+	for (int32 i = 0; i < State.Num(); ++i) {
+		FScenarioBody& Entry = Scenario.Bodies[i];
+		Entry.Name = BodyNames[i];
+		Entry.Mass = State.Masses[i];
+		Entry.Radius = CollisionRadiusScale > 0.0f ? BodyRadii[i] / CollisionRadiusScale : 0.0f;
+		Entry.Position = State.Positions[i];
+		Entry.Velocity = State.Velocities[i];
+		Entry.PropagationMode = BodyPropagationModes[i];
+
+		const ACelestialBody* Body = CelestialBodies.IsValidIndex(i) ? CelestialBodies[i] : nullptr;
+		Entry.Visual = Body != nullptr;
+
+		if (!Body) {
 			continue;
 		}
 
-		if (detailedLogs) {
-			UE_LOG(LogTemp, Log, TEXT("Simulating orbit for %s around %s"), *Body->BodyName, *CentralBody->BodyName);
-		}
+		Entry.Radius = Body->Radius;
+		Entry.SurfaceGravity = Body->SurfaceGravity;
+		Entry.PropagationMode = Body->PropagationMode;
+		Entry.Color = Body->OrbitColor;
+		Entry.VisualScale = Body->VisualScale;
 
-		float Distance = FVector::Dist(OriginalPosition, CentralBody->GetActorLocation());
-		float Speed = Body->CurrentVelocity.Size();
+		if (Body->ProceduralMesh) {
+			Entry.Planet = Body->ProceduralMesh->GetMeshSettings();
+		}
+		Entry.Planet.Subdivisions = Body->PlanetSubdivisions;
+	}
 
-		if (Distance < 1.0f || Speed < 0.1f) {
-			UE_LOG(LogTemp, Warning, TEXT("Invalid orbit parameters for %s: Dist=%.2f, Speed=%.2f"), *Body->BodyName, Distance, Speed);
+	// Bodies whose actor is still queued keep the visual settings they were loaded with
+	for (int32 i = 0; i < PendingSpawnIndices.Num(); ++i) {
+		if (!Scenario.Bodies.IsValidIndex(PendingSpawnIndices[i])) {
 			continue;
 		}
 
-		float EstimatePeriod = (2.0f * PI * Distance) / Speed;
+		FScenarioBody& Entry = Scenario.Bodies[PendingSpawnIndices[i]];
+		const FScenarioBody& Pending = PendingSpawnBodies[i];
+		Entry.Visual = true;
+		Entry.Radius = Pending.Radius;
+		Entry.SurfaceGravity = Pending.SurfaceGravity;
+		Entry.Color = Pending.Color;
+		Entry.VisualScale = Pending.VisualScale;
+		Entry.Planet = Pending.Planet;
+	}
 
-		int32 DynamicSteps = FMath::Clamp(FMath::CeilToInt(EstimatePeriod / 10.0f), 200, 2000);
-		float SimulationTime = EstimatePeriod * 1.2f;
-		float DynamicTimeStep = SimulationTime / DynamicSteps;
+	const FString Path = GetScenarioPath(FileName);
+	if (!Scenario.SaveToFile(Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("Could not write the scenario to %s"), *Path);
+		return false;
+	}
 
-		DynamicTimeStep = FMath::Clamp(DynamicTimeStep, 0.1f, 50.0f);
+	return true;
+}
 
-		if (detailedLogs) {
-			UE_LOG(LogTemp, Log,
-				TEXT("Orbit calc for %s: Dist=%.2f, Speed=%.2f, Period=%.2f, Steps=%d, TimeStep=%.2f"),
-				*Body->BodyName,
-				Distance,
-				Speed,
-				EstimatePeriod,
-				DynamicSteps,
-				DynamicTimeStep
-			);
-		}
-
-		TArray<FVector> TempPositions;
-		TArray<FVector> TempVelocities;
-		TArray<float> TempMass;
-
-		for (ACelestialBody* OtherBody : CelestialBodies) {
-			if (OtherBody) {
-				TempPositions.Add(OtherBody->GetActorLocation());
-				TempVelocities.Add(OtherBody->CurrentVelocity);
-				TempMass.Add(OtherBody->Mass);
-			}
+FString ASolarySystemManager::GetScenarioPath(const FString& FileName)
+{
+	return FPaths::IsRelative(FileName) ? FPaths::ProjectContentDir() / TEXT("Scenarios") / FileName : FileName;
+}
+
+void ASolarySystemManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SimulationThread.Shutdown();
+	OrbitPrediction.Wait();
+	StopRecording();
+	StopPlayback();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASolarySystemManager::ApplySimulationSettings()
+{
+	Simulation.GravitationalConstant = G;
+	Simulation.Solver = GravitySolver;
+	Simulation.OpeningAngle = FMath::Max(BarnesHutTheta, 0.0f);
+	Simulation.UseSimdKernel = UseSimdGravityKernel;
+	Simulation.Softening = FMath::Max(GravitySoftening, 0.0f);
+	Simulation.MaxThreads = FMath::Max(SimulationThreads, 0);
+	Simulation.ParallelThreshold = ParallelBodyThreshold;
+	Simulation.Integrator = Integrator;
+
+	Particles.GravitationalConstant = G;
+	Particles.MinDistance = Simulation.MinDistance;
+	Particles.Softening = Simulation.Softening;
+	Particles.MaxThreads = Simulation.MaxThreads;
+}
+
+void ASolarySystemManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UpdateScenarioSpawns();
+
+	float ScaledDeltaTime = DeltaTime * TimeScale;
+
+	// Playback owns the actors, the simulation waits until it stops
+	if (IsPlayingBack()) {
+		// The thread too, at a zero time scale it keeps its state and leftover time without stepping
+		if (SimulationThread.IsRunning()) {
+			FSimulationThreadSettings PausedSettings = GetSimulationThreadSettings();
+			PausedSettings.TimeScale = 0.0;
+			SimulationThread.UpdateSettings(Simulation, PausedSettings);
 		}
 
-		TArray<FVector> OrbitPoints;
-		OrbitPoints.Add(OriginalPosition);
+		UpdatePlayback(ScaledDeltaTime);
+		ClearOrbitPaths();
+		return;
+	}
 
-		int32 BodyIndex = CelestialBodies.IndexOfByKey(Body);
-		bool OrbitUnstable = false;
+	// A scenario loaded from BeginPlay has nothing to move until it is spawned
+	if (Simulation.State.Num() == 0) {
+		return;
+	}
 
-		for (int32 step = 0; step < DynamicSteps; ++step) {
-			TArray<FVector> Accelerations;
-			Accelerations.SetNum(TempPositions.Num());
+	if (SimulationThread.IsRunning()) {
+		ApplySimulationSettings();
+		SimulationThread.UpdateSettings(Simulation, GetSimulationThreadSettings());
+		ReceiveSnapshot();
+	} else {
+		AdvanceSimulation(ScaledDeltaTime);
+	}
 
-			for (int32 i = 0; i < TempPositions.Num(); ++i) {
-				if (!CelestialBodies[i]) {
-					continue;
-				}
+	UpdatePositions();
+	UpdateParticleInstances();
 
-				FVector TotalAcceleration = FVector::ZeroVector;
+	if (drawOrbits) {
+		SimulateOrbits();
+	} else {
+		ClearOrbitPaths();
+	}
+}
 
-				for (int32 j = 0; j < CelestialBodies.Num(); ++j) {
-					if (i == j || !CelestialBodies[j]) {
-						continue;
-					}
+void ASolarySystemManager::AdvanceSimulation(float DeltaTime)
+{
+	ApplySimulationSettings();
 
-					FVector Direction = TempPositions[j] - TempPositions[i];
-					float Dist = Direction.Size();
+	if (Ephemeris.IsValid()) {
+		AdvanceEphemeris(DeltaTime);
+		return;
+	}
 
-					if (Dist > 1.0f) {
-						FVector Fdir = Direction.GetSafeNormal();
-						float AccelerationMagnitude = G * TempMass[j] / (Dist * Dist);
-						FVector Acceleration = Fdir * AccelerationMagnitude;
+	const double StepSize = FMath::Max((double)FixedTimeStep, 0.0001);
+	const int32 MaxSubsteps = GetMaxSubsteps();
+	int32 Substeps = 0;
 
-						TotalAcceleration += Acceleration;
-					}
-				}
+	TimeAccumulator += DeltaTime;
 
-				Accelerations[i] = TotalAcceleration;
-			}
+	// Nothing left to integrate: jump straight to the new time, whatever the time scale
+	if (CanSkipIntegration()) {
+		Simulation.State.Time += TimeAccumulator;
+		TimeAccumulator = 0.0;
 
-			for (int32 i = 0; i < CelestialBodies.Num(); ++i) {
-				if (!CelestialBodies[i]) {
-					continue;
-				}
+		ApplyKeplerOrbits(Simulation.State);
+		PreviousPositions = Simulation.State.Positions;
+		AccelerationsStale = true;
+		BodyHashStale = true;
+		UpdatePropagationModes();
 
-				TempPositions[i] += TempVelocities[i] * DynamicTimeStep + 0.5f * Accelerations[i] * DynamicTimeStep * DynamicTimeStep;
-			}
+		if (IsRecording()) {
+			RecordFrame();
+		}
+		return;
+	}
 
-			TArray<FVector> NewAccelerations;
-			NewAccelerations.SetNum(TempPositions.Num());
+	// The integrator only runs forward. A negative time scale pauses it, the same as on the simulation thread,
+	// instead of piling up time it would have to pay back once the scale turns positive
+	TimeAccumulator = FMath::Max(TimeAccumulator, 0.0);
 
-			for (int32 i = 0; i < TempPositions.Num(); ++i) {
-				if (!CelestialBodies[i]) {
-					continue;
-				}
+	while (TimeAccumulator >= StepSize && Substeps < MaxSubsteps) {
+		// Bodies on rails only act as sources in the step, one that just left them needs an acceleration of its own.
+		// The integrator expects the cached accelerations to match the current positions
+		if (Simulation.SetKinematicBodies(OnRails) || AccelerationsStale) {
+			Simulation.ComputeAccelerations();
+			AccelerationsStale = false;
+		}
 
-				FVector TotalAcceleration = FVector::ZeroVector;
+		const bool LastSubstep = TimeAccumulator - StepSize < StepSize || Substeps + 1 >= MaxSubsteps;
+		if (LastSubstep) {
+			PreviousPositions = Simulation.State.Positions;
+			Particles.GetPositions(PreviousParticlePositions);
+		}
 
-				for (int32 j = 0; j < CelestialBodies.Num(); ++j) {
-					if (i == j || !CelestialBodies[j]) {
-						continue;
-					}
+		const bool DetectCollisions = CollisionResponse != EBodyCollisionResponse::None && Simulation.State.Num() > 1;
+		if (DetectCollisions) {
+			StepStartPositions = Simulation.State.Positions;
+		}
 
-					FVector Direction = TempPositions[j] - TempPositions[i];
-					float Dist = Direction.Size();
+		if (ParticleAccelerationsStale) {
+			Particles.ComputeAccelerations(Simulation.State);
+			ParticleAccelerationsStale = false;
+		}
 
-					if (Dist > 1.0f) {
-						FVector Fdir = Direction.GetSafeNormal();
-						float AccelerationMagnitude = G * TempMass[j] / (Dist * Dist);
-						FVector Acceleration = Fdir * AccelerationMagnitude;
+		Simulation.Step(StepSize);
+		BodyHashStale = true;
 
-						TotalAcceleration += Acceleration;
-					}
-				}
+		if (DetectCollisions) {
+			ResolveCollisions(StepSize);
+		}
 
-				NewAccelerations[i] = TotalAcceleration;
-			}
+		if (IsRecording()) {
+			RecordFrame();
+		}
 
-			for (int32 i = 0; i < CelestialBodies.Num(); ++i) {
-				if (!CelestialBodies[i]) {
-					continue;
-				}
+		// Particles follow the massive bodies, which are already at the end of this step.
+		// The step leaves their accelerations matching the new state, a merge in it included
+		if (Particles.Num() > 0) {
+			Particles.Step(Simulation.State, StepSize);
+			ParticleAccelerationsStale = false;
+		}
+
+		TimeAccumulator -= StepSize;
+		Substeps++;
+	}
+
+	if (Substeps > 0) {
+		UpdatePropagationModes();
+	}
 
-				TempVelocities[i] += 0.5f * (Accelerations[i] + NewAccelerations[i]) * DynamicTimeStep;
+	// Drop what the step budget could not cover rather than carrying the debt into the next frames
+	if (TimeAccumulator >= StepSize) {
+		if (detailedLogs || !DroppedTimeReported) {
+			// Step size at which the budget would have covered the whole frame
+			const double NeededStepSize = (Substeps * StepSize + TimeAccumulator) / MaxSubsteps;
+			UE_LOG(LogTemp, Warning, TEXT("Simulation fell behind by %.3f s after %d substeps, dropping it. A FixedTimeStep of %.3f s keeps up at this time scale"),
+				TimeAccumulator, Substeps, NeededStepSize);
+			DroppedTimeReported = true;
+		}
+		TimeAccumulator = FMath::Fmod(TimeAccumulator, StepSize);
+	}
+}
+
+int32 ASolarySystemManager::GetMaxSubsteps() const
+{
+	return FMath::Max(MaxSubstepsPerFrame, 1);
+}
+
+void ASolarySystemManager::AdvanceEphemeris(float DeltaTime)
+{
+	FNBodyState& State = Simulation.State;
+	const double StepSize = FMath::Max((double)FixedTimeStep, 0.0001);
+	const int32 MaxSubsteps = GetMaxSubsteps();
+
+	TimeAccumulator += DeltaTime;
+
+	if (Particles.Num() == 0) {
+		// Nothing has to move in fixed steps, the table is read right at the new time, backwards included
+		State.Time = FMath::Max(State.Time + TimeAccumulator, Ephemeris.GetStartTime());
+		TimeAccumulator = 0.0;
+
+		ApplyEphemeris();
+		PreviousPositions = State.Positions;
+	} else {
+		int32 Substeps = 0;
+
+		while (TimeAccumulator >= StepSize && Substeps < MaxSubsteps) {
+			const bool LastSubstep = TimeAccumulator - StepSize < StepSize || Substeps + 1 >= MaxSubsteps;
+			if (LastSubstep) {
+				PreviousPositions = State.Positions;
+				Particles.GetPositions(PreviousParticlePositions);
 			}
 
-			if (TempPositions[BodyIndex].Size() > Distance * 1000.0f) {
-				if (detailedLogs) {
-					UE_LOG(LogTemp, Error, TEXT("Orbit simulation unstable for %s at step %d - position exploded"), *Body->BodyName, step);
-				}
-				OrbitUnstable = true;
-				break;
+			if (ParticleAccelerationsStale) {
+				Particles.ComputeAccelerations(State);
+				ParticleAccelerationsStale = false;
 			}
 
-			OrbitPoints.Add(TempPositions[BodyIndex]);
-		}
+			State.Time += StepSize;
+			ApplyEphemeris();
+			Particles.Step(State, StepSize);
 
-		if (OrbitUnstable) {
-			continue;
+			TimeAccumulator -= StepSize;
+			Substeps++;
 		}
 
-		float TotalDistance = 0.0f;
-		for (int32 k = 0; k < OrbitPoints.Num() - 1; ++k) {
-			TotalDistance += FVector::Dist(OrbitPoints[k], OrbitPoints[k + 1]);
+		if (TimeAccumulator >= StepSize) {
+			TimeAccumulator = FMath::Fmod(TimeAccumulator, StepSize);
 		}
+	}
 
-		float ExpectedCircumference = 2.0f * PI * Distance;
-		float DistanceRatio = TotalDistance / ExpectedCircumference;
+	if (IsRecording()) {
+		RecordFrame();
+	}
 
-		if (detailedLogs) {
-			UE_LOG(LogTemp, Warning,
-				TEXT("Orbit for %s: Points=%d, TotalDist=%.2f, ExpectedCirc=%.2f, Ratio=%.2f, Start=%s, End=%s"),
-				*Body->BodyName,
-				OrbitPoints.Num(),
-				TotalDistance,
-				ExpectedCircumference,
-				DistanceRatio,
-				*OrbitPoints[0].ToString(),
-				*OrbitPoints.Last().ToString()
-			);
-		}
-
-		if (drawOrbits) {
-			FColor OrbitColor = Body->OrbitColor.ToFColor(true);
-
-			for (int32 k = 0; k < OrbitPoints.Num() - 1; ++k) {
-				DrawDebugLine(
-					GetWorld(),
-					OrbitPoints[k],
-					OrbitPoints[k + 1],
-					OrbitColor,
-					false,
-					0.5f,
-					0,
-					5.0f
-				);
+	// Past the table the bodies carry on from its last state under the integrator
+	if (State.Time > Ephemeris.GetEndTime()) {
+		State.Time = Ephemeris.GetEndTime();
+		ApplyEphemeris();
+
+		UE_LOG(LogTemp, Log, TEXT("Ephemeris ends at t=%.2f, integrating from here"), State.Time);
+		Ephemeris.Reset();
+	}
+}
+
+void ASolarySystemManager::ApplyEphemeris()
+{
+	FNBodyState& State = Simulation.State;
+
+	Ephemeris.EvaluateAll(State.Time, State.Positions, State.Velocities);
+	AccelerationsStale = true;
+	BodyHashStale = true;
+}
+
+bool ASolarySystemManager::JumpToTime(float Time)
+{
+	if (!Ephemeris.Covers(Time)) {
+		return false;
+	}
+
+	Simulation.State.Time = Time;
+	TimeAccumulator = 0.0;
+
+	ApplyEphemeris();
+	PreviousPositions = Simulation.State.Positions;
+	UpdatePositions();
+	return true;
+}
+
+void ASolarySystemManager::LoadEphemeris()
+{
+	const FNBodyState& State = Simulation.State;
+	const FString Path = GetEphemerisPath(EphemerisFile);
+
+	if (!Ephemeris.Load(Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("No ephemeris at %s, run BakeEphemeris first. Integrating instead"), *Path);
+		return;
+	}
+
+	if (Ephemeris.GetNumBodies() != State.Num() || Ephemeris.BodySetHash != HashBodySet(BodyNames, State, Simulation.GravitationalConstant)) {
+		UE_LOG(LogTemp, Warning, TEXT("%s was baked from other bodies, initial state or G, integrating instead"), *Path);
+		Ephemeris.Reset();
+		return;
+	}
+
+	// Every body follows the table, none of them needs a conic
+	OnRails.Init(false, State.Num());
+
+	ApplyEphemeris();
+	PreviousPositions = State.Positions;
+
+	if (detailedLogs) {
+		UE_LOG(LogTemp, Log, TEXT("Ephemeris %s covers t=%.2f to %.2f, %.2f MB"),
+			*Path, Ephemeris.GetStartTime(), Ephemeris.GetEndTime(), Ephemeris.GetAllocatedSize() / (1024.0 * 1024.0));
+	}
+}
+
+void ASolarySystemManager::BakeEphemeris()
+{
+	TArray<FString> Names;
+	FNBodyState InitialState;
+
+	if (HasActorBegunPlay()) {
+		// Not from wherever the simulation is now: the next run starts from the same state as this one and
+		// LoadEphemeris only takes a table that begins there
+		Names = StartBodyNames;
+		InitialState = StartState;
+	} else if (!ScenarioFile.IsEmpty()) {
+		FSolarSystemScenario Scenario;
+		FString Error;
+
+		if (!Scenario.LoadFromFile(GetScenarioPath(ScenarioFile), Error) || !Scenario.Resolve(G, Error)) {
+			UE_LOG(LogTemp, Warning, TEXT("Could not load scenario %s to bake: %s"), *ScenarioFile, *Error);
+			return;
+		}
+
+		for (const FScenarioBody& Entry : Scenario.Bodies) {
+			Names.Add(Entry.Name);
+		}
+		InitialState = MoveTemp(Scenario.State);
+	} else {
+		// Same body order BeginPlay will produce
+		TArray<ACelestialBody*> Bodies = CelestialBodies;
+		Bodies.Remove(nullptr);
+
+		TArray<AActor*> FoundBodies;
+		UGameplayStatics::GetAllActorsOfClass(GetWorld(), ACelestialBody::StaticClass(), FoundBodies);
+
+		for (AActor* Actor : FoundBodies) {
+			if (ACelestialBody* Body = Cast<ACelestialBody>(Actor)) {
+				Bodies.AddUnique(Body);
 			}
+		}
 
-			DrawDebugSphere(GetWorld(), OrbitPoints[0], 15.0f, 8, FColor::Green, false, 0.016f);
-			DrawDebugSphere(GetWorld(), OrbitPoints.Last(), 15.0f, 8, FColor::Red, false, 0.016f);
-			DrawDebugSphere(GetWorld(), CentralBody->GetActorLocation(), 20.0f, 12, FColor::Yellow, false, 0.016f);
+		for (ACelestialBody* Body : Bodies) {
+			Body->InitializePhysicalState();
+			InitialState.AddBody(Body->GetActorLocation(), Body->CurrentVelocity, Body->Mass);
+			Names.Add(Body->BodyName);
 		}
+	}
+
+	FEphemerisBakeSettings Settings;
+	Settings.Duration = EphemerisDuration;
+	Settings.IntervalLength = EphemerisIntervalLength;
+	Settings.Degree = FMath::Clamp(EphemerisDegree, 1, 32);
+	Settings.MaxStepSize = EphemerisBakeStep;
 
-		Body->SetActorLocation(OriginalPosition);
-		Body->CurrentVelocity = OriginalVelocity;
+	ApplySimulationSettings();
+
+	const double StartTime = FPlatformTime::Seconds();
+	FChebyshevEphemeris Baked;
+
+	if (!FChebyshevEphemeris::Bake(Simulation, InitialState, Settings, Baked)) {
+		UE_LOG(LogTemp, Warning, TEXT("Nothing to bake, the ephemeris needs bodies, a duration and an interval length"));
+		return;
+	}
+
+	Baked.BodySetHash = HashBodySet(Names, InitialState, Simulation.GravitationalConstant);
+
+	const FString Path = GetEphemerisPath(EphemerisFile);
+	if (!Baked.Save(Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("Could not write the ephemeris to %s"), *Path);
+		return;
 	}
-}
\ No newline at end of file
+
+	UE_LOG(LogTemp, Log, TEXT("Baked %d bodies over %.2f s into %s in %.2f s, %.2f MB"),
+		Names.Num(), EphemerisDuration, *Path, FPlatformTime::Seconds() - StartTime, Baked.GetAllocatedSize() / (1024.0 * 1024.0));
+}
+
+FString ASolarySystemManager::GetEphemerisPath(const FString& FileName)
+{
+	return FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / TEXT("Ephemerides") / FileName : FileName;
+}
+
+uint32 ASolarySystemManager::HashBodySet(TConstArrayView<FString> Names, const FNBodyState& InitialState, double GravitationalConstant)
+{
+	uint32 Hash = HashCombine(GetTypeHash(GravitationalConstant), GetTypeHash(InitialState.Time));
+
+	for (const FString& Name : Names) {
+		Hash = HashCombine(Hash, GetTypeHash(Name));
+	}
+
+	// Any change to the start, however small, gives different trajectories
+	Hash = HashCombine(Hash, CityHash32((const char*)InitialState.Positions.GetData(), InitialState.Positions.Num() * sizeof(FVector3d)));
+	Hash = HashCombine(Hash, CityHash32((const char*)InitialState.Velocities.GetData(), InitialState.Velocities.Num() * sizeof(FVector3d)));
+	Hash = HashCombine(Hash, CityHash32((const char*)InitialState.Masses.GetData(), InitialState.Masses.Num() * sizeof(double)));
+
+	return Hash;
+}
+
+void ASolarySystemManager::UpdatePositions()
+{
+	SOLARSYSTEM_SCOPE(UpdatePositions);
+
+	const FNBodyState& State = Simulation.State;
+	const bool CanInterpolate = InterpolateBodies && PreviousPositions.Num() == State.Num();
+	const double Alpha = CanInterpolate ? GetRenderAlpha() : 1.0;
+
+	for (int32 i = 0; i < CelestialBodies.Num(); ++i) {
+		if (ACelestialBody* Body = CelestialBodies[i]) {
+			const FVector3d Location = CanInterpolate ? FMath::Lerp(PreviousPositions[i], State.Positions[i], Alpha) : State.Positions[i];
+			Body->SetActorLocation(Location);
+			Body->CurrentVelocity = State.Velocities[i];
+		}
+	}
+}
+
+double ASolarySystemManager::GetRenderAlpha() const
+{
+	// One snapshot behind the thread: the previous snapshot is shown at the latest one's publish time and so on
+	if (SimulationThread.IsRunning()) {
+		const double Interval = LatestSnapshotTime - PreviousSnapshotTime;
+		return InterpolateBodies && Interval > 0.0 ? FMath::Clamp((FPlatformTime::Seconds() - LatestSnapshotTime) / Interval, 0.0, 1.0) : 1.0;
+	}
+
+	const double StepSize = FMath::Max((double)FixedTimeStep, 0.0001);
+	return InterpolateBodies ? FMath::Clamp(TimeAccumulator / StepSize, 0.0, 1.0) : 1.0;
+}
+
+void ASolarySystemManager::ResolveCollisions(double StepSize)
+{
+	SOLARSYSTEM_SCOPE(Collisions);
+
+	FNBodyState& State = Simulation.State;
+
+	BodyHash.Build(StepStartPositions, State.Positions, BodyRadii);
+	BodyHash.FindContacts(StepStartPositions, State.Positions, BodyRadii, Contacts);
+	BodyHashStale = false;
+
+	INC_DWORD_STAT_BY(STAT_SolarSystem_Contacts, Contacts.Num());
+
+	if (Contacts.Num() == 0) {
+		return;
+	}
+
+	// A body absorbed earlier in the step takes no part in its later contacts
+	TBitArray<> Absorbed(false, State.Num());
+	bool AnyAbsorbed = false;
+	bool AnyMoved = false;
+
+	for (const FBodyContact& Contact : Contacts) {
+		const int32 BodyA = Contact.BodyA;
+		const int32 BodyB = Contact.BodyB;
+
+		if (Absorbed[BodyA] || Absorbed[BodyB]) {
+			continue;
+		}
+
+		const FVector3d ImpactA = FMath::Lerp(StepStartPositions[BodyA], State.Positions[BodyA], Contact.Time);
+		const FVector3d ImpactB = FMath::Lerp(StepStartPositions[BodyB], State.Positions[BodyB], Contact.Time);
+		const FVector3d Normal = (ImpactB - ImpactA).GetSafeNormal(UE_DOUBLE_SMALL_NUMBER, FVector3d::UnitZ());
+		const double ImpactSpeed = FMath::Max(-FVector3d::DotProduct(State.Velocities[BodyB] - State.Velocities[BodyA], Normal), 0.0);
+
+		if (detailedLogs) {
+			UE_LOG(LogTemp, Log, TEXT("%s hit %s at %.2f m/s"), *BodyNames[BodyA], *BodyNames[BodyB], ImpactSpeed);
+		}
+
+		OnBodiesCollided.Broadcast(CelestialBodies[BodyA], CelestialBodies[BodyB], ImpactA + Normal * BodyRadii[BodyA], ImpactSpeed);
+
+		if (CollisionResponse == EBodyCollisionResponse::Bounce) {
+			BounceBodies(Contact, StepSize);
+			AnyMoved = true;
+		} else if (CollisionResponse == EBodyCollisionResponse::Merge) {
+			const bool KeepA = State.Masses[BodyA] >= State.Masses[BodyB];
+			MergeBodies(KeepA ? BodyA : BodyB, KeepA ? BodyB : BodyA);
+			Absorbed[KeepA ? BodyB : BodyA] = true;
+			AnyAbsorbed = true;
+		}
+	}
+
+	if (AnyMoved) {
+		// Bounced bodies came off their rails and are integrated from here on
+		Simulation.SetKinematicBodies(OnRails);
+		Simulation.ComputeAccelerations();
+		BodyHashStale = true;
+	}
+
+	if (!AnyAbsorbed) {
+		return;
+	}
+
+	// From the back so the indices still to be removed stay valid
+	for (int32 i = State.Num() - 1; i >= 0; --i) {
+		if (Absorbed[i]) {
+			RemoveBody(i);
+		}
+	}
+
+	OnBodySetChanged();
+}
+
+void ASolarySystemManager::BounceBodies(const FBodyContact& Contact, double StepSize)
+{
+	FNBodyState& State = Simulation.State;
+	const int32 BodyA = Contact.BodyA;
+	const int32 BodyB = Contact.BodyB;
+
+	const FVector3d ImpactA = FMath::Lerp(StepStartPositions[BodyA], State.Positions[BodyA], Contact.Time);
+	const FVector3d ImpactB = FMath::Lerp(StepStartPositions[BodyB], State.Positions[BodyB], Contact.Time);
+	const FVector3d Normal = (ImpactB - ImpactA).GetSafeNormal(UE_DOUBLE_SMALL_NUMBER, FVector3d::UnitZ());
+
+	const double InvMassA = State.Masses[BodyA] > 0.0 ? 1.0 / State.Masses[BodyA] : 0.0;
+	const double InvMassB = State.Masses[BodyB] > 0.0 ? 1.0 / State.Masses[BodyB] : 0.0;
+	const double ApproachSpeed = -FVector3d::DotProduct(State.Velocities[BodyB] - State.Velocities[BodyA], Normal);
+
+	if (ApproachSpeed <= 0.0 || InvMassA + InvMassB <= 0.0) {
+		return;
+	}
+
+	const double Impulse = (1.0 + FMath::Clamp(Restitution, 0.0f, 1.0f)) * ApproachSpeed / (InvMassA + InvMassB);
+	State.Velocities[BodyA] -= Normal * (Impulse * InvMassA);
+	State.Velocities[BodyB] += Normal * (Impulse * InvMassB);
+
+	const double Remaining = (1.0 - Contact.Time) * StepSize;
+	State.Positions[BodyA] = ImpactA + State.Velocities[BodyA] * Remaining;
+	State.Positions[BodyB] = ImpactB + State.Velocities[BodyB] * Remaining;
+
+	// The conics no longer describe either body, UpdatePropagationModes fits new ones if their mode allows
+	LeaveRails(BodyA);
+	LeaveRails(BodyB);
+}
+
+void ASolarySystemManager::MergeBodies(int32 Survivor, int32 Absorbed)
+{
+	FNBodyState& State = Simulation.State;
+	const double MassS = State.Masses[Survivor];
+	const double MassA = State.Masses[Absorbed];
+	const double Mass = MassS + MassA;
+
+	// Weights fall back to an even split for massless bodies so the result stays finite
+	const double WeightS = Mass > 0.0 ? MassS / Mass : 0.5;
+	const double WeightA = 1.0 - WeightS;
+
+	State.Positions[Survivor] = State.Positions[Survivor] * WeightS + State.Positions[Absorbed] * WeightA;
+	State.Velocities[Survivor] = State.Velocities[Survivor] * WeightS + State.Velocities[Absorbed] * WeightA;
+	State.Masses[Survivor] = Mass;
+
+	// Same density, so the volumes add up
+	BodyRadii[Survivor] = FMath::Pow(FMath::Cube(BodyRadii[Survivor]) + FMath::Cube(BodyRadii[Absorbed]), 1.0f / 3.0f);
+
+	if (detailedLogs) {
+		UE_LOG(LogTemp, Log, TEXT("%s absorbed %s, Mass=%.2e, Radius=%.2f"), *BodyNames[Survivor], *BodyNames[Absorbed], Mass, BodyRadii[Survivor]);
+	}
+
+	if (ACelestialBody* Body = CelestialBodies[Survivor]) {
+		const ACelestialBody* Other = CelestialBodies[Absorbed];
+		const float OtherRadius = Other ? Other->Radius : BodyRadii[Absorbed] / FMath::Max(CollisionRadiusScale, UE_SMALL_NUMBER);
+
+		Body->Mass = (float)Mass;
+		Body->Radius = FMath::Pow(FMath::Cube(Body->Radius) + FMath::Cube(OtherRadius), 1.0f / 3.0f);
+
+		if (Body->UseProcedural) {
+			Body->RegeneratePlanet();
+		}
+	}
+}
+
+void ASolarySystemManager::UpdateBodyHash()
+{
+	const FNBodyState& State = Simulation.State;
+
+	if (!BodyHashStale && BodyHash.Num() == State.Num()) {
+		return;
+	}
+
+	BodyHash.Build(State.Positions, State.Positions, BodyRadii);
+	BodyHashStale = false;
+}
+
+TArray<ACelestialBody*> ASolarySystemManager::QueryBodiesInRadius(FVector Center, float Radius)
+{
+	TArray<ACelestialBody*> Bodies;
+	const FNBodyState& State = Simulation.State;
+
+	if (BodyRadii.Num() != State.Num()) {
+		return Bodies;
+	}
+
+	UpdateBodyHash();
+
+	// Every body's bounds already include its own radius, so the query box only needs the search radius
+	const double Reach = FMath::Max(Radius, 0.0f);
+	BodyHash.QuerySphere(Center, Reach, QueryResults);
+
+	for (const int32 i : QueryResults) {
+		if (CelestialBodies[i] && FVector3d::Dist(State.Positions[i], Center) - BodyRadii[i] <= Reach) {
+			Bodies.Add(CelestialBodies[i]);
+		}
+	}
+
+	return Bodies;
+}
+
+ACelestialBody* ASolarySystemManager::FindNearestBody(FVector Location, float MaxDistance)
+{
+	const FNBodyState& State = Simulation.State;
+
+	if (BodyRadii.Num() != State.Num() || State.Num() == 0) {
+		return nullptr;
+	}
+
+	UpdateBodyHash();
+
+	const double Limit = MaxDistance > 0.0f ? (double)MaxDistance : TNumericLimits<double>::Max();
+	double Reach = FMath::Min(BodyHash.GetCellSize(), Limit);
+
+	// Grow the search until it holds a body whose surface is inside it, nothing outside can be closer
+	while (true) {
+		BodyHash.QuerySphere(Location, Reach, QueryResults);
+
+		const bool Everything = QueryResults.Num() == State.Num();
+		int32 Nearest = INDEX_NONE;
+		double NearestDistance = Everything ? Limit : Reach;
+
+		for (const int32 i : QueryResults) {
+			const double Distance = FVector3d::Dist(State.Positions[i], Location) - BodyRadii[i];
+
+			if (CelestialBodies[i] && Distance <= NearestDistance) {
+				Nearest = i;
+				NearestDistance = Distance;
+			}
+		}
+
+		if (Nearest != INDEX_NONE) {
+			return CelestialBodies[Nearest];
+		}
+
+		if (Everything || Reach >= Limit) {
+			return nullptr;
+		}
+
+		Reach = FMath::Min(Reach * 2.0, Limit);
+	}
+}
+
+FString ASolarySystemManager::GetRecordingPath(const FString& FileName)
+{
+	return FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / TEXT("Recordings") / FileName : FileName;
+}
+
+bool ASolarySystemManager::StartRecording(const FString& FileName)
+{
+	StopRecording();
+
+	const FString Path = GetRecordingPath(FileName);
+	if (!Recorder.Open(Path, Simulation.State.Num(), RecordPrecision, RecordKeyframeInterval)) {
+		UE_LOG(LogTemp, Warning, TEXT("Could not open %s for recording"), *Path);
+		return false;
+	}
+
+	NextRecordTime = Simulation.State.Time;
+	RecordFrame();
+	return true;
+}
+
+void ASolarySystemManager::StopRecording()
+{
+	if (!IsRecording()) {
+		return;
+	}
+
+	const int64 Bytes = Recorder.GetBytesWritten();
+	if (!Recorder.Close()) {
+		UE_LOG(LogTemp, Warning, TEXT("Recording ended with write errors"));
+	} else if (detailedLogs) {
+		UE_LOG(LogTemp, Log, TEXT("Recording closed, %.2f MB of frames"), Bytes / (1024.0 * 1024.0));
+	}
+}
+
+void ASolarySystemManager::RecordFrame()
+{
+	const FNBodyState& State = Simulation.State;
+
+	if (State.Time < NextRecordTime) {
+		return;
+	}
+
+	SOLARSYSTEM_SCOPE(TrajectoryRecord);
+
+	if (!Recorder.AddFrame(State.Time, State.Positions)) {
+		UE_LOG(LogTemp, Warning, TEXT("Body count changed to %d, recording stopped"), State.Num());
+		StopRecording();
+		return;
+	}
+
+	NextRecordTime = State.Time + FMath::Max((double)RecordInterval, 0.0);
+}
+
+bool ASolarySystemManager::StartPlayback(const FString& FileName)
+{
+	StopPlayback();
+	StopRecording();
+
+	const FString Path = GetRecordingPath(FileName);
+	if (!Playback.Open(Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a finished trajectory recording"), *Path);
+		return false;
+	}
+
+	if (Playback.GetNumBodies() != CelestialBodies.Num()) {
+		UE_LOG(LogTemp, Warning, TEXT("%s holds %d bodies but the level has %d, only the first ones are moved"),
+			*Path, Playback.GetNumBodies(), CelestialBodies.Num());
+	}
+
+	PlaybackTime = Playback.GetStartTime();
+	UpdatePlayback(0.0f);
+	return true;
+}
+
+void ASolarySystemManager::StopPlayback()
+{
+	Playback.Close();
+}
+
+void ASolarySystemManager::SetPlaybackTime(float Time)
+{
+	if (IsPlayingBack()) {
+		PlaybackTime = FMath::Clamp((double)Time, Playback.GetStartTime(), Playback.GetEndTime());
+		UpdatePlayback(0.0f);
+	}
+}
+
+void ASolarySystemManager::UpdatePlayback(float DeltaTime)
+{
+	if (!PlaybackPaused) {
+		PlaybackTime = FMath::Min(PlaybackTime + DeltaTime, Playback.GetEndTime());
+	}
+
+	if (!Playback.Sample(PlaybackTime, PlaybackPositions)) {
+		UE_LOG(LogTemp, Warning, TEXT("Trajectory recording is damaged at t=%.2f, playback stopped"), PlaybackTime);
+		StopPlayback();
+		return;
+	}
+
+	for (int32 i = 0; i < CelestialBodies.Num() && i < PlaybackPositions.Num(); ++i) {
+		if (ACelestialBody* Body = CelestialBodies[i]) {
+			Body->SetActorLocation(PlaybackPositions[i]);
+		}
+	}
+}
+
+void ASolarySystemManager::SpawnParticleBelts()
+{
+	const FNBodyState& State = Simulation.State;
+
+	int32 Total = 0;
+	for (const FParticleBelt& Belt : ParticleBelts) {
+		Total += FMath::Max(Belt.Count, 0);
+	}
+
+	ApplySimulationSettings();
+	Particles.Empty(Total);
+	ParticleScales.Reset(Total);
+
+	for (const FParticleBelt& Belt : ParticleBelts) {
+		int32 CentralBody = Belt.CentralBody ? CelestialBodies.IndexOfByKey(Belt.CentralBody.Get()) : INDEX_NONE;
+
+		if (CentralBody == INDEX_NONE) {
+			double LargestMass = 0.0;
+			for (int32 i = 0; i < State.Num(); ++i) {
+				if (State.Masses[i] > LargestMass) {
+					CentralBody = i;
+					LargestMass = State.Masses[i];
+				}
+			}
+		}
+
+		if (CentralBody == INDEX_NONE || Belt.Count <= 0) {
+			continue;
+		}
+
+		const FVector3d Center = State.Positions[CentralBody];
+		const FVector3d CenterVelocity = State.Velocities[CentralBody];
+		const double Mu = Simulation.GravitationalConstant * State.Masses[CentralBody];
+		const FVector3d Normal = FVector3d(Belt.Normal).GetSafeNormal(UE_DOUBLE_SMALL_NUMBER, FVector3d::UnitZ());
+		const double InnerRadius = FMath::Max(FMath::Min(Belt.InnerRadius, Belt.OuterRadius), 1.0f);
+		const double OuterRadius = FMath::Max(Belt.InnerRadius, Belt.OuterRadius);
+
+		FVector3d AxisA;
+		FVector3d AxisB;
+		Normal.FindBestAxisVectors(AxisA, AxisB);
+
+		FRandomStream Random(Belt.Seed);
+
+		for (int32 i = 0; i < Belt.Count; ++i) {
+			// Uniform over the area of the ring, not over the radius
+			const double Radius = FMath::Sqrt(FMath::Lerp(InnerRadius * InnerRadius, OuterRadius * OuterRadius, (double)Random.FRand()));
+			const double Angle = Random.FRandRange(0.0f, 2.0f * PI);
+			const FVector3d Radial = AxisA * FMath::Cos(Angle) + AxisB * FMath::Sin(Angle);
+			const FVector3d Tangent = FVector3d::CrossProduct(Normal, Radial);
+			const double Height = (Random.FRand() - 0.5) * Belt.Thickness;
+
+			// Starts at the periapsis of an orbit with a random eccentricity up to the belt maximum
+			const double Eccentricity = Random.FRand() * Belt.MaxEccentricity;
+			const double Speed = FMath::Sqrt(Mu * (1.0 + Eccentricity) / Radius);
+
+			Particles.AddParticle(Center + Radial * Radius + Normal * Height, CenterVelocity + Tangent * Speed);
+			ParticleScales.Add(Random.FRandRange(Belt.MinScale, Belt.MaxScale));
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SolarSystem_NumParticles, Particles.Num());
+
+	if (ParticleInstances) {
+		ParticleInstances->ClearInstances();
+	}
+
+	if (Particles.Num() == 0) {
+		return;
+	}
+
+	Particles.ComputeAccelerations(State);
+	Particles.GetPositions(PreviousParticlePositions);
+
+	if (!ParticleMesh) {
+		UE_LOG(LogTemp, Warning, TEXT("%d belt particles are simulated but not drawn, ParticleMesh is not set"), Particles.Num());
+		return;
+	}
+
+	if (!ParticleInstances) {
+		ParticleInstances = NewObject<UInstancedStaticMeshComponent>(this);
+		ParticleInstances->SetMobility(EComponentMobility::Movable);
+		ParticleInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		ParticleInstances->SetCastShadow(false);
+
+		// Instance transforms are world positions, so the component itself stays at the origin
+		ParticleInstances->SetUsingAbsoluteLocation(true);
+		ParticleInstances->SetUsingAbsoluteRotation(true);
+		ParticleInstances->SetUsingAbsoluteScale(true);
+		ParticleInstances->RegisterComponent();
+		ParticleInstances->SetWorldTransform(FTransform::Identity);
+	}
+
+	ParticleInstances->SetStaticMesh(ParticleMesh);
+	if (ParticleMaterial) {
+		ParticleInstances->SetMaterial(0, ParticleMaterial);
+	}
+
+	ParticleTransforms.SetNum(Particles.Num());
+	for (int32 i = 0; i < Particles.Num(); ++i) {
+		ParticleTransforms[i] = FTransform(FQuat::Identity, Particles.GetPosition(i), FVector(ParticleScales[i]));
+	}
+
+	ParticleInstances->AddInstances(ParticleTransforms, false, false);
+}
+
+void ASolarySystemManager::UpdateParticleInstances()
+{
+	if (!ParticleInstances || Particles.Num() == 0 || ParticleInstances->GetInstanceCount() != Particles.Num()) {
+		return;
+	}
+
+	SOLARSYSTEM_SCOPE(ParticleInstances);
+
+	const bool CanInterpolate = InterpolateBodies && PreviousParticlePositions.Num() == Particles.Num();
+	const double Alpha = CanInterpolate ? GetRenderAlpha() : 1.0;
+	const int32 BlockSize = 4096;
+
+	// Only translations change, the per instance scale set at spawn stays in place
+	ParallelFor(FMath::DivideAndRoundUp(Particles.Num(), BlockSize), [&](int32 Block) {
+		const int32 End = FMath::Min((Block + 1) * BlockSize, Particles.Num());
+
+		for (int32 i = Block * BlockSize; i < End; ++i) {
+			const FVector3d Position = Particles.GetPosition(i);
+			ParticleTransforms[i].SetTranslation(CanInterpolate ? FMath::Lerp(PreviousParticlePositions[i], Position, Alpha) : Position);
+		}
+	});
+
+	ParticleInstances->BatchUpdateInstancesTransforms(0, ParticleTransforms, false, true, true);
+}
+
+void ASolarySystemManager::InitializeKeplerOrbits()
+{
+	const int32 NumBodies = Simulation.State.Num();
+
+	KeplerOrbits.SetNum(NumBodies);
+	KeplerCentralBodies.Init(INDEX_NONE, NumBodies);
+	CentralBodyCache.Init(CentralBodyUnknown, NumBodies);
+	OnRails.Init(false, NumBodies);
+
+	UpdatePropagationModes();
+}
+
+bool ASolarySystemManager::FitKeplerOrbit(int32 BodyIndex)
+{
+	const FNBodyState& State = Simulation.State;
+	const int32 CentralBody = GetCentralBody(BodyIndex);
+
+	// Orbits are only anchored to bodies that are integrated themselves
+	if (CentralBody == INDEX_NONE || OnRails[CentralBody]) {
+		return false;
+	}
+
+	const double Mu = Simulation.GravitationalConstant * (State.Masses[CentralBody] + State.Masses[BodyIndex]);
+	const FVector3d RelativePosition = State.Positions[BodyIndex] - State.Positions[CentralBody];
+	const FVector3d RelativeVelocity = State.Velocities[BodyIndex] - State.Velocities[CentralBody];
+
+	if (!FKeplerOrbit::FromStateVectors(RelativePosition, RelativeVelocity, Mu, State.Time, KeplerOrbits[BodyIndex])) {
+		return false;
+	}
+
+	KeplerCentralBodies[BodyIndex] = CentralBody;
+	OnRails[BodyIndex] = true;
+
+	if (detailedLogs) {
+		const FKeplerOrbit& Orbit = KeplerOrbits[BodyIndex];
+		UE_LOG(LogTemp, Log, TEXT("Kepler orbit for %s: a=%.2f, e=%.4f, Period=%.2f"),
+			*BodyNames[BodyIndex], Orbit.SemiMajorAxis, Orbit.Eccentricity, Orbit.GetPeriod());
+	}
+
+	return true;
+}
+
+void ASolarySystemManager::ApplyKeplerOrbits(FNBodyState& State)
+{
+	SOLARSYSTEM_SCOPE(Kepler);
+
+	for (int32 i = 0; i < OnRails.Num(); ++i) {
+		if (!OnRails[i]) {
+			continue;
+		}
+
+		const int32 CentralBody = KeplerCentralBodies[i];
+		FVector3d RelativePosition;
+		FVector3d RelativeVelocity;
+		KeplerOrbits[i].Evaluate(State.Time, RelativePosition, RelativeVelocity);
+
+		State.Positions[i] = State.Positions[CentralBody] + RelativePosition;
+		State.Velocities[i] = State.Velocities[CentralBody] + RelativeVelocity;
+	}
+}
+
+void ASolarySystemManager::UpdatePropagationModes()
+{
+	FNBodyState& State = Simulation.State;
+
+	// The thread integrates every body, a conic would not match where it puts them
+	if (SimulationThread.IsRunning()) {
+		OnRails.Init(false, State.Num());
+		return;
+	}
+
+	bool KinematicAccelerationsValid = false;
+
+	for (int32 i = 0; i < OnRails.Num(); ++i) {
+		const ACelestialBody* Body = CelestialBodies.IsValidIndex(i) ? CelestialBodies[i] : nullptr;
+		const EOrbitPropagation Mode = Body ? Body->PropagationMode : BodyPropagationModes[i];
+
+		if (Mode == EOrbitPropagation::NBody) {
+			OnRails[i] = false;
+			continue;
+		}
+
+		if (Mode == EOrbitPropagation::Kepler) {
+			if (!OnRails[i]) {
+				FitKeplerOrbit(i);
+			}
+			continue;
+		}
+
+		const int32 CentralBody = OnRails[i] ? KeplerCentralBodies[i] : GetCentralBody(i);
+		if (CentralBody == INDEX_NONE) {
+			OnRails[i] = false;
+			continue;
+		}
+
+		if (AccelerationsStale) {
+			Simulation.ComputeAccelerations();
+			AccelerationsStale = false;
+		}
+
+		// The step leaves the pull on bodies on rails alone, it is only evaluated here, once per frame
+		if (OnRails[i] && !KinematicAccelerationsValid) {
+			Simulation.ComputeKinematicAccelerations(State);
+			KinematicAccelerationsValid = true;
+		}
+
+		// Whatever accelerates the body relative to its central body beyond the two-body pull
+		const FVector3d RelativePosition = State.Positions[i] - State.Positions[CentralBody];
+		const double DistanceSquared = FMath::Max(RelativePosition.SizeSquared(), 1.0);
+		const double Mu = Simulation.GravitationalConstant * (State.Masses[CentralBody] + State.Masses[i]);
+		const double CentralAcceleration = Mu / DistanceSquared;
+		const FVector3d TwoBodyAcceleration = -RelativePosition * (CentralAcceleration / FMath::Sqrt(DistanceSquared));
+		const FVector3d Perturbation = State.Accelerations[i] - State.Accelerations[CentralBody] - TwoBodyAcceleration;
+		const double Ratio = Perturbation.Size() / FMath::Max(CentralAcceleration, UE_DOUBLE_SMALL_NUMBER);
+
+		if (OnRails[i] && Ratio > KeplerPerturbationThreshold) {
+			LeaveRails(i);
+
+			if (detailedLogs) {
+				UE_LOG(LogTemp, Log, TEXT("%s perturbed (%.4f), back to N-body"), *BodyNames[i], Ratio);
+			}
+		} else if (!OnRails[i] && Ratio < KeplerPerturbationThreshold * 0.5) {
+			// Half the threshold on the way back so a body near the limit does not flip every frame
+			FitKeplerOrbit(i);
+		}
+	}
+}
+
+bool ASolarySystemManager::CanSkipIntegration() const
+{
+	// Particles are integrated in fixed steps against the massive bodies, so those have to step too
+	if (Particles.Num() > 0) {
+		return false;
+	}
+
+	// Contacts are found by sweeping each fixed step, a jump of arbitrary length would tunnel through them
+	if (CollisionResponse != EBodyCollisionResponse::None && Simulation.State.Num() > 1) {
+		return false;
+	}
+
+	TBitArray<> Anchors(false, OnRails.Num());
+	bool AnyOnRails = false;
+
+	for (int32 i = 0; i < OnRails.Num(); ++i) {
+		if (OnRails[i]) {
+			Anchors[KeplerCentralBodies[i]] = true;
+			AnyOnRails = true;
+		}
+	}
+
+	if (!AnyOnRails) {
+		return false;
+	}
+
+	// Central bodies are held in place while every body around them is on rails
+	for (int32 i = 0; i < OnRails.Num(); ++i) {
+		if (!OnRails[i] && !Anchors[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int32 ASolarySystemManager::GetCentralBody(int32 BodyIndex)
+{
+	if (!CentralBodyCache.IsValidIndex(BodyIndex)) {
+		return FindCentralBody(BodyIndex);
+	}
+
+	int32& CentralBody = CentralBodyCache[BodyIndex];
+	if (CentralBody == CentralBodyUnknown) {
+		CentralBody = FindCentralBody(BodyIndex);
+	}
+
+	return CentralBody;
+}
+
+void ASolarySystemManager::LeaveRails(int32 BodyIndex)
+{
+	OnRails[BodyIndex] = false;
+
+	// The body it orbits may have changed since the search, the next fit looks again
+	CentralBodyCache[BodyIndex] = CentralBodyUnknown;
+}
+
+int32 ASolarySystemManager::FindCentralBody(int32 BodyIndex) const
+{
+	const FNBodyState& State = Simulation.State;
+	int32 CentralBody = INDEX_NONE;
+	double LargestMass = 0.0;
+
+	for (int32 i = 0; i < State.Num(); ++i) {
+		if (i != BodyIndex && State.Masses[i] > LargestMass && State.Velocities[i].SizeSquared() < 0.1) {
+			CentralBody = i;
+			LargestMass = State.Masses[i];
+		}
+	}
+
+	return CentralBody;
+}
+
+void ASolarySystemManager::ConfigureOrbitPredictor()
+{
+	const FNBodyState& State = Simulation.State;
+	double Horizon = FMath::Max((double)OrbitPredictionHorizon, 0.0);
+
+	OrbitRequests.SetNum(State.Num());
+	OrbitCentralBodies.Init(INDEX_NONE, State.Num());
+
+	for (int32 i = 0; i < State.Num(); ++i) {
+		ACelestialBody* Body = CelestialBodies.IsValidIndex(i) ? CelestialBodies[i] : nullptr;
+		FOrbitTrajectoryRequest& Request = OrbitRequests[i];
+		Request = FOrbitTrajectoryRequest();
+
+		if (!Body || State.Velocities[i].SizeSquared() < 0.01) {
+			continue;
+		}
+
+		const int32 CentralBody = FindCentralBody(i);
+		OrbitCentralBodies[i] = CentralBody;
+
+		Request.NumSamples = FMath::Max(Body->OrbitPredictionSamples, 0);
+		Request.Horizon = FMath::Max((double)Body->OrbitPredictionHorizon, 0.0);
+
+		if (Request.Horizon <= 0.0) {
+			if (CentralBody == INDEX_NONE) {
+				UE_LOG(LogTemp, Warning, TEXT("No central body found for %s, skipping orbit"), *Body->BodyName);
+				continue;
+			}
+
+			const double Distance = FVector3d::Dist(State.Positions[i], State.Positions[CentralBody]);
+			const double Speed = State.Velocities[i].Size();
+
+			if (Distance < 1.0 || Speed < 0.1) {
+				UE_LOG(LogTemp, Warning, TEXT("Invalid orbit parameters for %s: Dist=%.2f, Speed=%.2f"), *Body->BodyName, Distance, Speed);
+				continue;
+			}
+
+			const double EstimatePeriod = (2.0 * PI * Distance) / Speed;
+			Request.Horizon = EstimatePeriod * 1.2;
+
+			if (detailedLogs) {
+				UE_LOG(LogTemp, Log, TEXT("Orbit calc for %s: Dist=%.2f, Speed=%.2f, Period=%.2f"), *Body->BodyName, Distance, Speed, EstimatePeriod);
+			}
+		}
+
+		Horizon = FMath::Max(Horizon, Request.Horizon);
+	}
+
+	const int32 Capacity = FMath::Max(OrbitSimulationSteps, 2);
+	const double MinStepSize = FMath::Max((double)OrbitSimulationTimeStep, 0.001);
+
+	OrbitPredictionSettings.Capacity = Capacity;
+	OrbitPredictionSettings.SampleInterval = Horizon > 0.0 ? Horizon / (Capacity - 1) : MinStepSize;
+	OrbitPredictionSettings.MaxStepSize = FMath::Clamp(OrbitPredictionSettings.SampleInterval, MinStepSize, 50.0);
+
+	if (detailedLogs) {
+		UE_LOG(LogTemp, Log, TEXT("Orbit prediction: Horizon=%.2f, Samples=%d, SampleInterval=%.3f, StepSize=%.3f"),
+			Horizon, Capacity, OrbitPredictionSettings.SampleInterval, OrbitPredictionSettings.MaxStepSize);
+	}
+}
+
+void ASolarySystemManager::SimulateOrbits()
+{
+	SOLARSYSTEM_SCOPE(SimulateOrbits);
+
+	const FNBodyState& State = Simulation.State;
+	SET_DWORD_STAT(STAT_SolarSystem_Bodies, State.Num());
+
+	if (OrbitRequests.Num() != State.Num() || OrbitPredictionSettings.Capacity != FMath::Max(OrbitSimulationSteps, 2)) {
+		ConfigureOrbitPredictor();
+	}
+
+	TConstArrayView<FOrbitTrajectory> Trajectories = OrbitPrediction.GetTrajectories();
+	bool NeedsPrediction = false;
+
+	while (OrbitPaths.Num() > State.Num()) {
+		if (UOrbitPathComponent* Path = OrbitPaths.Pop()) {
+			Path->DestroyComponent();
+		}
+	}
+
+	for (int32 BodyIndex = 0; BodyIndex < CelestialBodies.Num() && BodyIndex < State.Num(); ++BodyIndex) {
+		ACelestialBody* Body = CelestialBodies[BodyIndex];
+		int32 CentralBody = OrbitCentralBodies.IsValidIndex(BodyIndex) ? OrbitCentralBodies[BodyIndex] : INDEX_NONE;
+		bool Drawn = false;
+
+		if (!Body) {
+			continue;
+		}
+
+		SCOPE_CYCLE_COUNTER(STAT_SolarSystem_SimulateOrbitBody);
+		TRACE_CPUPROFILER_EVENT_SCOPE_TEXT_ON_CHANNEL(*Body->BodyName, SolarSystemChannel);
+
+		if (OnRails.IsValidIndex(BodyIndex) && OnRails[BodyIndex]) {
+			// The conic is the whole future of a body on rails, no prediction needed
+			const FKeplerOrbit& Orbit = KeplerOrbits[BodyIndex];
+			CentralBody = KeplerCentralBodies[BodyIndex];
+
+			const FVector3d Center = State.Positions[CentralBody];
+			const double MaxRadius = FVector3d::Dist(State.Positions[BodyIndex], Center) * 10.0;
+			Orbit.SampleConic(Body->OrbitPredictionSamples > 1 ? Body->OrbitPredictionSamples : 256, MaxRadius, ConicPoints);
+
+			for (FVector3d& Point : ConicPoints) {
+				Point += Center;
+			}
+
+			if (ConicPoints.Num() >= 2) {
+				UpdateOrbitPath(BodyIndex, ConicPoints[0], ConicPoints, 1);
+				Drawn = true;
+			}
+		} else if (Ephemeris.IsValid()) {
+			// The table already holds the future, the line is sampled straight from it
+			const double Horizon = FMath::Min(OrbitRequests[BodyIndex].Horizon, Ephemeris.GetEndTime() - State.Time);
+			const int32 NumPoints = Body->OrbitPredictionSamples > 1 ? Body->OrbitPredictionSamples : 256;
+
+			if (Horizon > 0.0) {
+				ConicPoints.SetNumUninitialized(NumPoints);
+
+				for (int32 Point = 0; Point < NumPoints; ++Point) {
+					ConicPoints[Point] = Ephemeris.EvaluatePosition(State.Time + Horizon * Point / (NumPoints - 1), BodyIndex);
+				}
+
+				UpdateOrbitPath(BodyIndex, Body->GetActorLocation(), ConicPoints, 1);
+				Drawn = true;
+			}
+		} else {
+			NeedsPrediction |= OrbitRequests.IsValidIndex(BodyIndex) && OrbitRequests[BodyIndex].Horizon > 0.0;
+
+			const FOrbitTrajectory* Trajectory = Trajectories.IsValidIndex(BodyIndex) ? &Trajectories[BodyIndex] : nullptr;
+
+			if (Trajectory && Trajectory->Points.Num() >= 2 && Trajectory->TimeStep > 0.0) {
+				// The trajectory was predicted from an older snapshot, skip the points already behind the body
+				const int32 FirstPoint = FMath::Max(FMath::CeilToInt((State.Time - Trajectory->StartTime) / Trajectory->TimeStep), 1);
+				UpdateOrbitPath(BodyIndex, Body->GetActorLocation(), Trajectory->Points, FirstPoint);
+				Drawn = true;
+			}
+		}
+
+		if (!Drawn) {
+			if (OrbitPaths.IsValidIndex(BodyIndex) && OrbitPaths[BodyIndex]) {
+				OrbitPaths[BodyIndex]->ClearPath();
+			}
+			continue;
+		}
+
+		if (CentralBody != INDEX_NONE) {
+			DrawDebugSphere(GetWorld(), State.Positions[CentralBody], 20.0f, 12, FColor::Yellow, false, 0.016f);
+		}
+	}
+
+	if (!NeedsPrediction) {
+		return;
+	}
+
+	OrbitPredictionSettings.Tolerance = OrbitPredictionTolerance;
+	OrbitPredictionSettings.MaxNewSamples = FMath::Max(OrbitSamplesPerFrame, 1);
+
+	// A job still in flight keeps its snapshot, the next one launches once it has published
+	if (OrbitPrediction.TryLaunch(State, Simulation, OrbitPredictionSettings, OrbitRequests, OrbitPredictionDirty)) {
+		OrbitPredictionDirty = false;
+	}
+}
+
+void ASolarySystemManager::UpdateOrbitPath(int32 BodyIndex, const FVector& StartPoint, TConstArrayView<FVector3d> Points, int32 FirstPoint)
+{
+	if (OrbitPaths.Num() <= BodyIndex) {
+		OrbitPaths.SetNum(BodyIndex + 1);
+	}
+
+	TObjectPtr<UOrbitPathComponent>& Path = OrbitPaths[BodyIndex];
+	if (!Path) {
+		Path = NewObject<UOrbitPathComponent>(this);
+		Path->RegisterComponent();
+	}
+
+	const ACelestialBody* Body = CelestialBodies[BodyIndex];
+	Path->SetPath(StartPoint, Points, FirstPoint, Body->OrbitColor);
+
+	INC_DWORD_STAT_BY(STAT_SolarSystem_OrbitPoints, Path->NumSegments());
+	CSV_CUSTOM_STAT(SolarSystem, OrbitPoints, Path->NumSegments(), ECsvCustomStatOp::Accumulate);
+
+	const FVector EndPoint = Points.Num() > FirstPoint ? FVector(Points.Last()) : StartPoint;
+	DrawDebugSphere(GetWorld(), StartPoint, 15.0f, 8, FColor::Green, false, 0.016f);
+	DrawDebugSphere(GetWorld(), EndPoint, 15.0f, 8, FColor::Red, false, 0.016f);
+}
+
+void ASolarySystemManager::ClearOrbitPaths()
+{
+	for (UOrbitPathComponent* Path : OrbitPaths) {
+		if (Path) {
+			Path->ClearPath();
+		}
+	}
+}
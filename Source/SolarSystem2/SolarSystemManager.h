@@ -3,8 +3,22 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "CelestialBody.h"
+#include "NBodySimulation.h"
+#include "KeplerOrbit.h"
+#include "OrbitPathComponent.h"
+#include "OrbitPredictor.h"
+#include "ParticleBelt.h"
+#include "BodyCollision.h"
+#include "TrajectoryRecording.h"
+#include "Ephemeris.h"
+#include "SolarSystemScenario.h"
+#include "SimulationThread.h"
 #include "SolarSystemManager.generated.h"
 
+class UInstancedStaticMeshComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnBodiesCollided, ACelestialBody*, BodyA, ACelestialBody*, BodyB, FVector, Location, float, ImpactSpeed);
+
 UCLASS()
 class SOLARSYSTEM2_API ASolarySystemManager : public AActor
 {
@@ -13,35 +27,447 @@ class SOLARSYSTEM2_API ASolarySystemManager : public AActor
 public:
 	ASolarySystemManager();
 
+	// Indexed like the simulation state, nullptr for scenario bodies spawned without a visual
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system")
 	TArray<ACelestialBody*> CelestialBodies;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system")
 	float TimeScale = 1.0f;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Scenario", meta = (ToolTip = "Bodies loaded from this file instead of the level's, relative names go under Content/Scenarios. Empty uses the level's bodies"))
+	FString ScenarioFile;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Scenario", meta = (ToolTip = "Actor spawned for every scenario body with a visual, a plain celestial body when not set"))
+	TSubclassOf<ACelestialBody> ScenarioBodyClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Scenario", meta = (ToolTip = "Off simulates every scenario body without spawning a single actor"))
+	bool SpawnScenarioVisuals = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Scenario", meta = (ClampMin = "0", ToolTip = "Scenario actors spawned per frame, the rest follow on the next frames while the bodies already move. 0 spawns them all at once"))
+	int32 ScenarioSpawnsPerFrame = 64;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Scenario", meta = (ClampMin = "0", ToolTip = "Scenario bodies farther than this from the camera build their planet only once the camera comes this close. 0 builds every planet at spawn"))
+	float ScenarioPlanetDistance = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Gravity")
+	EGravitySolver GravitySolver = EGravitySolver::Direct;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Gravity", meta = (ClampMin = "0", ToolTip = "Barnes-Hut opening angle, 0 matches the direct sum"))
+	float BarnesHutTheta = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Gravity", meta = (ToolTip = "Use the packed SIMD kernel for the direct sum"))
+	bool UseSimdGravityKernel = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Gravity", meta = (ClampMin = "0", ToolTip = "Plummer softening length, 0 disables softening"))
+	float GravitySoftening = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Integration")
+	EIntegrator Integrator = EIntegrator::VelocityVerlet;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Integration", meta = (ClampMin = "0.0001", ToolTip = "Simulated seconds advanced by each internal step"))
+	float FixedTimeStep = 0.02f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Integration", meta = (ClampMin = "1", ToolTip = "Internal steps allowed per frame whatever the time scale, simulated time beyond the budget is dropped. High time scales keep up with a larger FixedTimeStep"))
+	int32 MaxSubstepsPerFrame = 64;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Integration", meta = (ToolTip = "Place bodies between the last two internal steps"))
+	bool InterpolateBodies = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Integration", meta = (ClampMin = "0", ToolTip = "Perturbing to central acceleration ratio above which Automatic bodies go back to N-body"))
+	float KeplerPerturbationThreshold = 0.01f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Collisions")
+	EBodyCollisionResponse CollisionResponse = EBodyCollisionResponse::None;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Collisions", meta = (ClampMin = "0", ClampMax = "1", ToolTip = "Share of the approach speed kept by a bounce"))
+	float Restitution = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Collisions", meta = (ClampMin = "0", ToolTip = "Multiplies each body's Radius, the drawn planets are Radius * VisualScale"))
+	float CollisionRadiusScale = 1.0f;
+
+	// Fired on the game thread for every contact, before a merge removes the lighter body
+	UPROPERTY(BlueprintAssignable, Category = "Solar system|Collisions")
+	FOnBodiesCollided OnBodiesCollided;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Particles", meta = (ToolTip = "Massless asteroids and ring debris, pulled by the bodies without pulling back"))
+	TArray<FParticleBelt> ParticleBelts;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Particles")
+	TObjectPtr<UStaticMesh> ParticleMesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Particles")
+	TObjectPtr<UMaterialInterface> ParticleMaterial;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ToolTip = "Move the bodies along the table in EphemerisFile instead of integrating, for as long as it covers the simulated time"))
+	bool UseEphemeris = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ToolTip = "Relative names go under Saved/Ephemerides"))
+	FString EphemerisFile = TEXT("SolarSystem.eph");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ClampMin = "0", ToolTip = "Simulated seconds BakeEphemeris covers"))
+	float EphemerisDuration = 3600.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ClampMin = "0.001", ToolTip = "Time span of one polynomial piece, keep it well below the shortest orbital period"))
+	float EphemerisIntervalLength = 10.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ClampMin = "1", ClampMax = "32"))
+	int32 EphemerisDegree = 12;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Ephemeris", meta = (ClampMin = "0.0001", ToolTip = "Largest fourth order integration step of the bake"))
+	float EphemerisBakeStep = 0.01f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Recording", meta = (ClampMin = "0", ToolTip = "Simulated seconds between recorded frames, 0 records every fixed step"))
+	float RecordInterval = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Recording", meta = (ClampMin = "0.000001", ToolTip = "Position quantum of the delta encoded frames, keyframes are exact"))
+	float RecordPrecision = 0.01f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Recording", meta = (ClampMin = "1", ToolTip = "Frames per chunk, each chunk opens with a keyframe and is what a seek decodes"))
+	int32 RecordKeyframeInterval = 64;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Recording", meta = (ToolTip = "Hold the playback time, SetPlaybackTime still scrubs"))
+	bool PlaybackPaused = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Performance", meta = (ToolTip = "Integrate on a dedicated thread at SimulationThreadRate, the game thread only interpolates its snapshots. Read when the bodies are set up"))
+	bool UseSimulationThread = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Performance", meta = (ClampMin = "1", ToolTip = "Wall clock updates per second of the simulation thread"))
+	float SimulationThreadRate = 120.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Performance", meta = (ClampMin = "0", ToolTip = "Threads used by the force pass, 0 uses every core"))
+	int32 SimulationThreads = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Solar system|Performance", meta = (ClampMin = "2", ToolTip = "Below this body count the force pass stays on the game thread"))
+	int32 ParallelBodyThreshold = 256;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug")
 	bool detailedLogs = false;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug")
 	bool drawOrbits = true;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug", meta = (ClampMin = "2", ToolTip = "Samples kept per body in the shared orbit prediction"))
 	int32 OrbitSimulationSteps = 1000;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug", meta = (ClampMin = "0.001", ToolTip = "Smallest integration step used by the orbit prediction"))
 	float OrbitSimulationTimeStep = 0.1f;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug", meta = (ClampMin = "0", ToolTip = "Minimum predicted time span, the prediction always covers the longest horizon requested by a body"))
+	float OrbitPredictionHorizon = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug", meta = (ClampMin = "0", ToolTip = "Distance between prediction and simulation that restarts the prediction"))
+	float OrbitPredictionTolerance = 100.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug", meta = (ClampMin = "1", ToolTip = "Prediction samples integrated per background job while filling the buffer"))
+	int32 OrbitSamplesPerFrame = 200;
+
+	// Replaces the bodies with the ones in FileName, read and resolved on a worker and spawned on a later frame.
+	// Relative names go under Content/Scenarios, the level's own bodies are left in place but no longer simulated.
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Scenario")
+	bool LoadScenario(const FString& FileName);
+
+	// Writes the current bodies and their planet settings, a .json name gets the hand editable form
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Scenario")
+	bool SaveScenario(const FString& FileName);
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Scenario")
+	bool IsLoadingScenario() const { return LoadingScenario; }
+
+	// Adds a body spawned at runtime from its location, InitialVelocity and Mass, false if it is already simulated
+	UFUNCTION(BlueprintCallable, Category = "Solar system")
+	bool AddBody(ACelestialBody* Body);
+
+	UFUNCTION(BlueprintCallable, Category = "Solar system")
+	bool SetBodyVelocity(ACelestialBody* Body, FVector Velocity);
+
+	UFUNCTION(BlueprintCallable, Category = "Solar system")
+	bool SetBodyMass(ACelestialBody* Body, float Mass);
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Performance")
+	bool IsUsingSimulationThread() const { return SimulationThread.IsRunning(); }
+
+	// Bodies whose collision sphere reaches within Radius of Center, as of the last simulation step
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Queries")
+	TArray<ACelestialBody*> QueryBodiesInRadius(FVector Center, float Radius);
+
+	// Body with the closest surface, nullptr when none is within MaxDistance (0 searches without limit)
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Queries")
+	ACelestialBody* FindNearestBody(FVector Location, float MaxDistance = 0.0f);
+
+	// Integrates the level's or the scenario's bodies from their initial state once and fits the table UseEphemeris plays back
+	UFUNCTION(BlueprintCallable, CallInEditor, Category = "Solar system|Ephemeris")
+	void BakeEphemeris();
+
+	// Moves every body to any time the ephemeris covers, false when it is not in use or does not reach Time
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Ephemeris")
+	bool JumpToTime(float Time);
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Ephemeris")
+	bool IsUsingEphemeris() const { return Ephemeris.IsValid(); }
+
+	// Streams body positions to FileName, relative names go under Saved/Recordings.
+	// Recording stops on its own when a merge changes the body count.
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Recording")
+	bool StartRecording(const FString& FileName);
+
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Recording")
+	void StopRecording();
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Recording")
+	bool IsRecording() const { return Recorder.IsOpen(); }
+
+	// Moves the bodies along a recording instead of integrating, at TimeScale.
+	// The simulation is left where it was and picks up from there once playback stops.
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Recording")
+	bool StartPlayback(const FString& FileName);
+
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Recording")
+	void StopPlayback();
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Recording")
+	bool IsPlayingBack() const { return Playback.IsOpen(); }
+
+	// Jumps to a simulated time, clamped to the recorded range
+	UFUNCTION(BlueprintCallable, Category = "Solar system|Recording")
+	void SetPlaybackTime(float Time);
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Recording")
+	float GetPlaybackTime() const { return PlaybackTime; }
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Recording")
+	float GetPlaybackStartTime() const { return Playback.GetStartTime(); }
+
+	UFUNCTION(BlueprintPure, Category = "Solar system|Recording")
+	float GetPlaybackEndTime() const { return Playback.GetEndTime(); }
+
 	virtual void Tick(float DeltaTime) override;
 
 protected:
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	const float G = 0.0000000000674f;
 
-	FVector CalculateGravitationalForce(ACelestialBody* BodyA, ACelestialBody* OtherBody);
+	FNBodySimulation Simulation;
+
+	// Simulated time not yet consumed by a fixed step
+	double TimeAccumulator = 0.0;
+
+	// Positions before the most recent fixed step, used for render interpolation
+	TArray<FVector3d> PreviousPositions;
+
+	// Name and propagation mode of every body, indexed like the state so bodies without an actor keep theirs
+	TArray<FString> BodyNames;
+
+	TArray<EOrbitPropagation> BodyPropagationModes;
+
+	void BuildSimulationState();
+
+	// Rebuilds everything derived from the body set, after bodies were added or removed
+	void OnBodySetChanged();
+
+	// Drops one body from the state and every array indexed like it, destroying its actor
+	void RemoveBody(int32 BodyIndex);
+
+	void ApplySimulationSettings();
+
+	void AdvanceSimulation(float DeltaTime);
+
+	void UpdatePositions();
 
-	void UpdateGravitationalForces(float DeltaTime);
+	// Interpolation factor between PreviousPositions and the current state
+	double GetRenderAlpha() const;
+
+	// Force passes one frame may run, fixed so a hitch or a high time scale cannot snowball into longer frames
+	int32 GetMaxSubsteps() const;
+
+	// Set once the step budget first dropped simulated time, the warning is only logged once
+	bool DroppedTimeReported = false;
+
+	// Owns the state while it runs, Simulation.State then mirrors its newest snapshot
+	FSimulationThread SimulationThread;
+
+	// Publish times of the snapshots in PreviousPositions and in the state
+	double PreviousSnapshotTime = 0.0;
+	double LatestSnapshotTime = 0.0;
+
+	// Hands the current state to the thread when UseSimulationThread is set and nothing needs the game thread between steps
+	void StartSimulationThread();
+
+	FSimulationThreadSettings GetSimulationThreadSettings() const;
+
+	void ReceiveSnapshot();
+
+	FTestParticleSimulation Particles;
+
+	// Particle positions before the most recent fixed step
+	TArray<FVector3d> PreviousParticlePositions;
+
+	TArray<float> ParticleScales;
+
+	TArray<FTransform> ParticleTransforms;
+
+	// Every particle of every belt as one instance
+	UPROPERTY(Transient)
+	TObjectPtr<UInstancedStaticMeshComponent> ParticleInstances;
+
+	void SpawnParticleBelts();
+
+	void UpdateParticleInstances();
+
+	// Collision radius of every body, indexed like CelestialBodies
+	TArray<double> BodyRadii;
+
+	// Swept spheres of the last step, or the resting ones once a query rebuilt it
+	FBodySpatialHash BodyHash;
+
+	// Set when the bodies moved since BodyHash was built
+	bool BodyHashStale = true;
+
+	TArray<FVector3d> StepStartPositions;
+
+	TArray<FBodyContact> Contacts;
+
+	TArray<int32> QueryResults;
+
+	// Sweeps every body from StepStartPositions to the current state and applies CollisionResponse.
+	// Merged bodies are removed from the state once every contact of the step is handled.
+	void ResolveCollisions(double StepSize);
+
+	// Reflects the pair at their time of impact and moves them on for the rest of the step
+	void BounceBodies(const FBodyContact& Contact, double StepSize);
+
+	void MergeBodies(int32 Survivor, int32 Absorbed);
+
+	void UpdateBodyHash();
+
+	// Loaded in BeginPlay when UseEphemeris is set, reset once the simulation runs past its end
+	FChebyshevEphemeris Ephemeris;
+
+	void LoadEphemeris();
+
+	void AdvanceEphemeris(float DeltaTime);
+
+	void ApplyEphemeris();
+
+	static FString GetEphemerisPath(const FString& FileName);
+
+	// Order sensitive hash of the body names, their initial positions, velocities and masses bit for bit, the start time
+	// and G. Ties a table to the exact state it was integrated from
+	static uint32 HashBodySet(TConstArrayView<FString> Names, const FNBodyState& InitialState, double GravitationalConstant);
+
+	// State the current run started from, checked by LoadEphemeris and the one a bake in play starts from
+	FNBodyState StartState;
+	TArray<FString> StartBodyNames;
+
+	// Actors spawned for the current scenario, destroyed when another one is applied
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACelestialBody>> ScenarioActors;
+
+	bool LoadingScenario = false;
+
+	// Bumped by every LoadScenario, a load finishing after a newer one started is dropped
+	uint32 ScenarioRequest = 0;
+
+	// Visual scenario bodies still waiting for their actor, kept by body index and shifted by RemoveBody
+	TArray<int32> PendingSpawnIndices;
+	TArray<FScenarioBody> PendingSpawnBodies;
+
+	// Spawned with their planet deferred, built once the camera is within ScenarioPlanetDistance
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACelestialBody>> PendingPlanets;
+
+	void ApplyScenario(FSolarSystemScenario& Scenario);
+
+	ACelestialBody* SpawnScenarioBody(int32 BodyIndex, const FScenarioBody& Entry, const FVector* CameraLocation);
+
+	// Spawns up to ScenarioSpawnsPerFrame pending actors and builds the deferred planets the camera came close to
+	void UpdateScenarioSpawns();
+
+	bool GetCameraLocation(FVector& OutLocation) const;
+
+	static FString GetScenarioPath(const FString& FileName);
+
+	FTrajectoryWriter Recorder;
+
+	// Simulated time of the next recorded frame
+	double NextRecordTime = 0.0;
+
+	FTrajectoryReader Playback;
+
+	double PlaybackTime = 0.0;
+
+	TArray<FVector3d> PlaybackPositions;
+
+	void RecordFrame();
+
+	void UpdatePlayback(float DeltaTime);
+
+	static FString GetRecordingPath(const FString& FileName);
+
+	// Analytic orbit of every body, only used where OnRails is set
+	TArray<FKeplerOrbit> KeplerOrbits;
+
+	TArray<int32> KeplerCentralBodies;
+
+	TArray<bool> OnRails;
+
+	// What FindCentralBody last returned for each body, so the per frame mode check stays O(N). Reset with the body
+	// set, and for a single body once it leaves its rails
+	TArray<int32> CentralBodyCache;
+
+	static constexpr int32 CentralBodyUnknown = INDEX_NONE - 1;
+
+	int32 GetCentralBody(int32 BodyIndex);
+
+	void LeaveRails(int32 BodyIndex);
+
+	// Set when bodies were moved without a force evaluation
+	bool AccelerationsStale = false;
+
+	// Set when the massive bodies changed under the particles, their accelerations are recomputed at the start of the next step
+	bool ParticleAccelerationsStale = false;
+
+	// Scratch buffer for the conic or ephemeris samples of one orbit line
+	TArray<FVector3d> ConicPoints;
+
+	void InitializeKeplerOrbits();
+
+	bool FitKeplerOrbit(int32 BodyIndex);
+
+	// Puts every body on rails on its conic at State.Time, relative to where its central body is now
+	void ApplyKeplerOrbits(FNBodyState& State);
+
+	void UpdatePropagationModes();
+
+	bool CanSkipIntegration() const;
+
+	FAsyncOrbitPredictor OrbitPrediction;
+
+	FOrbitPredictionSettings OrbitPredictionSettings;
+
+	// Horizon and point count of every body's orbit line, 0 horizon when it has no orbit to draw
+	TArray<FOrbitTrajectoryRequest> OrbitRequests;
+
+	// Body each orbit is drawn around, INDEX_NONE when there is none
+	TArray<int32> OrbitCentralBodies;
+
+	// Set when the body set changed, the next prediction job starts over
+	bool OrbitPredictionDirty = true;
+
+	int32 FindCentralBody(int32 BodyIndex) const;
+
+	void ConfigureOrbitPredictor();
 
 	void SimulateOrbits();
+
+	// One persistent line strip per body, indexed like CelestialBodies
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UOrbitPathComponent>> OrbitPaths;
+
+	void UpdateOrbitPath(int32 BodyIndex, const FVector& StartPoint, TConstArrayView<FVector3d> Points, int32 FirstPoint);
+
+	void ClearOrbitPaths();
 };
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "SolarSystemScenario.h"
+#include "KeplerOrbit.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+namespace
+{
+	constexpr uint32 ScenarioFileMagic = 0x43535353; // 'SSSC'
+
+	const TCHAR* PropagationNames[] = { TEXT("NBody"), TEXT("Kepler"), TEXT("Automatic") };
+
+	bool ReadVector(const FJsonObject& Object, const TCHAR* Field, FVector3d& OutVector)
+	{
+		const TArray<TSharedPtr<FJsonValue>>* Values;
+		if (!Object.TryGetArrayField(Field, Values) || Values->Num() != 3) {
+			return false;
+		}
+
+		OutVector = FVector3d((*Values)[0]->AsNumber(), (*Values)[1]->AsNumber(), (*Values)[2]->AsNumber());
+		return true;
+	}
+
+	TArray<TSharedPtr<FJsonValue>> MakeVector(const FVector3d& Vector)
+	{
+		return { MakeShared<FJsonValueNumber>(Vector.X), MakeShared<FJsonValueNumber>(Vector.Y), MakeShared<FJsonValueNumber>(Vector.Z) };
+	}
+
+	template<typename T>
+	void ReadNumber(const FJsonObject& Object, const TCHAR* Field, T& InOutValue)
+	{
+		double Value;
+		if (Object.TryGetNumberField(Field, Value)) {
+			InOutValue = (T)Value;
+		}
+	}
+
+	// Periapsis frame rotated by the ascending node, the inclination and the argument of periapsis
+	void ElementsToState(const FScenarioBody& Body, double Mu, FVector3d& OutPosition, FVector3d& OutVelocity)
+	{
+		const double A = Body.SemiMajorAxis;
+		const double E = Body.Eccentricity;
+		const double Anomaly = FKeplerOrbit::SolveElliptic(FMath::DegreesToRadians(Body.MeanAnomaly), E);
+		const double MinorFactor = FMath::Sqrt(1.0 - E * E);
+		const double Distance = A * (1.0 - E * FMath::Cos(Anomaly));
+
+		const FVector3d PlanePosition(A * (FMath::Cos(Anomaly) - E), A * MinorFactor * FMath::Sin(Anomaly), 0.0);
+		const FVector3d PlaneVelocity = FVector3d(-FMath::Sin(Anomaly), MinorFactor * FMath::Cos(Anomaly), 0.0) * (FMath::Sqrt(Mu * A) / Distance);
+
+		const FQuat4d Rotation = FQuat4d(FVector3d::UnitZ(), FMath::DegreesToRadians(Body.AscendingNode))
+			* FQuat4d(FVector3d::UnitX(), FMath::DegreesToRadians(Body.Inclination))
+			* FQuat4d(FVector3d::UnitZ(), FMath::DegreesToRadians(Body.ArgumentOfPeriapsis));
+
+		OutPosition = Rotation.RotateVector(PlanePosition);
+		OutVelocity = Rotation.RotateVector(PlaneVelocity);
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FScenarioBody& Body)
+{
+	uint8 Propagation = (uint8)Body.PropagationMode;
+
+	Ar << Body.Name << Body.Mass << Body.Radius << Body.SurfaceGravity << Body.Position << Body.Velocity;
+	Ar << Body.Parent << Body.SemiMajorAxis << Body.Eccentricity << Body.Inclination << Body.AscendingNode << Body.ArgumentOfPeriapsis << Body.MeanAnomaly;
+	Ar << Propagation << Body.Visual << Body.Color << Body.VisualScale;
+
+	FPlanetMeshSettings& Planet = Body.Planet;
+	Ar << Planet.Subdivisions << Planet.SmoothShading << Planet.ApplyNoise << Planet.NoiseScale << Planet.NoiseHeightMultiplier;
+	Ar << Planet.NoiseOctaves << Planet.NoisePersistence << Planet.NoiseLacunarity << Planet.NoiseSeed << Planet.HeightCacheResolution;
+
+	Body.PropagationMode = (EOrbitPropagation)FMath::Min<uint8>(Propagation, UE_ARRAY_COUNT(PropagationNames) - 1);
+	return Ar;
+}
+
+bool FSolarSystemScenario::LoadFromFile(const FString& Path, FString& OutError)
+{
+	Bodies.Reset();
+
+	if (IsTextFile(Path)) {
+		FString Json;
+		if (!FFileHelper::LoadFileToString(Json, *Path)) {
+			OutError = TEXT("file not found");
+			return false;
+		}
+		return ParseJson(Json, OutError);
+	}
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path)) {
+		OutError = TEXT("file not found");
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Reader << Magic << Version;
+
+	if (Magic != ScenarioFileMagic || Version != FileVersion) {
+		OutError = TEXT("not a scenario file of this version");
+		return false;
+	}
+
+	Reader << Bodies;
+
+	if (Reader.IsError()) {
+		OutError = TEXT("truncated body list");
+		Bodies.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FSolarSystemScenario::SaveToFile(const FString& Path)
+{
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+
+	if (IsTextFile(Path)) {
+		return FFileHelper::SaveStringToFile(ToJson(), *Path);
+	}
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer.IsValid()) {
+		return false;
+	}
+
+	uint32 Magic = ScenarioFileMagic;
+	uint32 Version = FileVersion;
+	*Writer << Magic << Version;
+	*Writer << Bodies;
+	return Writer->Close();
+}
+
+bool FSolarSystemScenario::ParseJson(const FString& Json, FString& OutError)
+{
+	TSharedPtr<FJsonObject> Root;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Json);
+
+	const TArray<TSharedPtr<FJsonValue>>* Entries;
+	if (!FJsonSerializer::Deserialize(Reader, Root) || !Root.IsValid() || !Root->TryGetArrayField(TEXT("Bodies"), Entries)) {
+		OutError = FString::Printf(TEXT("expected an object with a Bodies array (%s)"), *Reader->GetErrorMessage());
+		return false;
+	}
+
+	Bodies.Reserve(Entries->Num());
+
+	for (const TSharedPtr<FJsonValue>& Entry : *Entries) {
+		const TSharedPtr<FJsonObject>* ObjectPtr;
+		if (!Entry->TryGetObject(ObjectPtr)) {
+			OutError = FString::Printf(TEXT("body %d is not an object"), Bodies.Num());
+			return false;
+		}
+
+		const FJsonObject& Object = **ObjectPtr;
+		FScenarioBody& Body = Bodies.AddDefaulted_GetRef();
+
+		if (!Object.TryGetStringField(TEXT("Name"), Body.Name)) {
+			Body.Name = FString::Printf(TEXT("Body%d"), Bodies.Num() - 1);
+		}
+
+		ReadNumber(Object, TEXT("Mass"), Body.Mass);
+		ReadNumber(Object, TEXT("Radius"), Body.Radius);
+		ReadNumber(Object, TEXT("SurfaceGravity"), Body.SurfaceGravity);
+		ReadVector(Object, TEXT("Position"), Body.Position);
+		ReadVector(Object, TEXT("Velocity"), Body.Velocity);
+
+		Object.TryGetStringField(TEXT("Parent"), Body.Parent);
+		ReadNumber(Object, TEXT("SemiMajorAxis"), Body.SemiMajorAxis);
+		ReadNumber(Object, TEXT("Eccentricity"), Body.Eccentricity);
+		ReadNumber(Object, TEXT("Inclination"), Body.Inclination);
+		ReadNumber(Object, TEXT("AscendingNode"), Body.AscendingNode);
+		ReadNumber(Object, TEXT("ArgumentOfPeriapsis"), Body.ArgumentOfPeriapsis);
+		ReadNumber(Object, TEXT("MeanAnomaly"), Body.MeanAnomaly);
+
+		FString Propagation;
+		if (Object.TryGetStringField(TEXT("PropagationMode"), Propagation)) {
+			for (int32 i = 0; i < UE_ARRAY_COUNT(PropagationNames); ++i) {
+				if (Propagation == PropagationNames[i]) {
+					Body.PropagationMode = (EOrbitPropagation)i;
+				}
+			}
+		}
+
+		Object.TryGetBoolField(TEXT("Visual"), Body.Visual);
+		ReadNumber(Object, TEXT("VisualScale"), Body.VisualScale);
+
+		const TArray<TSharedPtr<FJsonValue>>* Color;
+		if (Object.TryGetArrayField(TEXT("Color"), Color) && Color->Num() >= 3) {
+			Body.Color.R = (*Color)[0]->AsNumber();
+			Body.Color.G = (*Color)[1]->AsNumber();
+			Body.Color.B = (*Color)[2]->AsNumber();
+			Body.Color.A = Color->Num() > 3 ? (*Color)[3]->AsNumber() : 1.0f;
+		}
+
+		const TSharedPtr<FJsonObject>* PlanetPtr;
+		if (Object.TryGetObjectField(TEXT("Planet"), PlanetPtr)) {
+			const FJsonObject& PlanetObject = **PlanetPtr;
+			FPlanetMeshSettings& Planet = Body.Planet;
+
+			ReadNumber(PlanetObject, TEXT("Subdivisions"), Planet.Subdivisions);
+			PlanetObject.TryGetBoolField(TEXT("SmoothShading"), Planet.SmoothShading);
+			PlanetObject.TryGetBoolField(TEXT("ApplyNoise"), Planet.ApplyNoise);
+			ReadNumber(PlanetObject, TEXT("NoiseScale"), Planet.NoiseScale);
+			ReadNumber(PlanetObject, TEXT("NoiseHeightMultiplier"), Planet.NoiseHeightMultiplier);
+			ReadNumber(PlanetObject, TEXT("NoiseOctaves"), Planet.NoiseOctaves);
+			ReadNumber(PlanetObject, TEXT("NoisePersistence"), Planet.NoisePersistence);
+			ReadNumber(PlanetObject, TEXT("NoiseLacunarity"), Planet.NoiseLacunarity);
+			ReadNumber(PlanetObject, TEXT("NoiseSeed"), Planet.NoiseSeed);
+			ReadNumber(PlanetObject, TEXT("HeightCacheResolution"), Planet.HeightCacheResolution);
+		}
+	}
+
+	return true;
+}
+
+FString FSolarSystemScenario::ToJson() const
+{
+	TArray<TSharedPtr<FJsonValue>> Entries;
+	Entries.Reserve(Bodies.Num());
+
+	for (const FScenarioBody& Body : Bodies) {
+		TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetStringField(TEXT("Name"), Body.Name);
+		Object->SetNumberField(TEXT("Mass"), Body.Mass);
+		Object->SetNumberField(TEXT("Radius"), Body.Radius);
+		Object->SetNumberField(TEXT("SurfaceGravity"), Body.SurfaceGravity);
+
+		if (Body.Parent.IsEmpty()) {
+			Object->SetArrayField(TEXT("Position"), MakeVector(Body.Position));
+			Object->SetArrayField(TEXT("Velocity"), MakeVector(Body.Velocity));
+		} else {
+			Object->SetStringField(TEXT("Parent"), Body.Parent);
+			Object->SetNumberField(TEXT("SemiMajorAxis"), Body.SemiMajorAxis);
+			Object->SetNumberField(TEXT("Eccentricity"), Body.Eccentricity);
+			Object->SetNumberField(TEXT("Inclination"), Body.Inclination);
+			Object->SetNumberField(TEXT("AscendingNode"), Body.AscendingNode);
+			Object->SetNumberField(TEXT("ArgumentOfPeriapsis"), Body.ArgumentOfPeriapsis);
+			Object->SetNumberField(TEXT("MeanAnomaly"), Body.MeanAnomaly);
+		}
+
+		Object->SetStringField(TEXT("PropagationMode"), PropagationNames[(uint8)Body.PropagationMode]);
+		Object->SetBoolField(TEXT("Visual"), Body.Visual);
+
+		if (Body.Visual) {
+			Object->SetNumberField(TEXT("VisualScale"), Body.VisualScale);
+			Object->SetArrayField(TEXT("Color"), {
+				MakeShared<FJsonValueNumber>(Body.Color.R), MakeShared<FJsonValueNumber>(Body.Color.G),
+				MakeShared<FJsonValueNumber>(Body.Color.B), MakeShared<FJsonValueNumber>(Body.Color.A) });
+
+			const FPlanetMeshSettings& Planet = Body.Planet;
+			TSharedRef<FJsonObject> PlanetObject = MakeShared<FJsonObject>();
+			PlanetObject->SetNumberField(TEXT("Subdivisions"), Planet.Subdivisions);
+			PlanetObject->SetBoolField(TEXT("SmoothShading"), Planet.SmoothShading);
+			PlanetObject->SetBoolField(TEXT("ApplyNoise"), Planet.ApplyNoise);
+			PlanetObject->SetNumberField(TEXT("NoiseScale"), Planet.NoiseScale);
+			PlanetObject->SetNumberField(TEXT("NoiseHeightMultiplier"), Planet.NoiseHeightMultiplier);
+			PlanetObject->SetNumberField(TEXT("NoiseOctaves"), Planet.NoiseOctaves);
+			PlanetObject->SetNumberField(TEXT("NoisePersistence"), Planet.NoisePersistence);
+			PlanetObject->SetNumberField(TEXT("NoiseLacunarity"), Planet.NoiseLacunarity);
+			PlanetObject->SetNumberField(TEXT("NoiseSeed"), Planet.NoiseSeed);
+			PlanetObject->SetNumberField(TEXT("HeightCacheResolution"), Planet.HeightCacheResolution);
+			Object->SetObjectField(TEXT("Planet"), PlanetObject);
+		}
+
+		Entries.Add(MakeShared<FJsonValueObject>(Object));
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetArrayField(TEXT("Bodies"), Entries);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Root, Writer);
+	return Json;
+}
+
+bool FSolarSystemScenario::Resolve(double GravitationalConstant, FString& OutError)
+{
+	TMap<FString, int32> Indices;
+	Indices.Reserve(Bodies.Num());
+	State.Empty(Bodies.Num());
+
+	for (int32 i = 0; i < Bodies.Num(); ++i) {
+		const FScenarioBody& Body = Bodies[i];
+		const double Mass = Body.Mass > 0.0 ? Body.Mass : Body.SurfaceGravity * Body.Radius * Body.Radius / GravitationalConstant;
+		FVector3d Position = Body.Position;
+		FVector3d Velocity = Body.Velocity;
+
+		if (!Body.Parent.IsEmpty()) {
+			const int32* Parent = Indices.Find(Body.Parent);
+
+			if (!Parent) {
+				OutError = FString::Printf(TEXT("%s orbits %s, which is not listed before it"), *Body.Name, *Body.Parent);
+				return false;
+			}
+
+			if (Body.SemiMajorAxis <= 0.0 || Body.Eccentricity < 0.0 || Body.Eccentricity >= 1.0) {
+				OutError = FString::Printf(TEXT("%s needs a positive semi-major axis and an eccentricity in [0, 1)"), *Body.Name);
+				return false;
+			}
+
+			FVector3d RelativePosition;
+			FVector3d RelativeVelocity;
+			ElementsToState(Body, GravitationalConstant * (State.Masses[*Parent] + Mass), RelativePosition, RelativeVelocity);
+
+			Position = State.Positions[*Parent] + RelativePosition;
+			Velocity = State.Velocities[*Parent] + RelativeVelocity;
+		}
+
+		Indices.Add(Body.Name, i);
+		State.AddBody(Position, Velocity, Mass);
+	}
+
+	return true;
+}
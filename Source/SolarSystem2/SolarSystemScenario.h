@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Paths.h"
+#include "CelestialBody.h"
+#include "NBodySimulation.h"
+#include "PlanetMeshBuilder.h"
+
+// One body of a scenario file, placed either by an absolute state or by orbital elements around Parent
+struct FScenarioBody
+{
+	FString Name;
+
+	// 0 derives the mass from SurfaceGravity and Radius, like ACelestialBody does
+	double Mass = 0.0;
+	float Radius = 100.0f;
+	float SurfaceGravity = 9.81f;
+
+	FVector3d Position = FVector3d::ZeroVector;
+	FVector3d Velocity = FVector3d::ZeroVector;
+
+	// Name of a body earlier in the file, empty keeps Position and Velocity as they are
+	FString Parent;
+
+	// Relative to the parent in its XY plane, angles in degrees
+	double SemiMajorAxis = 0.0;
+	double Eccentricity = 0.0;
+	double Inclination = 0.0;
+	double AscendingNode = 0.0;
+	double ArgumentOfPeriapsis = 0.0;
+	double MeanAnomaly = 0.0;
+
+	EOrbitPropagation PropagationMode = EOrbitPropagation::NBody;
+
+	// Bodies without a visual are simulated but never get an actor
+	bool Visual = true;
+	FLinearColor Color = FLinearColor::White;
+	float VisualScale = 100.0f;
+
+	// Generator parameters, Radius is taken from Radius * VisualScale
+	FPlanetMeshSettings Planet;
+
+	friend FArchive& operator<<(FArchive& Ar, FScenarioBody& Body);
+};
+
+// Bodies of a system described in a file instead of placed in the level.
+// A .json file is the hand editable form, anything else is read as the compact binary form.
+// Loading and resolving touch no UObject, so both run on a worker.
+struct SOLARSYSTEM2_API FSolarSystemScenario
+{
+	// Bumped whenever the binary layout changes, older files are then rejected
+	static constexpr uint32 FileVersion = 1;
+
+	TArray<FScenarioBody> Bodies;
+
+	// Absolute state of every body once Resolve has run
+	FNBodyState State;
+
+	bool LoadFromFile(const FString& Path, FString& OutError);
+
+	bool SaveToFile(const FString& Path);
+
+	// Turns orbital elements into state vectors, parents have to come before their children
+	bool Resolve(double GravitationalConstant, FString& OutError);
+
+	static bool IsTextFile(const FString& Path) { return FPaths::GetExtension(Path) == TEXT("json"); }
+
+private:
+	bool ParseJson(const FString& Json, FString& OutError);
+
+	FString ToJson() const;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// "stat SolarSystem" in game, the SolarSystem channel in Insights (-trace=cpu,SolarSystem)
+// and the SolarSystem category in CSV captures (-csvCategories=SolarSystem)
+DECLARE_STATS_GROUP(TEXT("SolarSystem"), STATGROUP_SolarSystem, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update gravitational forces"), STAT_SolarSystem_GravitationalForces, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Integration step"), STAT_SolarSystem_Step, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulation thread update"), STAT_SolarSystem_SimulationThread, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulation snapshot apply"), STAT_SolarSystem_SnapshotApply, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Kepler propagation"), STAT_SolarSystem_Kepler, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update positions"), STAT_SolarSystem_UpdatePositions, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulate orbits"), STAT_SolarSystem_SimulateOrbits, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulate orbits (per body)"), STAT_SolarSystem_SimulateOrbitBody, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Orbit prediction job"), STAT_SolarSystem_OrbitPrediction, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Body collisions"), STAT_SolarSystem_Collisions, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trajectory record"), STAT_SolarSystem_TrajectoryRecord, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trajectory decode"), STAT_SolarSystem_TrajectoryDecode, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ephemeris evaluation"), STAT_SolarSystem_Ephemeris, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ephemeris bake"), STAT_SolarSystem_EphemerisBake, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Scenario load"), STAT_SolarSystem_ScenarioLoad, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Scenario spawn"), STAT_SolarSystem_ScenarioSpawn, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Test particles step"), STAT_SolarSystem_Particles, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Test particle instances"), STAT_SolarSystem_ParticleInstances, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate planet"), STAT_SolarSystem_GeneratePlanet, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet icosahedron"), STAT_SolarSystem_Icosahedron, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet subdivide"), STAT_SolarSystem_Subdivide, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet noise"), STAT_SolarSystem_Noise, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet normals"), STAT_SolarSystem_Normals, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet UVs"), STAT_SolarSystem_UVs, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet mesh section"), STAT_SolarSystem_MeshSection, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet LOD update"), STAT_SolarSystem_ChunkLOD, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet chunk build"), STAT_SolarSystem_ChunkBuild, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Planet height bake"), STAT_SolarSystem_HeightBake, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bodies"), STAT_SolarSystem_Bodies, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Test particles"), STAT_SolarSystem_NumParticles, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pair interactions"), STAT_SolarSystem_PairInteractions, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Body contacts"), STAT_SolarSystem_Contacts, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Orbit points emitted"), STAT_SolarSystem_OrbitPoints, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Planet vertices"), STAT_SolarSystem_PlanetVertices, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Planet chunks visible"), STAT_SolarSystem_VisibleChunks, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Shared planet topology"), STAT_SolarSystem_TopologyMemory, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Planet chunk meshes"), STAT_SolarSystem_ChunkMemory, STATGROUP_SolarSystem, SOLARSYSTEM2_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(SOLARSYSTEM2_API, SolarSystem);
+
+UE_TRACE_CHANNEL_EXTERN(SolarSystemChannel, SOLARSYSTEM2_API);
+
+// Cycle counter, CSV timer and Insights scope under one name
+#define SOLARSYSTEM_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_SolarSystem_##Name); \
+	CSV_SCOPED_TIMING_STAT(SolarSystem, Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("SolarSystem::" #Name, SolarSystemChannel)
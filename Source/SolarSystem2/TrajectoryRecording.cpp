@@ -0,0 +1,350 @@
+#include "TrajectoryRecording.h"
+#include "SolarSystemStats.h"
+#include "Algo/BinarySearch.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr uint32 TrajectoryFileMagic = 0x52545353; // 'SSTR'
+	constexpr uint32 TrajectoryFileVersion = 1;
+
+	struct FTrajectoryFileHeader
+	{
+		uint32 Magic = TrajectoryFileMagic;
+		uint32 Version = TrajectoryFileVersion;
+		int32 NumBodies = 0;
+		int32 FramesPerChunk = 0;
+		double Precision = 0.0;
+	};
+
+	struct FTrajectoryFileFooter
+	{
+		int64 IndexOffset = 0;
+		int32 NumChunks = 0;
+		uint32 Magic = TrajectoryFileMagic;
+	};
+
+	void WriteBytes(TArray<uint8>& Out, const void* Bytes, int32 Size)
+	{
+		Out.Append((const uint8*)Bytes, Size);
+	}
+
+	// Zigzag first, so small negative steps stay small
+	void WriteVarint(TArray<uint8>& Out, int64 Value)
+	{
+		uint64 Bits = ((uint64)Value << 1) ^ (uint64)(Value >> 63);
+
+		while (Bits >= 0x80) {
+			Out.Add((uint8)(Bits | 0x80));
+			Bits >>= 7;
+		}
+		Out.Add((uint8)Bits);
+	}
+
+	bool ReadVarint(const uint8*& Cursor, const uint8* End, int64& OutValue)
+	{
+		uint64 Bits = 0;
+
+		for (int32 Shift = 0; Shift < 64 && Cursor < End; Shift += 7) {
+			const uint8 Byte = *Cursor++;
+			Bits |= (uint64)(Byte & 0x7F) << Shift;
+
+			if (!(Byte & 0x80)) {
+				OutValue = (int64)(Bits >> 1) ^ -(int64)(Bits & 1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	int32 GetKeyframeBytes(int32 NumBodies)
+	{
+		return sizeof(double) + NumBodies * sizeof(FVector3d);
+	}
+}
+
+FTrajectoryWriter::~FTrajectoryWriter()
+{
+	Close();
+}
+
+bool FTrajectoryWriter::Open(const FString& Path, int32 InNumBodies, double InPrecision, int32 InFramesPerChunk)
+{
+	Close();
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+	File.Reset(IFileManager::Get().CreateFileWriter(*Path));
+
+	if (!File.IsValid()) {
+		return false;
+	}
+
+	NumBodies = InNumBodies;
+	Precision = FMath::Max(InPrecision, UE_DOUBLE_SMALL_NUMBER);
+	FramesPerChunk = FMath::Max(InFramesPerChunk, 1);
+
+	FTrajectoryFileHeader Header;
+	Header.NumBodies = NumBodies;
+	Header.FramesPerChunk = FramesPerChunk;
+	Header.Precision = Precision;
+	File->Serialize(&Header, sizeof(Header));
+
+	Offset = sizeof(Header);
+	Index.Reset();
+	Chunk.Reset();
+	ChunkInfo = FTrajectoryChunk();
+	return true;
+}
+
+bool FTrajectoryWriter::AddFrame(double Time, TConstArrayView<FVector3d> Positions)
+{
+	if (!File.IsValid() || Positions.Num() != NumBodies) {
+		return false;
+	}
+
+	if (ChunkInfo.NumFrames == 0) {
+		ChunkInfo.StartTime = Time;
+		Chunk.Reserve(GetKeyframeBytes(NumBodies) + (FramesPerChunk - 1) * (sizeof(double) + NumBodies * 6));
+
+		WriteBytes(Chunk, &Time, sizeof(Time));
+		WriteBytes(Chunk, Positions.GetData(), NumBodies * sizeof(FVector3d));
+		Decoded.Reset();
+		Decoded.Append(Positions.GetData(), NumBodies);
+	} else {
+		WriteBytes(Chunk, &Time, sizeof(Time));
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			for (int32 Axis = 0; Axis < 3; ++Axis) {
+				const int64 Delta = FMath::RoundToInt64((Positions[i][Axis] - Decoded[i][Axis]) / Precision);
+				WriteVarint(Chunk, Delta);
+				Decoded[i][Axis] += Delta * Precision;
+			}
+		}
+	}
+
+	ChunkInfo.EndTime = Time;
+	ChunkInfo.NumFrames++;
+
+	if (ChunkInfo.NumFrames >= FramesPerChunk) {
+		FlushChunk();
+	}
+
+	return true;
+}
+
+void FTrajectoryWriter::FlushChunk()
+{
+	if (ChunkInfo.NumFrames == 0) {
+		return;
+	}
+
+	ChunkInfo.Offset = Offset;
+	ChunkInfo.Size = Chunk.Num();
+	Index.Add(ChunkInfo);
+	Offset += Chunk.Num();
+
+	PendingWrite = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Writer = File.Get(), Bytes = MoveTemp(Chunk)]() mutable {
+		Writer->Serialize(Bytes.GetData(), Bytes.Num());
+	}, UE::Tasks::Prerequisites(PendingWrite));
+
+	Chunk.Reset();
+	ChunkInfo = FTrajectoryChunk();
+}
+
+bool FTrajectoryWriter::Close()
+{
+	if (!File.IsValid()) {
+		return true;
+	}
+
+	FlushChunk();
+	PendingWrite.Wait();
+
+	FTrajectoryFileFooter Footer;
+	Footer.IndexOffset = Offset;
+	Footer.NumChunks = Index.Num();
+
+	File->Serialize(Index.GetData(), Index.Num() * sizeof(FTrajectoryChunk));
+	File->Serialize(&Footer, sizeof(Footer));
+
+	const bool Success = File->Close();
+	File.Reset();
+	return Success;
+}
+
+FTrajectoryReader::~FTrajectoryReader()
+{
+	Close();
+}
+
+void FTrajectoryReader::Close()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	OwnedData.Empty();
+	Data = nullptr;
+	DataSize = 0;
+
+	Chunks.Reset();
+	DecodedChunk = INDEX_NONE;
+	FrameTimes.Reset();
+	FramePositions.Reset();
+}
+
+bool FTrajectoryReader::Open(const FString& Path)
+{
+	Close();
+
+	const int64 FileSize = IFileManager::Get().FileSize(*Path);
+	if (FileSize < (int64)(sizeof(FTrajectoryFileHeader) + sizeof(FTrajectoryFileFooter))) {
+		return false;
+	}
+
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (MappedFile.IsValid()) {
+		MappedRegion.Reset(MappedFile->MapRegion(0, FileSize));
+	}
+
+	if (MappedRegion.IsValid()) {
+		Data = MappedRegion->GetMappedPtr();
+	} else {
+		// Platforms without mapping read the whole file instead
+		MappedFile.Reset();
+
+		if (!FFileHelper::LoadFileToArray(OwnedData, *Path) || OwnedData.Num() != FileSize) {
+			Close();
+			return false;
+		}
+		Data = OwnedData.GetData();
+	}
+
+	DataSize = FileSize;
+
+	FTrajectoryFileHeader Header;
+	FTrajectoryFileFooter Footer;
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+	FMemory::Memcpy(&Footer, Data + DataSize - sizeof(Footer), sizeof(Footer));
+
+	const int64 IndexBytes = (int64)Footer.NumChunks * sizeof(FTrajectoryChunk);
+	const bool ValidHeader = Header.Magic == TrajectoryFileMagic && Header.Version == TrajectoryFileVersion && Header.NumBodies > 0;
+	const bool ValidFooter = Footer.Magic == TrajectoryFileMagic && Footer.NumChunks > 0
+		&& Footer.IndexOffset >= (int64)sizeof(Header) && Footer.IndexOffset + IndexBytes + (int64)sizeof(Footer) == DataSize;
+
+	// A recording that was never closed has no index
+	if (!ValidHeader || !ValidFooter) {
+		Close();
+		return false;
+	}
+
+	NumBodies = Header.NumBodies;
+	Precision = Header.Precision;
+	Chunks.SetNumUninitialized(Footer.NumChunks);
+	FMemory::Memcpy(Chunks.GetData(), Data + Footer.IndexOffset, IndexBytes);
+
+	for (const FTrajectoryChunk& Info : Chunks) {
+		if (Info.NumFrames <= 0 || Info.Offset < (int64)sizeof(Header) || Info.Size < GetKeyframeBytes(NumBodies) || Info.Offset + Info.Size > Footer.IndexOffset) {
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FTrajectoryReader::ReadKeyframe(int32 ChunkIndex, double& OutTime, TArray<FVector3d>& OutPositions) const
+{
+	const uint8* Cursor = Data + Chunks[ChunkIndex].Offset;
+
+	FMemory::Memcpy(&OutTime, Cursor, sizeof(double));
+	OutPositions.SetNumUninitialized(NumBodies);
+	FMemory::Memcpy(OutPositions.GetData(), Cursor + sizeof(double), NumBodies * sizeof(FVector3d));
+}
+
+bool FTrajectoryReader::DecodeChunk(int32 ChunkIndex)
+{
+	if (DecodedChunk == ChunkIndex) {
+		return true;
+	}
+
+	SOLARSYSTEM_SCOPE(TrajectoryDecode);
+
+	const FTrajectoryChunk& Info = Chunks[ChunkIndex];
+	const uint8* Cursor = Data + Info.Offset + GetKeyframeBytes(NumBodies);
+	const uint8* End = Data + Info.Offset + Info.Size;
+
+	DecodedChunk = INDEX_NONE;
+	FrameTimes.SetNumUninitialized(Info.NumFrames);
+	FramePositions.SetNumUninitialized(Info.NumFrames * NumBodies);
+
+	TArray<FVector3d> Keyframe;
+	ReadKeyframe(ChunkIndex, FrameTimes[0], Keyframe);
+	FMemory::Memcpy(FramePositions.GetData(), Keyframe.GetData(), NumBodies * sizeof(FVector3d));
+
+	for (int32 Frame = 1; Frame < Info.NumFrames; ++Frame) {
+		if (End - Cursor < (int64)sizeof(double)) {
+			return false;
+		}
+
+		FMemory::Memcpy(&FrameTimes[Frame], Cursor, sizeof(double));
+		Cursor += sizeof(double);
+
+		const FVector3d* Previous = &FramePositions[(Frame - 1) * NumBodies];
+		FVector3d* Current = &FramePositions[Frame * NumBodies];
+
+		for (int32 i = 0; i < NumBodies; ++i) {
+			for (int32 Axis = 0; Axis < 3; ++Axis) {
+				int64 Delta;
+				if (!ReadVarint(Cursor, End, Delta)) {
+					return false;
+				}
+				Current[i][Axis] = Previous[i][Axis] + Delta * Precision;
+			}
+		}
+	}
+
+	DecodedChunk = ChunkIndex;
+	return true;
+}
+
+bool FTrajectoryReader::Sample(double Time, TArray<FVector3d>& OutPositions)
+{
+	if (!IsOpen()) {
+		return false;
+	}
+
+	Time = FMath::Clamp(Time, GetStartTime(), GetEndTime());
+
+	const int32 ChunkIndex = FMath::Clamp(Algo::UpperBoundBy(Chunks, Time, &FTrajectoryChunk::StartTime) - 1, 0, Chunks.Num() - 1);
+	if (!DecodeChunk(ChunkIndex)) {
+		return false;
+	}
+
+	const int32 Frame = FMath::Clamp(Algo::UpperBound(FrameTimes, Time) - 1, 0, FrameTimes.Num() - 1);
+	const FVector3d* From = &FramePositions[Frame * NumBodies];
+	const FVector3d* To = From;
+	double FromTime = FrameTimes[Frame];
+	double ToTime = FromTime;
+
+	if (Frame + 1 < FrameTimes.Num()) {
+		To = From + NumBodies;
+		ToTime = FrameTimes[Frame + 1];
+	} else if (ChunkIndex + 1 < Chunks.Num()) {
+		// The last frame of a chunk blends into the keyframe opening the next one
+		ReadKeyframe(ChunkIndex + 1, ToTime, NextKeyframe);
+		To = NextKeyframe.GetData();
+	}
+
+	const double Alpha = ToTime > FromTime ? FMath::Clamp((Time - FromTime) / (ToTime - FromTime), 0.0, 1.0) : 0.0;
+
+	OutPositions.SetNumUninitialized(NumBodies);
+	for (int32 i = 0; i < NumBodies; ++i) {
+		OutPositions[i] = FMath::Lerp(From[i], To[i], Alpha);
+	}
+
+	return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// One run of frames in a trajectory file, opened by an exact keyframe so it decodes without its predecessors
+struct FTrajectoryChunk
+{
+	double StartTime = 0.0;
+	double EndTime = 0.0;
+	int64 Offset = 0;
+	int32 Size = 0;
+	int32 NumFrames = 0;
+};
+
+// Streams body positions to a chunked binary file.
+// Frames after a chunk's keyframe store each coordinate as a zigzag varint of its change, quantized to Precision
+// against the previously decoded value so the error never accumulates. Finished chunks are written on a worker,
+// the seek index and footer when the file is closed.
+class SOLARSYSTEM2_API FTrajectoryWriter
+{
+public:
+	~FTrajectoryWriter();
+
+	bool Open(const FString& Path, int32 InNumBodies, double InPrecision, int32 InFramesPerChunk);
+
+	// False when the body count no longer matches the one the file was opened with
+	bool AddFrame(double Time, TConstArrayView<FVector3d> Positions);
+
+	// Writes the pending chunk and the index, returns false if any write failed
+	bool Close();
+
+	bool IsOpen() const { return File.IsValid(); }
+
+	int64 GetBytesWritten() const { return Offset; }
+
+private:
+	TUniquePtr<FArchive> File;
+
+	// Chunk writes run one after another on workers, each one waits for the previous
+	UE::Tasks::FTask PendingWrite;
+
+	int32 NumBodies = 0;
+	double Precision = 0.01;
+	int32 FramesPerChunk = 64;
+
+	TArray<uint8> Chunk;
+	FTrajectoryChunk ChunkInfo;
+	int64 Offset = 0;
+	TArray<FTrajectoryChunk> Index;
+
+	// Positions as a reader will decode them, the base of the next frame's deltas
+	TArray<FVector3d> Decoded;
+
+	void FlushChunk();
+};
+
+// Memory maps a trajectory file and samples it at any time.
+// A seek is a binary search over the chunk index plus the decode of one chunk, which stays cached for scrubbing.
+class SOLARSYSTEM2_API FTrajectoryReader
+{
+public:
+	~FTrajectoryReader();
+
+	bool Open(const FString& Path);
+
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+
+	int32 GetNumBodies() const { return NumBodies; }
+
+	double GetStartTime() const { return Chunks.Num() > 0 ? Chunks[0].StartTime : 0.0; }
+
+	double GetEndTime() const { return Chunks.Num() > 0 ? Chunks.Last().EndTime : 0.0; }
+
+	// Positions at Time, linear between the recorded frames around it and clamped to the recorded range
+	bool Sample(double Time, TArray<FVector3d>& OutPositions);
+
+private:
+	// Points either into OwnedData or into the mapped file
+	const uint8* Data = nullptr;
+	int64 DataSize = 0;
+	TArray<uint8> OwnedData;
+
+	// The region is unmapped before the handle closes
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	int32 NumBodies = 0;
+	double Precision = 0.0;
+	TArray<FTrajectoryChunk> Chunks;
+
+	int32 DecodedChunk = INDEX_NONE;
+	TArray<double> FrameTimes;
+
+	// NumFrames * NumBodies positions of DecodedChunk
+	TArray<FVector3d> FramePositions;
+
+	TArray<FVector3d> NextKeyframe;
+
+	bool DecodeChunk(int32 ChunkIndex);
+
+	// Time and positions of a chunk's keyframe only, what interpolation across a chunk boundary needs
+	void ReadKeyframe(int32 ChunkIndex, double& OutTime, TArray<FVector3d>& OutPositions) const;
+};